@@ -20,10 +20,11 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <unistd.h>
-#include <sys/select.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
 #include <arpa/inet.h>
 
 #include <google/protobuf/io/coded_stream.h>
@@ -39,6 +40,27 @@ using namespace std;
 
 #define PFX (pfx() + "." + __func__ + "() ").c_str()
 
+/** Maximum number of unsent bytes, before the production of data responses
+ * waits for the client. */
+#define SEND_BUFFER_LIMIT (1024 * 1024)
+
+/** Sent bytes are removed from the front of the send buffer, as soon as they
+ * exceed this size. */
+#define SEND_BUFFER_COMPACT (64 * 1024)
+
+/** Maximum number of bytes received at once. Limits the time the I/O thread
+ * spends on a single connection. */
+#define RECEIVE_SIZE (16 * 1024)
+
+/** Maximum number of unprocessed bytes in the receive buffer. Above it, the
+ * socket is not read any more, until the workers processed the pending
+ * requests. */
+#define RECEIVE_BUFFER_LIMIT (256 * 1024)
+
+/** Processed bytes are removed from the front of the receive buffer, as soon
+ * as they exceed this size. */
+#define RECEIVE_BUFFER_COMPACT (64 * 1024)
+
 /*****************************************************************************/
 
 Connection::Connection(
@@ -48,11 +70,23 @@ Connection::Connection(
         ):
     _parent_proc(parent_proc),
     _fd(fd),
-    _ret(0),
     _running(true),
-    _messageSize(0U)
+    _epoll_fd(-1),
+    _events(0),
+    _queued(false),
+    _closed(false),
+    _sendOffset(0),
+    _receiveOffset(0),
+    _messageSize(0U),
+    _request_id_valid(false),
+    _request_id(0U),
+    _end_of_response_sent(false),
+    _data_encoding(LibDLS::Data::DoubleValues),
+    _data_type(LibDLS::TUNKNOWN)
 {
     pthread_mutex_init(&_mutex, NULL);
+    pthread_mutex_init(&_io_mutex, NULL);
+    pthread_cond_init(&_send_cond, NULL);
 
     memcpy(&peer_addr, peer, sizeof(struct sockaddr_storage));
 
@@ -69,162 +103,219 @@ Connection::~Connection()
     msg() << "Closing connection for " << addr_str;
     log(Info);
 
+    if (!_cache_path.empty()) {
+        _parent_proc->dir_cache().detach(_cache_path);
+    }
+
     close(_fd);
+
+    pthread_cond_destroy(&_send_cond);
+    pthread_mutex_destroy(&_io_mutex);
+    pthread_mutex_destroy(&_mutex);
 }
 
 /*****************************************************************************/
 
-int Connection::start_thread()
+void Connection::lock()
 {
-    int ret;
-
-    ret = pthread_create(&_thread, NULL, _run_static, this);
-    if (ret) {
-        return ret;
-    }
-
-    return 0;
+    pthread_mutex_lock(&_mutex);
 }
 
 /*****************************************************************************/
 
-int Connection::thread_finished()
+void Connection::unlock()
 {
-    void *res;
+    pthread_mutex_unlock(&_mutex);
+}
 
-    int ret = pthread_tryjoin_np(_thread, &res);
+/*****************************************************************************/
 
-    if (ret == EBUSY) {
-        return 0;
-    }
-    if (ret) {
-        return ret;
-    }
-    else {
-        _ret = (uint64_t) res;
-        return 1;
-    }
+/** Sends the greeting to a new client.
+ */
+void Connection::send_hello()
+{
+    pthread_mutex_lock(&_mutex);
+    _send_hello();
+    pthread_mutex_unlock(&_mutex);
 }
 
 /*****************************************************************************/
 
-void Connection::lock()
+/** Receives data from the socket.
+ *
+ * Called by the I/O thread, when the socket is readable.
+ *
+ * \return false, if the connection was lost.
+ */
+bool Connection::read_socket()
 {
-    pthread_mutex_lock(&_mutex);
+    char data[RECEIVE_SIZE];
+    ssize_t ret = ::recv(_fd, data, sizeof(data), MSG_DONTWAIT);
+
+    if (ret == 0) {
+        cerr << PFX << "Connection closed by peer." << endl;
+        return false;
+    }
+
+    if (ret < 0) {
+        if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+            return true;
+        }
+        cerr << PFX << "recv() failed: " << strerror(errno) << endl;
+        return false;
+    }
+
+    pthread_mutex_lock(&_io_mutex);
+    _receiveBuffer.append(data, ret);
+    _update_events();
+    pthread_mutex_unlock(&_io_mutex);
+    return true;
 }
 
 /*****************************************************************************/
 
-void Connection::unlock()
+/** Sends buffered responses to the socket.
+ *
+ * Called by the I/O thread, when the socket is writable.
+ *
+ * \return false, if the connection was lost.
+ */
+bool Connection::write_socket()
 {
-    pthread_mutex_unlock(&_mutex);
+    pthread_mutex_lock(&_io_mutex);
+    _send_data();
+    if (!_running || _sendBuffer.size() - _sendOffset <= SEND_BUFFER_LIMIT) {
+        pthread_cond_broadcast(&_send_cond);
+    }
+    _update_events();
+    bool running = _running;
+    pthread_mutex_unlock(&_io_mutex);
+    return running;
 }
 
 /*****************************************************************************/
 
-void *Connection::_run_static(void *arg)
+/** Checks for a complete request in the receive buffer.
+ *
+ * Only the size is checked, the request is parsed by process_request().
+ */
+bool Connection::request_pending()
 {
-    Connection *conn = (Connection *) arg;
-    return conn->_run();
+    pthread_mutex_lock(&_io_mutex);
+    bool pending = _running && _request_complete();
+    pthread_mutex_unlock(&_io_mutex);
+    return pending;
 }
 
 /*****************************************************************************/
 
-void *Connection::_run()
+/** Processes the next request in the receive buffer.
+ *
+ * Called by a worker thread. Only one request is processed, so that the
+ * workers can alternate between the clients.
+ */
+void Connection::process_request()
 {
-    fd_set rfds;
-    fd_set wfds;
-    int ret;
+    DlsProto::Request req;
 
     pthread_mutex_lock(&_mutex);
-    _send_hello();
-    pthread_mutex_unlock(&_mutex);
 
-    while (_running) {
-        FD_ZERO(&rfds);
-        FD_ZERO(&wfds);
-        FD_SET(_fd, &rfds);
+    pthread_mutex_lock(&_io_mutex);
+    bool valid = _running && _next_request(req);
+    pthread_mutex_unlock(&_io_mutex);
 
-        if (!_sendBuffer.empty()) {
-            FD_SET(_fd, &wfds);
-        }
+    if (valid) {
+        _request_time.set_now();
+        _process(req);
+    }
 
-        ret = select(_fd + 1, &rfds, &wfds, NULL, NULL);
-        if (ret == -1) {
-            if (errno != EINTR) {
-                char ebuf[1024], *str = strerror_r(errno, ebuf, sizeof(ebuf));
-                cerr << PFX << "select() failed: " << str << endl;
-                _running = false;
-            }
-        }
+    pthread_mutex_unlock(&_mutex);
+}
 
-        if (ret > 0) { // file descriptors ready
-            if (FD_ISSET(_fd, &rfds)) {
-                pthread_mutex_lock(&_mutex);
-                _receive_data();
-                pthread_mutex_unlock(&_mutex);
-            }
-            if (FD_ISSET(_fd, &wfds)) {
-                pthread_mutex_lock(&_mutex);
-                _send_data();
-                pthread_mutex_unlock(&_mutex);
-            }
-        }
-    }
+/*****************************************************************************/
 
-    return (void *) 0;
+bool Connection::running()
+{
+    pthread_mutex_lock(&_io_mutex);
+    bool running = _running;
+    pthread_mutex_unlock(&_io_mutex);
+    return running;
 }
 
 /*****************************************************************************/
 
-void Connection::_receive_data()
+/** Stops the connection.
+ *
+ * Remaining responses are discarded, and a worker waiting for the client
+ * is woken up.
+ */
+void Connection::cancel()
 {
-    char data[1024];
-    int ret = ::recv(_fd, data, sizeof(data), 0);
+    pthread_mutex_lock(&_io_mutex);
+    _running = false;
+    pthread_cond_broadcast(&_send_cond);
+    pthread_mutex_unlock(&_io_mutex);
+}
 
-    if (ret == 0) {
-        cerr << PFX << "Connection closed by peer." << endl;
-        _running = false;
-        return;
-    }
+/*****************************************************************************/
 
-    if (ret < 0) {
-        cerr << PFX << "recv() failed: " << strerror(errno) << endl;
-        _running = false;
-        return;
+/** Sends an unsolicited message.
+ *
+ * Called by the I/O thread to push live data. Instead of waiting for a
+ * slow client, the message is dropped, if the send buffer is full.
+ *
+ * \return false, if the message was dropped.
+ */
+bool Connection::push(google::protobuf::Message &msg)
+{
+    pthread_mutex_lock(&_io_mutex);
+
+    bool ok = _running
+        && _sendBuffer.size() - _sendOffset <= SEND_BUFFER_LIMIT;
+    if (ok) {
+        _append_msg(msg);
     }
 
-    _receiveBuffer += string(data, ret);
+    pthread_mutex_unlock(&_io_mutex);
+    return ok;
+}
+
+/*****************************************************************************/
 
+/** Takes the next request from the receive buffer.
+ *
+ * Has to be called with the I/O mutex locked.
+ *
+ * \return true, if a request was parsed.
+ */
+bool Connection::_next_request(DlsProto::Request &req)
+{
     if (!_messageSize) {
         google::protobuf::io::CodedInputStream
-            ci((const google::protobuf::uint8 *) _receiveBuffer.c_str(),
-                    _receiveBuffer.size());
+            ci((const google::protobuf::uint8 *) _receiveBuffer.c_str()
+                    + _receiveOffset,
+                    _receiveBuffer.size() - _receiveOffset);
         bool success = ci.ReadVarint32(&_messageSize);
         if (!success) {
-            cerr << PFX << "Varint32 incomplete (size = "
-                << _receiveBuffer.size() << "). Wait for next receive!"
-                << endl;
-            return;
+            return false;
         }
 
-        int varIntSize =
+        _receiveOffset +=
             google::protobuf::io::CodedOutputStream::VarintSize32(
                     _messageSize);
-        _receiveBuffer.erase(0, varIntSize);
     }
 
-    if ((unsigned int) _receiveBuffer.size() < _messageSize) {
-        cerr << PFX << "Data missing. Wait for next receive!" << endl;
-        return;
+    if (_receiveBuffer.size() - _receiveOffset < _messageSize) {
+        return false;
     }
 
-    DlsProto::Request req;
-    bool success = req.ParseFromArray(_receiveBuffer.c_str(), _messageSize);
+    bool success = req.ParseFromArray(
+            _receiveBuffer.c_str() + _receiveOffset, _messageSize);
     if (!success) {
+        // the stream can not be resynchronized
         cerr << PFX << "ParseFromArray() failed!" << endl;
-        _running = true;
-        return;
+        _running = false;
+        return false;
     }
 
 #ifdef DLS_PROTO_DEBUG
@@ -232,30 +323,157 @@ void Connection::_receive_data()
         << " bytes: " << req.DebugString() << endl;
 #endif
 
-    _receiveBuffer.erase(0, _messageSize);
+    _receiveOffset += _messageSize;
     _messageSize = 0;
-    _request_time.set_now();
 
-    _process(req);
+    if (_receiveOffset == _receiveBuffer.size()) {
+        _receiveBuffer.clear();
+        _receiveOffset = 0;
+    }
+    else if (_receiveOffset >= RECEIVE_BUFFER_COMPACT
+            && _receiveOffset >= _receiveBuffer.size() / 2) {
+        // move the rest to the front only once per half buffer
+        _receiveBuffer.erase(0, _receiveOffset);
+        _receiveOffset = 0;
+    }
+
+    // resume receiving, if it was suspended
+    _update_events();
+    return true;
+}
+
+/*****************************************************************************/
+
+/** Checks for a complete request in the receive buffer.
+ *
+ * Has to be called with the I/O mutex locked.
+ */
+bool Connection::_request_complete() const
+{
+    size_t size = _receiveBuffer.size() - _receiveOffset;
+
+    if (_messageSize) {
+        return size >= _messageSize;
+    }
+
+    google::protobuf::io::CodedInputStream
+        ci((const google::protobuf::uint8 *) _receiveBuffer.c_str()
+                + _receiveOffset, size);
+    uint32_t messageSize;
+    if (!ci.ReadVarint32(&messageSize)) {
+        return false;
+    }
+
+    size_t varIntSize =
+        google::protobuf::io::CodedOutputStream::VarintSize32(messageSize);
+    return size - varIntSize >= messageSize;
 }
 
 /*****************************************************************************/
 
 void Connection::_send_data()
 {
-    if (_sendBuffer.empty()) {
+    if (_sendOffset >= _sendBuffer.size()) {
         return;
     }
 
-    ssize_t ret = ::send(_fd, _sendBuffer.c_str(), _sendBuffer.size(), 0);
+    ssize_t ret = ::send(_fd, _sendBuffer.c_str() + _sendOffset,
+            _sendBuffer.size() - _sendOffset, MSG_DONTWAIT);
 
     if (ret < 0) {
+        if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+            return;
+        }
         cerr << PFX << "send() failed: " << strerror(errno) << endl;
         _running = false;
+        _sendBuffer.clear();
+        _sendOffset = 0;
+        return;
+    }
+
+    _sendOffset += ret;
+
+    if (_sendOffset == _sendBuffer.size()) {
+        _sendBuffer.clear();
+        _sendOffset = 0;
+    }
+    else if (_sendOffset >= SEND_BUFFER_COMPACT
+            && _sendOffset >= _sendBuffer.size() / 2) {
+        // move the rest to the front only once per half buffer
+        _sendBuffer.erase(0, _sendOffset);
+        _sendOffset = 0;
+    }
+}
+
+/*****************************************************************************/
+
+/** Adapts the polled events to the send and receive buffers.
+ *
+ * The socket is not read any more, while complete requests of more than
+ * RECEIVE_BUFFER_LIMIT bytes are waiting for the workers. So a client
+ * pipelining requests faster than they are processed is slowed down by TCP
+ * flow control, instead of filling the memory.
+ *
+ * Has to be called with the I/O mutex locked.
+ */
+void Connection::_update_events()
+{
+    uint32_t events = 0;
+
+    if (_receiveBuffer.size() - _receiveOffset < RECEIVE_BUFFER_LIMIT
+            || !_request_complete()) {
+        events |= EPOLLIN;
+    }
+
+    if (_running && _sendOffset < _sendBuffer.size()) {
+        events |= EPOLLOUT;
+    }
+
+    if (_epoll_fd == -1 || events == _events) {
         return;
     }
 
-    _sendBuffer.erase(0, ret);
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = this;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, _fd, &ev) == 0) {
+        _events = events;
+    }
+}
+
+/*****************************************************************************/
+
+/** Waits, until the send buffer is below its limit.
+ *
+ * Called while responses are produced, so that a large data request is
+ * streamed to the client at the speed the client receives it, instead of
+ * being collected in memory completely. The connection mutex is released
+ * while waiting for the I/O thread, so that the mother process is not
+ * blocked by slow clients, and the Server replaces the waiting worker for
+ * the other connections (see Server::begin_wait()).
+ */
+void Connection::_wait_for_send_buffer()
+{
+    pthread_mutex_lock(&_io_mutex);
+    bool full = _running
+        && _sendBuffer.size() - _sendOffset > SEND_BUFFER_LIMIT;
+    pthread_mutex_unlock(&_io_mutex);
+
+    if (!full) {
+        return;
+    }
+
+    pthread_mutex_unlock(&_mutex);
+    _parent_proc->server().begin_wait();
+
+    pthread_mutex_lock(&_io_mutex);
+    while (_running && _sendBuffer.size() - _sendOffset > SEND_BUFFER_LIMIT) {
+        pthread_cond_wait(&_send_cond, &_io_mutex);
+    }
+    pthread_mutex_unlock(&_io_mutex);
+
+    _parent_proc->server().end_wait();
+    pthread_mutex_lock(&_mutex);
 }
 
 /*****************************************************************************/
@@ -274,30 +492,52 @@ void Connection::_send_msg(
             t.set_now();
             res.set_response_time((t - _request_time).to_int64());
         }
+        if (_request_id_valid) {
+            res.set_request_id(_request_id);
+            if (res.end_of_response()) {
+                _end_of_response_sent = true;
+            }
+        }
     }
     catch (bad_cast &e) {
     }
 
-    int messageSize = msg.ByteSize();
-
 #ifdef DLS_PROTO_DEBUG
     if (debug) {
         cerr << PFX << "Sending message with "
-            << messageSize << " bytes: " << endl
+            << msg.ByteSize() << " bytes: " << endl
             << msg.DebugString() << endl;
     }
 #endif
 
+    pthread_mutex_lock(&_io_mutex);
+
+    if (_running) { // otherwise discard remaining responses
+        _append_msg(msg);
+    }
+
+    pthread_mutex_unlock(&_io_mutex);
+}
+
+/*****************************************************************************/
+
+/** Appends a message to the send buffer.
+ *
+ * Has to be called with the I/O mutex locked.
+ */
+void Connection::_append_msg(google::protobuf::Message &msg)
+{
+    int messageSize = msg.ByteSize();
+
     google::protobuf::uint8 varIntStr[32];
     google::protobuf::uint8 *past =
         google::protobuf::io::CodedOutputStream::
         WriteVarint32ToArray(messageSize, varIntStr);
     int varIntStrSize = past - varIntStr;
-    _sendBuffer += string((const char *) varIntStr, varIntStrSize);
 
-    string str;
-    msg.SerializeToString(&str);
-    _sendBuffer += str;
+    _sendBuffer.append((const char *) varIntStr, varIntStrSize);
+    msg.AppendToString(&_sendBuffer);
+    _update_events();
 }
 
 /*****************************************************************************/
@@ -307,7 +547,7 @@ void Connection::_send_hello()
     DlsProto::Hello msg;
     msg.set_version(PACKAGE_VERSION);
     msg.set_revision(REVISION);
-    msg.set_protocol_version(2); // support message_request (see dls.proto)
+    msg.set_protocol_version(7); // support subscriptions (see dls.proto)
     _send_msg(msg);
 }
 
@@ -315,6 +555,10 @@ void Connection::_send_hello()
 
 void Connection::_process(const DlsProto::Request &req)
 {
+    _request_id_valid = req.has_request_id();
+    _request_id = req.request_id();
+    _end_of_response_sent = false;
+
     if (req.has_dir_info()) {
         _process_dir_info(req.dir_info());
     }
@@ -322,6 +566,15 @@ void Connection::_process(const DlsProto::Request &req)
     if (req.has_job_request()) {
         _process_job_request(req.job_request());
     }
+
+    // pipelined requests are always terminated, also on errors
+    if (_request_id_valid && !_end_of_response_sent) {
+        DlsProto::Response res;
+        res.set_end_of_response(true);
+        _send_msg(res);
+    }
+
+    _request_id_valid = false;
 }
 
 /*****************************************************************************/
@@ -348,6 +601,21 @@ void Connection::_process_dir_info(const DlsProto::DirInfoRequest &req)
         return;
     }
 
+    // share the chunk lists with the other connections
+    string cache_path;
+    if (_dir.access() == LibDLS::Directory::Local) {
+        cache_path = _dir.path();
+    }
+    if (cache_path != _cache_path) {
+        if (!cache_path.empty()) {
+            _parent_proc->dir_cache().attach(cache_path);
+        }
+        if (!_cache_path.empty()) {
+            _parent_proc->dir_cache().detach(_cache_path);
+        }
+        _cache_path = cache_path;
+    }
+
     DlsProto::Response res;
     _dir.set_dir_info(res.mutable_dir_info());
     _send_msg(res);
@@ -446,7 +714,8 @@ void Connection::_process_channel_request(
         pair<set<LibDLS::Chunk *>, set<int64_t> > updated_removed;
 
         try {
-            updated_removed = channel->fetch_chunks();
+            updated_removed =
+                _parent_proc->dir_cache().fetch_chunks(channel);
         }
         catch (LibDLS::ChannelException &e) {
             stringstream str;
@@ -494,6 +763,10 @@ void Connection::_process_channel_request(
         _send_msg(res);
     }
 
+    if (req.has_subscription()) {
+        _process_subscription(job, channel, req.subscription());
+    }
+
     if (req.has_data_request()) {
         const DlsProto::DataRequest &data_req = req.data_request();
         unsigned int min_values = 0;
@@ -504,10 +777,21 @@ void Connection::_process_channel_request(
         if (data_req.has_decimation()) {
             decimation = data_req.decimation();
         }
+        _data_encoding = (LibDLS::Data::Encoding) data_req.encoding();
+        _data_type = channel->type();
+        _data_error.clear();
         try {
-            channel->fetch_data(LibDLS::Time(data_req.start()),
-                    LibDLS::Time(data_req.end()), min_values,
-                    _static_data_callback, this, decimation);
+            if (data_req.envelope()) {
+                channel->fetch_envelope(LibDLS::Time(data_req.start()),
+                        LibDLS::Time(data_req.end()), data_req.envelope(),
+                        _static_data_callback, this);
+            }
+            else {
+                channel->fetch_data(LibDLS::Time(data_req.start()),
+                        LibDLS::Time(data_req.end()), min_values,
+                        _static_data_callback, this, decimation,
+                        _data_encoding == LibDLS::Data::CompressedBlocks);
+            }
         }
         catch (LibDLS::ChannelException &e) {
             stringstream str;
@@ -519,6 +803,15 @@ void Connection::_process_channel_request(
             _send_msg(res);
         }
 
+        if (!_data_error.empty()) {
+            // do not let the client take the gap for missing data
+            DlsProto::Response res;
+            DlsProto::Error *err = res.mutable_error();
+            err->set_message(_data_error);
+            _send_msg(res);
+            _data_error.clear();
+        }
+
         DlsProto::Response res;
         res.set_end_of_response(true);
         _send_msg(res);
@@ -527,6 +820,76 @@ void Connection::_process_channel_request(
 
 /*****************************************************************************/
 
+/** Starts or cancels a live data subscription.
+ *
+ * The blocks are pushed by the Server, as soon as the logging process saved
+ * them (see LiveRelay).
+ */
+void Connection::_process_subscription(
+        LibDLS::Job *job,
+        LibDLS::Channel *channel,
+        const DlsProto::Subscription &req
+        )
+{
+    DlsProto::Response res;
+
+    if (!_is_server_dir()) {
+        DlsProto::Error *err = res.mutable_error();
+        err->set_message("Live data are only available for the"
+                " DLS directory of the server!");
+        _send_msg(res);
+        return;
+    }
+
+    // MDCT blocks can not be decoded on their own, see SaverT
+    const vector<LibDLS::ChannelPreset> *presets = job->preset().channels();
+    for (vector<LibDLS::ChannelPreset>::const_iterator preset_i =
+            presets->begin(); preset_i != presets->end(); preset_i++) {
+        if (req.enable() && preset_i->name == channel->name()
+                && preset_i->format_index == LibDLS::FORMAT_MDCT) {
+            DlsProto::Error *err = res.mutable_error();
+            err->set_message("Live data are not available for"
+                    " MDCT-compressed channels!");
+            _send_msg(res);
+            return;
+        }
+    }
+
+    if (req.enable()) {
+        _parent_proc->server().subscribe(this, job->id(),
+                channel->dir_index(),
+                (LibDLS::Data::Encoding) req.encoding(), channel->type(),
+                req.meta());
+    }
+    else {
+        _parent_proc->server().unsubscribe(this, job->id(),
+                channel->dir_index());
+    }
+
+    res.set_end_of_response(true);
+    _send_msg(res);
+}
+
+/*****************************************************************************/
+
+/** Checks, if the imported directory is the one of the logging processes.
+ */
+bool Connection::_is_server_dir() const
+{
+    struct stat dir_stat, server_stat;
+
+    if (_dir.access() != LibDLS::Directory::Local
+            || stat(_dir.path().c_str(), &dir_stat)
+            || stat(_parent_proc->dls_dir().c_str(), &server_stat)) {
+        return false;
+    }
+
+    return dir_stat.st_dev == server_stat.st_dev
+        && dir_stat.st_ino == server_stat.st_ino;
+}
+
+/*****************************************************************************/
+
 int Connection::_static_data_callback(LibDLS::Data *data, void *cb_data)
 {
     Connection *c = (Connection *) cb_data;
@@ -538,22 +901,37 @@ int Connection::_static_data_callback(LibDLS::Data *data, void *cb_data)
 
 void Connection::_data_callback(LibDLS::Data *data)
 {
-    DlsProto::Response res;
-    DlsProto::Data *data_res = res.mutable_data();
-    data_res->set_start_time(data->start_time().to_int64());
-    data_res->set_time_per_value(data->time_per_value().to_int64());
-    data_res->set_meta_type((DlsProto::MetaType) data->meta_type());
-    data_res->set_meta_level(data->meta_level());
+    if (!_data_error.empty()) {
+        return; // skip the rest of a failed request
+    }
 
-    for (size_t i = 0; i < data->size(); i++) {
-        data_res->add_value(data->value(i));
+    // The protocol only knows ZLib and quantization blocks, so delta- and
+    // XOR-coded blocks are sent as values.
+    if (data->has_block() && (data->block_format() == LibDLS::FORMAT_DELTA
+                || data->block_format() == LibDLS::FORMAT_XOR)) {
+        try {
+            data->decode_block(_data_type);
+        }
+        catch (LibDLS::DataException &e) {
+            stringstream str;
+            str << "Failed to decode block: " << e.msg;
+            _data_error = str.str();
+            msg() << _data_error;
+            log(Error);
+            return;
+        }
     }
 
+    DlsProto::Response res;
+    data->set_data_msg(res.mutable_data(), _data_encoding, _data_type);
+
     _send_msg(res
 #ifdef DLS_PROTO_DEBUG
             , 0
 #endif
             );
+
+    _wait_for_send_buffer();
 }
 
 /****************************************************************************/
@@ -31,42 +31,85 @@
 #include "proto/dls.pb.h"
 
 class ProcMother;
+class Server;
 
 /*****************************************************************************/
 
 /** Incoming network connection.
+ *
+ * The connection has no thread of its own. The socket is served by the I/O
+ * thread of the Server, which receives requests and sends the buffered
+ * responses, while the requests are processed by the Server's workers.
+ *
+ * Two mutexes are used: The connection mutex (see lock()) is held while a
+ * request is processed, the I/O mutex only while the buffers are accessed.
+ * The I/O mutex may be locked while holding the connection mutex, but not
+ * vice-versa.
  */
 class Connection
 {
+    friend class Server;
+
 public:
     Connection(ProcMother *, int, const struct sockaddr_storage *);
     ~Connection();
 
-    int start_thread();
-    int thread_finished();
-    int return_code() const { return _ret; }
+    int fd() const { return _fd; }
 
     void lock();
     void unlock();
 
+    void send_hello();
+    bool read_socket();
+    bool write_socket();
+    bool request_pending();
+    void process_request();
+    bool running();
+    void cancel();
+    bool push(google::protobuf::Message &);
+
 private:
     ProcMother * const _parent_proc;
     const int _fd;
     struct sockaddr_storage peer_addr;
-    pthread_t _thread;
-    pthread_mutex_t _mutex;
-    int _ret; /**< Return value. */
+    pthread_mutex_t _mutex; /**< Held while processing a request. */
+    pthread_mutex_t _io_mutex; /**< Protects the buffers, _running and
+                                 _events. */
+    pthread_cond_t _send_cond; /**< Signalled, when the send buffer fell
+                                 below its limit. */
     bool _running;
+    int _epoll_fd; /**< Event poll descriptor of the Server. */
+    uint32_t _events; /**< Events currently polled for. */
+    bool _queued; /**< Waiting for or being processed by a worker. Managed
+                    by the Server. */
+    bool _closed; /**< Removed from the event poll. Managed by the
+                    Server. */
     std::string _sendBuffer;
+    size_t _sendOffset; /**< Number of bytes already sent from
+                          _sendBuffer. */
     std::string _receiveBuffer;
+    size_t _receiveOffset; /**< Number of bytes already processed from
+                             _receiveBuffer. */
     unsigned int _messageSize;
     LibDLS::Directory _dir;
+    std::string _cache_path; /**< Directory attached to the cache. */
     LibDLS::Time _request_time;
+    bool _request_id_valid; /**< The current request has an ID. */
+    uint32_t _request_id; /**< ID of the current request. */
+    bool _end_of_response_sent; /**< The current request was terminated. */
+    LibDLS::Data::Encoding _data_encoding; /**< Encoding for the data
+                                             callback. */
+    LibDLS::ChannelType _data_type; /**< Channel type for the data
+                                      callback. */
+    std::string _data_error; /**< Error of the current data request. The
+                               remaining data are discarded. */
 
-    static void *_run_static(void *);
-    void *_run();
-    void _receive_data();
+    bool _next_request(DlsProto::Request &);
+    bool _request_complete() const;
     void _send_data();
+    void _update_events();
+    void _append_msg(google::protobuf::Message &);
+    void _wait_for_send_buffer();
     void _send_msg(google::protobuf::Message &
 #ifdef DLS_PROTO_DEBUG
             , bool debug = 1
@@ -78,6 +121,9 @@ private:
     void _process_job_request(const DlsProto::JobRequest &);
     void _process_channel_request(LibDLS::Job *,
             const DlsProto::ChannelRequest &);
+    void _process_subscription(LibDLS::Job *, LibDLS::Channel *,
+            const DlsProto::Subscription &);
+    bool _is_server_dir() const;
     static int _static_data_callback(LibDLS::Data *, void *);
     void _data_callback(LibDLS::Data *);
     std::string pfx() const;
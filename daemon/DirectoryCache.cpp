@@ -0,0 +1,327 @@
+/******************************************************************************
+ *
+ *  This file is part of the Data Logging Service (DLS).
+ *
+ *  DLS is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  DLS is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with DLS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+#include <sys/stat.h>
+
+#include <sstream>
+
+#include "DirectoryCache.h"
+#include "globals.h"
+
+using namespace std;
+
+/*****************************************************************************/
+
+/** Minimum interval in seconds between two scans of a channel with
+ * incomplete chunks. */
+#define INCOMPLETE_SCAN_INTERVAL 1.0
+
+/*****************************************************************************/
+
+DirectoryCache::DirectoryCache()
+{
+    pthread_mutex_init(&_mutex, NULL);
+}
+
+/*****************************************************************************/
+
+DirectoryCache::~DirectoryCache()
+{
+    for (map<string, Entry *>::iterator entry_i = _entries.begin();
+            entry_i != _entries.end(); entry_i++) {
+        _delete_entry(entry_i->second);
+    }
+
+    pthread_mutex_destroy(&_mutex);
+}
+
+/*****************************************************************************/
+
+/** Registers a connection using a local DLS directory.
+ */
+void DirectoryCache::attach(
+        const string &path /**< Path of the DLS directory. */
+        )
+{
+    pthread_mutex_lock(&_mutex);
+
+    map<string, Entry *>::iterator entry_i = _entries.find(path);
+    if (entry_i != _entries.end()) {
+        entry_i->second->ref_count++;
+    }
+    else {
+        Entry *entry = new Entry;
+        entry->dir.set_uri(path);
+        entry->ref_count = 1;
+        pthread_mutex_init(&entry->mutex, NULL);
+        _entries[path] = entry;
+    }
+
+    pthread_mutex_unlock(&_mutex);
+}
+
+/*****************************************************************************/
+
+/** Unregisters a connection. Releases the directory with the last one.
+ */
+void DirectoryCache::detach(
+        const string &path /**< Path of the DLS directory. */
+        )
+{
+    Entry *entry = NULL;
+
+    pthread_mutex_lock(&_mutex);
+
+    map<string, Entry *>::iterator entry_i = _entries.find(path);
+    if (entry_i != _entries.end() && !--entry_i->second->ref_count) {
+        entry = entry_i->second;
+        _entries.erase(entry_i);
+    }
+
+    pthread_mutex_unlock(&_mutex);
+
+    if (entry) {
+        _delete_entry(entry);
+    }
+}
+
+/*****************************************************************************/
+
+/** Updates the chunks of a connection's channel from the cache.
+ *
+ * Falls back to scanning the channel itself, if its directory is not
+ * attached, or the channel is unknown to the cache.
+ *
+ * \return Updated and removed chunks, see LibDLS::Channel::fetch_chunks().
+ */
+pair<set<LibDLS::Chunk *>, set<int64_t> > DirectoryCache::fetch_chunks(
+        LibDLS::Channel *channel /**< Channel of the connection. */
+        )
+{
+    Entry *entry = NULL;
+    ChannelEntry *channel_entry = NULL;
+
+    pthread_mutex_lock(&_mutex);
+    map<string, Entry *>::iterator entry_i =
+        _entries.find(channel->getJob()->dir()->path());
+    if (entry_i != _entries.end()) {
+        entry = entry_i->second;
+        // the calling connection is attached, so the entry stays valid
+        pthread_mutex_lock(&entry->mutex);
+    }
+    pthread_mutex_unlock(&_mutex);
+
+    if (entry) {
+        channel_entry = _channel_entry(entry, channel);
+        pthread_mutex_unlock(&entry->mutex);
+    }
+
+    if (!channel_entry) {
+        return channel->fetch_chunks();
+    }
+
+    pthread_mutex_lock(&channel_entry->mutex);
+
+    try {
+        LibDLS::Channel *shared = channel_entry->channel;
+        struct stat st;
+        bool stat_ok = stat(shared->path().c_str(), &st) == 0;
+        bool scan = !channel_entry->scanned;
+        LibDLS::Time now;
+
+        now.set_now();
+
+        // a directory modified in the second of the last scan may have
+        // been modified after it
+        if (!stat_ok
+                || st.st_mtime != channel_entry->mtime
+                || st.st_mtime
+                >= (time_t) channel_entry->scan_time.to_dbl_time()) {
+            scan = true;
+        }
+
+        if (!scan && (now - channel_entry->scan_time).to_dbl_time()
+                >= INCOMPLETE_SCAN_INTERVAL) {
+            for (LibDLS::Channel::ChunkMap::const_iterator chunk_i =
+                    shared->chunks().begin();
+                    chunk_i != shared->chunks().end(); chunk_i++) {
+                if (chunk_i->second.incomplete()) {
+                    scan = true;
+                    break;
+                }
+            }
+        }
+
+        if (scan) {
+            shared->fetch_chunks();
+            channel_entry->scanned = true;
+            if (stat_ok) {
+                channel_entry->mtime = st.st_mtime;
+            }
+            channel_entry->scan_time = now;
+        }
+    }
+    catch (...) {
+        pthread_mutex_unlock(&channel_entry->mutex);
+        throw;
+    }
+
+    pair<set<LibDLS::Chunk *>, set<int64_t> > ret =
+        channel->update_chunks(*channel_entry->channel);
+
+    pthread_mutex_unlock(&channel_entry->mutex);
+
+    return ret;
+}
+
+/*****************************************************************************/
+
+/** Finds or creates the cache entry of a channel.
+ *
+ * If the cached job does not know the channel, because it was created
+ * after the job was cached, the job is imported again. The replaced job is
+ * kept, as long as its channels are shared.
+ *
+ * Has to be called with the mutex of the directory entry locked.
+ *
+ * \return Channel entry, or NULL, if the channel was not found.
+ */
+DirectoryCache::ChannelEntry *DirectoryCache::_channel_entry(
+        Entry *entry,
+        LibDLS::Channel *channel
+        )
+{
+    unsigned int job_id = channel->getJob()->id();
+    pair<unsigned int, unsigned int> key(job_id, channel->dir_index());
+
+    map<pair<unsigned int, unsigned int>, ChannelEntry *>::iterator
+        channel_i = entry->channels.find(key);
+    if (channel_i != entry->channels.end()) {
+        return channel_i->second;
+    }
+
+    LibDLS::Job *job = NULL;
+    LibDLS::Channel *shared = NULL;
+    map<unsigned int, LibDLS::Job *>::iterator job_i =
+        entry->jobs.find(job_id);
+    if (job_i != entry->jobs.end()) {
+        job = job_i->second;
+        shared = job->find_channel(channel->dir_index());
+    }
+
+    if (!shared) {
+        LibDLS::Job *new_job = _import_job(entry, job_id);
+        if (!new_job) {
+            return NULL;
+        }
+
+        if (job) {
+            // channel created after the job was cached
+            bool in_use = false;
+            for (channel_i = entry->channels.lower_bound(
+                        make_pair(job_id, 0U));
+                    channel_i != entry->channels.end()
+                    && channel_i->first.first == job_id; channel_i++) {
+                if (channel_i->second->channel->getJob() == job) {
+                    in_use = true;
+                    break;
+                }
+            }
+
+            if (in_use) {
+                entry->outdated_jobs.push_back(job);
+            }
+            else {
+                delete job;
+            }
+        }
+
+        job = new_job;
+        entry->jobs[job_id] = job;
+
+        shared = job->find_channel(channel->dir_index());
+        if (!shared) {
+            return NULL;
+        }
+    }
+
+    ChannelEntry *channel_entry = new ChannelEntry;
+    channel_entry->channel = shared;
+    pthread_mutex_init(&channel_entry->mutex, NULL);
+    channel_entry->scanned = false;
+    channel_entry->mtime = 0;
+    entry->channels[key] = channel_entry;
+    return channel_entry;
+}
+
+/*****************************************************************************/
+
+/** Imports a job and its channels into a directory entry.
+ *
+ * eturn The job, or NULL on failure.
+ */
+LibDLS::Job *DirectoryCache::_import_job(
+        Entry *entry,
+        unsigned int job_id
+        )
+{
+    LibDLS::Job *job = new LibDLS::Job(&entry->dir);
+
+    try {
+        job->import(entry->dir.path(), job_id);
+        job->fetch_channels();
+    }
+    catch (LibDLS::Exception &e) {
+        msg() << "Failed to import job " << job_id
+            << " into directory cache: " << e.msg;
+        log(Warning);
+        delete job;
+        return NULL;
+    }
+
+    return job;
+}
+
+/*****************************************************************************/
+
+void DirectoryCache::_delete_entry(Entry *entry)
+{
+    for (map<pair<unsigned int, unsigned int>, ChannelEntry *>::iterator
+            channel_i = entry->channels.begin();
+            channel_i != entry->channels.end(); channel_i++) {
+        pthread_mutex_destroy(&channel_i->second->mutex);
+        delete channel_i->second;
+    }
+
+    for (map<unsigned int, LibDLS::Job *>::iterator job_i =
+            entry->jobs.begin(); job_i != entry->jobs.end(); job_i++) {
+        delete job_i->second;
+    }
+
+    for (list<LibDLS::Job *>::iterator job_i = entry->outdated_jobs.begin();
+            job_i != entry->outdated_jobs.end(); job_i++) {
+        delete *job_i;
+    }
+
+    pthread_mutex_destroy(&entry->mutex);
+    delete entry;
+}
+
+/*****************************************************************************/
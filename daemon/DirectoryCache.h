@@ -0,0 +1,99 @@
+/******************************************************************************
+ *
+ *  This file is part of the Data Logging Service (DLS).
+ *
+ *  DLS is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  DLS is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with DLS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+#ifndef DLSDirectoryCacheHpp
+#define DLSDirectoryCacheHpp
+
+/*****************************************************************************/
+
+#include <pthread.h>
+#include <time.h>
+
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+
+#include "lib/LibDLS/Dir.h"
+
+/*****************************************************************************/
+
+/** Chunk lists shared by all connections of the mother process.
+ *
+ * Scanning the chunks of a channel means reading its directory and the
+ * description files of new chunks. Instead of letting each connection scan
+ * independently, the cache keeps one scanned copy of each requested channel
+ * per DLS directory and passes it to the connections' own channel objects
+ * (see LibDLS::Channel::update_chunks()).
+ *
+ * A channel is scanned again, if its directory was modified (a logger
+ * created or removed a chunk), or if it has incomplete chunks, whose end
+ * is still moving, and the last scan is older than a second.
+ *
+ * The directory entries are reference-counted by the connections using
+ * them and released with the last connection.
+ */
+class DirectoryCache
+{
+public:
+    DirectoryCache();
+    ~DirectoryCache();
+
+    void attach(const std::string &);
+    void detach(const std::string &);
+
+    std::pair<std::set<LibDLS::Chunk *>, std::set<int64_t> >
+        fetch_chunks(LibDLS::Channel *);
+
+private:
+    /** Shared channel. */
+    struct ChannelEntry {
+        LibDLS::Channel *channel; /**< Scanned channel. */
+        pthread_mutex_t mutex; /**< Serializes scans of the channel. */
+        bool scanned; /**< The channel was scanned at least once. */
+        time_t mtime; /**< Modification time of the channel directory at
+                        the last scan. */
+        LibDLS::Time scan_time; /**< Time of the last scan. */
+    };
+
+    /** Shared DLS directory. */
+    struct Entry {
+        LibDLS::Directory dir; /**< Parent of the jobs. */
+        unsigned int ref_count; /**< Number of attached connections. */
+        pthread_mutex_t mutex; /**< Protects the maps below. */
+        std::map<unsigned int, LibDLS::Job *> jobs; /**< Jobs by ID. */
+        std::list<LibDLS::Job *> outdated_jobs; /**< Replaced jobs, whose
+                                                  channels are still
+                                                  shared. */
+        std::map<std::pair<unsigned int, unsigned int>, ChannelEntry *>
+            channels; /**< Channels by job ID and directory index. */
+    };
+
+    pthread_mutex_t _mutex; /**< Protects _entries. */
+    std::map<std::string, Entry *> _entries; /**< Entries by path. */
+
+    ChannelEntry *_channel_entry(Entry *, LibDLS::Channel *);
+    static LibDLS::Job *_import_job(Entry *, unsigned int);
+    static void _delete_entry(Entry *);
+};
+
+/*****************************************************************************/
+
+#endif
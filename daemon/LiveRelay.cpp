@@ -0,0 +1,209 @@
+/******************************************************************************
+ *
+ *  This file is part of the Data Logging Service (DLS).
+ *
+ *  DLS is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  DLS is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with DLS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#include <sstream>
+
+#include "LiveRelay.h"
+#include "globals.h"
+
+using namespace std;
+
+/*****************************************************************************/
+
+/** Requested socket buffer size in bytes. The kernel limits it to the
+ * configured maximum. */
+#define LIVE_SOCKET_BUFFER (4 * 1024 * 1024)
+
+/*****************************************************************************/
+
+LiveRelay live_relay;
+
+/*****************************************************************************/
+
+LiveRelay::LiveRelay():
+    _slots(NULL),
+    _size_warned(false)
+{
+    _fds[0] = -1;
+    _fds[1] = -1;
+}
+
+/*****************************************************************************/
+
+LiveRelay::~LiveRelay()
+{
+    if (_slots) {
+        munmap(_slots, LIVE_SLOTS * sizeof(uint32_t));
+    }
+
+    for (int i = 0; i < 2; i++) {
+        if (_fds[i] != -1) {
+            close(_fds[i]);
+        }
+    }
+}
+
+/*****************************************************************************/
+
+/** Creates the socket pair and the shared memory.
+ *
+ * Has to be called by the mother process before forking.
+ *
+ * \return 0 on success, otherwise -1.
+ */
+int LiveRelay::open()
+{
+    int size = LIVE_SOCKET_BUFFER;
+
+    if (_slots) {
+        return 0;
+    }
+
+    void *mem = mmap(NULL, LIVE_SLOTS * sizeof(uint32_t),
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        msg() << "Failed to map live data counters: " << strerror(errno);
+        log(Error);
+        return -1;
+    }
+
+    if (socketpair(AF_UNIX, SOCK_DGRAM, 0, _fds) == -1) {
+        msg() << "Failed to create live data sockets: " << strerror(errno);
+        log(Error);
+        munmap(mem, LIVE_SLOTS * sizeof(uint32_t));
+        _fds[0] = -1;
+        _fds[1] = -1;
+        return -1;
+    }
+
+    fcntl(_fds[0], F_SETFL, fcntl(_fds[0], F_GETFL) | O_NONBLOCK);
+    setsockopt(_fds[0], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(_fds[1], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
+    _slots = (uint32_t *) mem;
+    memset(_slots, 0, LIVE_SLOTS * sizeof(uint32_t));
+    return 0;
+}
+
+/*****************************************************************************/
+
+/** Counts a subscription.
+ *
+ * Called by the mother process. Calls have to be serialized.
+ */
+void LiveRelay::subscribe(
+        unsigned int job_id, /**< Job ID. */
+        unsigned int channel_id /**< Index of the channel directory. */
+        )
+{
+    if (_slots) {
+        __sync_fetch_and_add(&_slots[_slot(job_id, channel_id)], 1);
+    }
+}
+
+/*****************************************************************************/
+
+/** Removes a subscription counted with subscribe().
+ */
+void LiveRelay::unsubscribe(
+        unsigned int job_id, /**< Job ID. */
+        unsigned int channel_id /**< Index of the channel directory. */
+        )
+{
+    if (_slots) {
+        __sync_fetch_and_sub(&_slots[_slot(job_id, channel_id)], 1);
+    }
+}
+
+/*****************************************************************************/
+
+/** Checks, if a channel may have subscribers.
+ *
+ * Channels sharing a counter with a subscribed channel are reported as
+ * well; the mother process discards their blocks.
+ */
+bool LiveRelay::subscribed(
+        unsigned int job_id, /**< Job ID. */
+        unsigned int channel_id /**< Index of the channel directory. */
+        ) const
+{
+    return _slots && ((volatile uint32_t *) _slots)[_slot(job_id, channel_id)];
+}
+
+/*****************************************************************************/
+
+/** Checks a received datagram.
+ *
+ * \return true, if the datagram is valid. Then \a values points to the
+ * values following the header.
+ */
+bool LiveRelay::parse(
+        const char *data, /**< Datagram. */
+        size_t size, /**< Size of the datagram in bytes. */
+        LiveBlockHeader &header, /**< Header. */
+        const double **values /**< Values. */
+        )
+{
+    if (size < sizeof(LiveBlockHeader)) {
+        return false;
+    }
+
+    memcpy(&header, data, sizeof(LiveBlockHeader));
+
+    if (size != sizeof(LiveBlockHeader) + header.count * sizeof(double)) {
+        return false;
+    }
+
+    *values = (const double *) (data + sizeof(LiveBlockHeader));
+    return true;
+}
+
+/*****************************************************************************/
+
+unsigned int LiveRelay::_slot(unsigned int job_id, unsigned int channel_id)
+{
+    return (job_id * 2654435761U + channel_id) % LIVE_SLOTS;
+}
+
+/*****************************************************************************/
+
+void LiveRelay::_send()
+{
+    if (::send(_fds[1], _buffer.data(), _buffer.size(), MSG_DONTWAIT) != -1
+            || errno == EAGAIN || errno == EWOULDBLOCK) {
+        return; // sent or dropped, because the mother process is busy
+    }
+
+    if (errno == EMSGSIZE && !_size_warned) {
+        _size_warned = true;
+        msg() << "Live data block of " << _buffer.size()
+            << " bytes exceeds the socket buffer and is not relayed.";
+        log(Warning);
+    }
+}
+
+/*****************************************************************************/
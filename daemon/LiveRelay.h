@@ -0,0 +1,163 @@
+/******************************************************************************
+ *
+ *  This file is part of the Data Logging Service (DLS).
+ *
+ *  DLS is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  DLS is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with DLS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+#ifndef DLSLiveRelayHpp
+#define DLSLiveRelayHpp
+
+/*****************************************************************************/
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "lib/LibDLS/globals.h"
+#include "lib/LibDLS/Time.h"
+
+/*****************************************************************************/
+
+/** Number of subscription counters in shared memory. */
+#define LIVE_SLOTS 1024
+
+/** Maximum number of values per relayed datagram. Larger blocks are split.
+ */
+#define LIVE_MAX_VALUES 16384
+
+/*****************************************************************************/
+
+/** Header of a relayed block, followed by the values as doubles.
+ */
+struct LiveBlockHeader
+{
+    uint32_t job_id; /**< Job ID. */
+    uint32_t channel_id; /**< Index of the channel directory. */
+    uint64_t start_time; /**< Time of the first value. */
+    uint64_t time_per_value; /**< Time between two values. */
+    uint32_t meta_type; /**< Meta type (LibDLS::MetaType). */
+    uint32_t meta_level; /**< Meta level. */
+    uint32_t count; /**< Number of values. */
+};
+
+/*****************************************************************************/
+
+/** Relays saved blocks from the logging processes to the mother process.
+ *
+ * The mother process opens the relay before forking the logging processes,
+ * which inherit a datagram socket pair and a page of shared memory. The
+ * shared memory holds subscription counters, indexed by a hash of job and
+ * channel, so that a logging process only sends the blocks of channels
+ * that may have subscribers.
+ *
+ * Datagrams are sent without blocking. If the mother process does not
+ * keep up, blocks are dropped; clients can always fetch them from the
+ * data files.
+ */
+class LiveRelay
+{
+public:
+    LiveRelay();
+    ~LiveRelay();
+
+    int open();
+    int read_fd() const { return _fds[0]; }
+
+    void subscribe(unsigned int, unsigned int);
+    void unsubscribe(unsigned int, unsigned int);
+    bool subscribed(unsigned int, unsigned int) const;
+
+    template <class T>
+        void send(unsigned int, unsigned int, LibDLS::MetaType,
+                unsigned int, LibDLS::Time, LibDLS::Time,
+                const T *, unsigned int);
+
+    static bool parse(const char *, size_t, LiveBlockHeader &,
+            const double **);
+
+private:
+    int _fds[2]; /**< Socket pair (read end, write end). */
+    uint32_t *_slots; /**< Subscription counters in shared memory. */
+    std::string _buffer; /**< Datagram buffer. */
+    bool _size_warned; /**< A datagram was too large. */
+
+    static unsigned int _slot(unsigned int, unsigned int);
+    void _send();
+};
+
+/*****************************************************************************/
+
+extern LiveRelay live_relay;
+
+/*****************************************************************************/
+
+/** Relays a saved block.
+ *
+ * Called by the logging processes. Does nothing, if the channel has no
+ * subscribers.
+ */
+template <class T>
+void LiveRelay::send(
+        unsigned int job_id, /**< Job ID. */
+        unsigned int channel_id, /**< Index of the channel directory. */
+        LibDLS::MetaType meta_type, /**< Meta type. */
+        unsigned int meta_level, /**< Meta level. */
+        LibDLS::Time start, /**< Time of the first value. */
+        LibDLS::Time end, /**< Time of the last value. */
+        const T *values, /**< Values. */
+        unsigned int count /**< Number of values. */
+        )
+{
+    LiveBlockHeader header;
+    uint64_t tpv = 0;
+
+    if (!count || !subscribed(job_id, channel_id)) {
+        return;
+    }
+
+    if (count > 1 && end > start) {
+        tpv = (end - start).to_uint64() / (count - 1);
+    }
+
+    header.job_id = job_id;
+    header.channel_id = channel_id;
+    header.time_per_value = tpv;
+    header.meta_type = meta_type;
+    header.meta_level = meta_level;
+
+    for (unsigned int offset = 0; offset < count;
+            offset += LIVE_MAX_VALUES) {
+        header.start_time = start.to_uint64() + tpv * offset;
+        header.count = count - offset;
+        if (header.count > LIVE_MAX_VALUES) {
+            header.count = LIVE_MAX_VALUES;
+        }
+
+        _buffer.assign((const char *) &header, sizeof(header));
+        for (unsigned int i = 0; i < header.count; i++) {
+            double value = (double) values[offset + i];
+            _buffer.append((const char *) &value, sizeof(value));
+        }
+
+        _send();
+    }
+}
+
+/*****************************************************************************/
+
+#endif
@@ -66,6 +66,7 @@ Logger::Logger(
     _gen_saver(NULL),
     _data_size(0),
     _channel_dir_acquired(false),
+    _channel_dir_index(0),
     _chunk_created(false),
     _finished(true),
     _discard_data(false)
@@ -75,6 +76,7 @@ Logger::Logger(
         << " for " << channel_preset->name << endl;
 #endif
 
+    _load_dictionary();
     _subscribe(pv);
 }
 
@@ -238,6 +240,30 @@ void Logger::create_chunk(Time time_of_first)
         tag.push_att("accuracy", _channel_preset.accuracy);
     }
 
+    if (_channel_preset.block_format != BlockFormatXml) {
+        tag.push_att("block_format",
+                block_format_strings[_channel_preset.block_format]);
+    }
+
+    if (_dictionary != "") {
+        // Every chunk keeps the dictionary it was compressed with, so
+        // it stays readable after the channel's dictionary was replaced.
+        ofstream dict_file;
+        string dict_file_name = dir_name.str() + "/zstd.dict";
+
+        dict_file.open(dict_file_name.c_str(), ios::out | ios::binary);
+        dict_file.write(_dictionary.data(), _dictionary.size());
+        dict_file.close();
+
+        if (!dict_file) {
+            file.close();
+            err << "Failed to write \"" << dict_file_name << "\"!";
+            throw ELogger(err.str());
+        }
+
+        tag.push_att("dictionary", "zstd.dict");
+    }
+
     tag.push_att("architecture", arch_str);
 
     file << " " << tag.tag() << endl;
@@ -253,6 +279,55 @@ void Logger::create_chunk(Time time_of_first)
 
 /*****************************************************************************/
 
+/**
+ * Loads the ZStd dictionary of the channel preset.
+ * Relative paths refer to the DLS data directory.
+ * \throw ELogger Failed to read the dictionary.
+ */
+
+void Logger::_load_dictionary()
+{
+    string path = _channel_preset.dictionary;
+    ifstream file;
+    stringstream contents, err;
+
+    _dictionary = "";
+
+    if (_channel_preset.format_index != FORMAT_ZSTD || path == "") {
+        return;
+    }
+
+    if (path[0] != '/') {
+        path = _dls_dir + "/" + path;
+    }
+
+    file.open(path.c_str(), ios::in | ios::binary);
+    if (!file) {
+        err << "Failed to open dictionary \"" << path << "\"!";
+        throw ELogger(err.str());
+    }
+
+    contents << file.rdbuf();
+    if (file.bad()) {
+        err << "Failed to read dictionary \"" << path << "\"!";
+        throw ELogger(err.str());
+    }
+
+    _dictionary = contents.str();
+}
+
+/*****************************************************************************/
+
+/** Returns the ID of the parent job.
+ */
+
+unsigned int Logger::job_id() const
+{
+    return _parent_job->id();
+}
+
+/*****************************************************************************/
+
 /**
  * Searches for a matching channel directory to store data.
  * If no matching directory is found, a new one is created.
@@ -301,6 +376,7 @@ void Logger::_acquire_channel_dir()
         try {
             if (_channel_dir_matches(channel_dir_name)) {
                 _channel_dir_name = channel_dir_name;
+                _channel_dir_index = index;
                 break;
             }
         }
@@ -362,6 +438,7 @@ void Logger::_acquire_channel_dir()
     file.close();
 
     _channel_dir_name = channel_dir_name;
+    _channel_dir_index = highest_index + 1;
 }
 
 /*****************************************************************************/
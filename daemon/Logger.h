@@ -85,6 +85,9 @@ public:
     uint64_t data_size() const {
         return _data_size;
     }
+    const string &dictionary() const {
+        return _dictionary;
+    }
     //@}
 
     //@{
@@ -97,6 +100,10 @@ public:
     const string &chunk_dir_name() const {
         return _chunk_dir_name;
     }
+    unsigned int channel_dir_index() const {
+        return _channel_dir_index;
+    }
+    unsigned int job_id() const;
     //@}
 
     void bytes_written(unsigned int);
@@ -110,6 +117,7 @@ private:
 
     //@{
     LibDLS::ChannelPreset _channel_preset; /**< Aktuelle Kanalvorgaben */
+    string _dictionary; /**< Contents of the ZStd dictionary, if any. */
     //@}
 
     //@{
@@ -121,6 +129,7 @@ private:
     //@{
     bool _channel_dir_acquired; /**< channel directory already acquired */
     string _channel_dir_name; /**< name of the channel directory */
+    unsigned int _channel_dir_index; /**< index of the channel directory */
     bool _chunk_created; /**< the current chunk directory was created */
     string _chunk_dir_name; /**< name of the current chunk directory */
     //@}
@@ -129,6 +138,7 @@ private:
                        kein Datenverlust bei "delete"  */
     bool _discard_data; /**< Discard future data after error. */
 
+    void _load_dictionary();
     void _acquire_channel_dir();
     int _channel_dir_matches(const string &) const;
     void _create_gen_saver();
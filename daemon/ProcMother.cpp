@@ -44,6 +44,7 @@ using namespace std;
 #include "../config.h"
 #include "globals.h"
 #include "ProcMother.h"
+#include "LiveRelay.h"
 
 /*****************************************************************************/
 
@@ -68,6 +69,7 @@ void lib_log(const char *text, void *)
 
 ProcMother::ProcMother():
     _sig_child(0),
+    _sig_usr1(sig_usr1),
     _exit(false),
     _exit_error(false),
 #ifdef DLS_SERVER
@@ -91,7 +93,7 @@ ProcMother::ProcMother():
 ProcMother::~ProcMother()
 {
 #ifdef DLS_SERVER
-    _clear_connections();
+    _server.stop();
 #endif
 
     // Syslog schliessen
@@ -149,8 +151,25 @@ int ProcMother::start(const string &dls_dir, bool no_bind,
     _check_jobs();
 
 #ifdef DLS_SERVER
-    if (!no_bind && _prepare_socket(service.c_str())) {
-        return -1;
+    if (!no_bind) {
+        if (_prepare_socket(service.c_str())) {
+            return -1;
+        }
+
+        LibDLS::set_block_cache_size(
+                (size_t) block_cache_size * 1024 * 1024);
+
+        // must be inherited by the logging processes
+        if (live_relay.open()) {
+            msg() << "Live data will not be available.";
+            log(Warning);
+        }
+
+        if (_server.start(worker_threads, live_relay.read_fd())) {
+            close(_listen_fd);
+            _listen_fd = -1;
+            return -1;
+        }
     }
 #endif
 
@@ -190,11 +209,6 @@ int ProcMother::start(const string &dls_dir, bool no_bind,
             }
         }
 
-#ifdef DLS_SERVER
-        // check for terminated connections
-        _check_connections();
-#endif
-
         ret = select(max_fd + 1, &rfds, NULL, NULL, &tv);
         if (ret == -1) {
             if (errno != EINTR) {
@@ -218,16 +232,14 @@ int ProcMother::start(const string &dls_dir, bool no_bind,
                 msg() << "accept() failed: " << strerror(errno)
                     << " (" << errno << ")";
                 log(Warning);
+                continue;
             }
 
             Connection *conn = new Connection(this, cfd, &peer_addr);
-            _connections.push_back(conn);
 
-            int ret = conn->start_thread();
+            int ret = _server.add(conn);
             if (ret) {
-                _connections.pop_back();
-
-                msg() << "Failed to create connection: " << strerror(ret);
+                msg() << "Failed to add connection: " << strerror(ret);
                 log(Error);
 
                 delete conn;
@@ -250,6 +262,12 @@ int ProcMother::start(const string &dls_dir, bool no_bind,
             close(_listen_fd);
             _listen_fd = -1;
         }
+
+        _server.stop();
+
+        if (block_cache_size) {
+            _log_cache_stats();
+        }
 #endif
 
         msg() << "----- DLS Mother process finished. -----";
@@ -451,6 +469,13 @@ void ProcMother::_check_signals()
         return;
     }
 
+#ifdef DLS_SERVER
+    if (sig_usr1 != _sig_usr1) {
+        _sig_usr1 = sig_usr1;
+        _log_cache_stats();
+    }
+#endif
+
     while (_sig_child != sig_child) {
         _sig_child++;
 
@@ -793,13 +818,13 @@ void ProcMother::_check_processes()
         log(Info);
 
 #ifdef DLS_SERVER
-        _lock_connections();
+        _server.lock_connections();
 #endif
 
         int fork_ret = fork();
 
 #ifdef DLS_SERVER
-        _unlock_connections();
+        _server.unlock_connections();
 #endif
 
         if (!fork_ret) { // Kindprozess
@@ -972,61 +997,21 @@ int ProcMother::_prepare_socket(const char *service)
 
 /*****************************************************************************/
 
-void ProcMother::_check_connections()
+/** Logs the statistics of the decoded block cache.
+ */
+void ProcMother::_log_cache_stats()
 {
-    list<Connection *>::iterator i = _connections.begin();
+    LibDLS::BlockCacheStats stats = LibDLS::block_cache_stats();
+    uint64_t lookups = stats.hits + stats.misses;
 
-    while (i != _connections.end()) {
-        list<Connection *>::iterator cur = i++;
-
-        Connection *conn = *cur;
-        if (conn->thread_finished()) {
-            delete conn;
-            _connections.erase(cur);
-        }
+    msg() << "Block cache: " << stats.blocks << " blocks, "
+        << stats.size / 1024 << " of " << stats.limit / 1024 << " KiB, "
+        << stats.hits << " hits, " << stats.misses << " misses";
+    if (lookups) {
+        msg() << " (" << stats.hits * 100 / lookups << " % hits)";
     }
-}
-
-
-/*****************************************************************************/
-
-void ProcMother::_clear_connections()
-{
-    for (list<Connection *>::iterator i = _connections.begin();
-            i != _connections.end(); i++) {
-        delete *i;
-    }
-
-    _connections.clear();
-}
-
-/*****************************************************************************/
-
-void ProcMother::_lock_connections()
-{
-    msg() << "Locking connection threads...";
+    msg() << ".";
     log(Info);
-
-    for (list<Connection *>::iterator i = _connections.begin();
-            i != _connections.end(); i++) {
-        (*i)->lock();
-    }
-
-    msg() << "Threads locked.";
-    log(Info);
-}
-
-/*****************************************************************************/
-
-void ProcMother::_unlock_connections()
-{
-    msg() << "Unlocking connection threads...";
-    log(Info);
-
-    for (list<Connection *>::iterator i = _connections.begin();
-            i != _connections.end(); i++) {
-        (*i)->unlock();
-    }
 }
 
 #endif
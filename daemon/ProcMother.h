@@ -34,6 +34,8 @@ using namespace std;
 
 #ifdef DLS_SERVER
 #include "Connection.h"
+#include "DirectoryCache.h"
+#include "Server.h"
 #endif
 
 /*****************************************************************************/
@@ -55,17 +57,23 @@ public:
     int start(const string &, bool, const std::string &, bool);
 
     const std::string &dls_dir() const { return _dls_dir; }
+#ifdef DLS_SERVER
+    DirectoryCache &dir_cache() { return _dir_cache; }
+    Server &server() { return _server; }
+#endif
 
 private:
     string _dls_dir; /**< DLS-Datenverzeichnis */
     list<JobPreset> _jobs; /**< Liste von Auftragsvorgaben */
     unsigned int _sig_child; /**< Zhler fr empfangene SIGCHLD-Signale */
+    unsigned int _sig_usr1; /**< Number of received SIGUSR1 signals. */
     bool _exit; /**< true, wenn der Prozess beendet werden soll */
     bool _exit_error; /**< true, wenn Beendigung mit Fehler erfolgen soll */
 #ifdef DLS_SERVER
     int _listen_fd; /**< Listening socket. */
-    list<Connection *> _connections; /**< List of incoming network
-                                       connections. */
+    DirectoryCache _dir_cache; /**< Chunk lists shared by the
+                                 connections. */
+    Server _server; /**< Serves the incoming network connections. */
 #endif
 
     void _empty_spool();
@@ -81,10 +89,7 @@ private:
     unsigned int _processes_running();
 #ifdef DLS_SERVER
     int _prepare_socket(const char *);
-    void _check_connections();
-    void _clear_connections();
-    void _lock_connections();
-    void _unlock_connections();
+    void _log_cache_stats();
 #endif
 };
 
@@ -127,7 +127,11 @@ private:
     bool _savers_created; /**< Wurden bereits alle Meta-Saver erstellt? */
     bool _finished; /**< true, wenn keine Daten mehr im Speicher */
     uint64_t _processed_values; /**< Processed values since start. */
+    LibDLS::Time _period; /**< Expected time between two values. */
+    int64_t _max_deviation; /**< Allowed deviation from _period in
+                              microseconds. */
 
+    void _check_time_diff(LibDLS::Time) const;
     void _fill_buffers(const T *, unsigned int, LibDLS::Time);
 
     //@{
@@ -160,6 +164,9 @@ SaverGenT<T>::SaverGenT(
     _finished(true),
     _processed_values(0)
 {
+    _period.from_dbl_time(
+            1.0 / _parent_logger->channel_preset()->sample_frequency);
+    _max_deviation = _period.to_int64() * ALLOWED_TIME_VARIANCE / 100;
 }
 
 /*****************************************************************************/
@@ -229,49 +236,57 @@ void SaverGenT<T>::process_one(
         LibDLS::Time time
         )
 {
-    LibDLS::Time actual_diff, target_diff;
-    float error_percent;
-    stringstream err;
-
 #if 0
     cerr << time.to_str()
         << " d=" << _time_of_last.diff_str_to(time)
         << " v=" << ((T *) buffer)[0] << endl;
 #endif
 
-    // Wenn Werte in den Puffern sind
+    // Wenn Werte in den Puffern sind, Zeitabstand prfen
     if (_block_buf_index || _meta_buf_index) {
-        // Zeitabstnde errechnen
-        double freq = _parent_logger->channel_preset()->sample_frequency;
-        target_diff.from_dbl_time(1 / freq); // Erwarteter Zeitabstand
-        actual_diff = time - _time_of_last; // Tats. Zeitabstand
-
-        // Relativen Fehler errechnen
-        error_percent = (actual_diff.to_dbl() - target_diff.to_dbl())
-            / target_diff.to_dbl() * 100.0;
-        if (error_percent < 0.0) {
-            error_percent *= -1.0;
-        }
-
-        // Toleranzbereich verletzt?
-        if (error_percent > ALLOWED_TIME_VARIANCE) {
-            // Fehler! Prozess beenden!
-            err << "Time diff of " << actual_diff;
-            err << " us (expected " << target_diff
-                << " us, error is " << error_percent << " %)";
-            err << " at channel \"" << _parent_logger->channel_preset()->name
-                << "\" after processing " << _processed_values << " values.";
-            throw ETimeTolerance(err.str());
-        }
+        _check_time_diff(time - _time_of_last);
     }
 
     // Daten speichern
-    _fill_buffers((T *) buffer, 1, time);
+    _fill_buffers((const T *) buffer, 1, time);
     _processed_values++;
 }
 
 /*****************************************************************************/
 
+/** Checks a time difference against the sample period.
+ *
+ * \throw ETimeTolerance Tolerance error! Terminate the process!
+ */
+template <class T>
+void SaverGenT<T>::_check_time_diff(
+        LibDLS::Time actual_diff /**< Time difference between values. */
+        ) const
+{
+    int64_t deviation = (actual_diff - _period).to_int64();
+
+    if (deviation <= _max_deviation && -deviation <= _max_deviation) {
+        return;
+    }
+
+    // Relativen Fehler errechnen
+    double error_percent = (double) deviation / _period.to_dbl() * 100.0;
+    if (error_percent < 0.0) {
+        error_percent *= -1.0;
+    }
+
+    // Fehler! Prozess beenden!
+    stringstream err;
+    err << "Time diff of " << actual_diff;
+    err << " us (expected " << _period
+        << " us, error is " << error_percent << " %)";
+    err << " at channel \"" << _parent_logger->channel_preset()->name
+        << "\" after processing " << _processed_values << " values.";
+    throw ETimeTolerance(err.str());
+}
+
+/*****************************************************************************/
+
 /**
    Speichern der Daten im Block- und Meta-Puffer
 
@@ -294,18 +309,13 @@ void SaverGenT<T>::_fill_buffers(const T *buffer,
                                     unsigned int length,
                                     LibDLS::Time time_of_first)
 {
-    LibDLS::Time time_of_one;
-    double freq = _parent_logger->channel_preset()->sample_frequency;
-
-    time_of_one.from_dbl_time(1 / freq); // Zeit eines Wertes
-
     // Ab jetzt sind Werte im Speicher!
     _finished = false;
 
     // Alle Werte bernehmen
     for (unsigned int i = 0; i < length; i++) {
         // Zeit des zuletzt eingefgten Wertes setzen
-        _time_of_last = time_of_first + time_of_one * i;
+        _time_of_last = time_of_first + _period * i;
 
         // Bei Blockanfang, Zeiten vermerken
         if (_block_buf_index == 0) {
@@ -23,6 +23,7 @@
 /*****************************************************************************/
 
 #include <string.h>
+#include <zlib.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -45,6 +46,7 @@ using namespace std;
 
 #include "globals.h"
 #include "Logger.h"
+#include "LiveRelay.h"
 
 //#define DEBUG
 
@@ -153,8 +155,20 @@ protected:
 private:
     LibDLS::File _data_file;  /**< Datei-Objekt zum Speichern der Blcke */
     LibDLS::File _index_file; /**< Datei-Objekt zum Speichern der Block-Indizes */
+    LibDLS::File _stat_file; /**< Block statistics, one record per index
+                               record. */
+    const LibDLS::BlockFormat _block_format; /**< Container format of the
+                                               blocks. */
+    LibDLS::CompressionT<T> *_decoder; /**< Decodes the blocks of lossy
+                                         formats, so that the statistics
+                                         match the stored values, or
+                                         NULL. */
 
     void _begin_files(LibDLS::Time);
+    unsigned int _write_block(const LibDLS::Time &, unsigned int);
+    const T *_decode_block();
+    void _calc_stats(LibDLS::IndexStatRecord *, const T *) const;
+    LibDLS::MetaType _meta_type_value() const;
 };
 
 /*****************************************************************************/
@@ -177,7 +191,9 @@ SaverT<T>::SaverT(
     _block_buf_size(_parent_logger->channel_preset()->block_size),
     _meta_buf_index(0U),
     _meta_buf_size(_parent_logger->channel_preset()->meta_reduction),
-    _compression(NULL)
+    _compression(NULL),
+    _block_format(_parent_logger->channel_preset()->block_format),
+    _decoder(NULL)
 {
     stringstream err;
 
@@ -221,10 +237,14 @@ SaverT<T>::SaverT(
             if (typeid(T) == typeid(float)) {
                 _compression = (LibDLS::CompressionT<T> *)
                     new LibDLS::CompressionT_Quant<float>(acc);
+                _decoder = (LibDLS::CompressionT<T> *)
+                    new LibDLS::CompressionT_Quant<float>(0.0);
             }
             else if (typeid(T) == typeid(double)) {
                 _compression = (LibDLS::CompressionT<T> *)
                     new LibDLS::CompressionT_Quant<double>(acc);
+                _decoder = (LibDLS::CompressionT<T> *)
+                    new LibDLS::CompressionT_Quant<double>(0.0);
             }
             else {
                 err << "Quantization only suitable for";
@@ -232,6 +252,44 @@ SaverT<T>::SaverT(
                     << typeid(T).name() << "!";
             }
         }
+        else if (_parent_logger->channel_preset()->format_index
+                 == LibDLS::FORMAT_DELTA) {
+            if (typeid(T) == typeid(float) || typeid(T) == typeid(double)) {
+                err << "Delta coding only suitable for";
+                err << " integer types, not for "
+                    << typeid(T).name() << "!";
+            }
+            else {
+                _compression = new LibDLS::CompressionT_Delta<T>();
+            }
+        }
+        else if (_parent_logger->channel_preset()->format_index
+                 == LibDLS::FORMAT_XOR) {
+            if (typeid(T) == typeid(float)) {
+                _compression = (LibDLS::CompressionT<T> *)
+                    new LibDLS::CompressionT_XOR<float>();
+            }
+            else if (typeid(T) == typeid(double)) {
+                _compression = (LibDLS::CompressionT<T> *)
+                    new LibDLS::CompressionT_XOR<double>();
+            }
+            else {
+                err << "XOR coding only suitable for";
+                err << " floating point types, not for "
+                    << typeid(T).name() << "!";
+            }
+        }
+        else if (_parent_logger->channel_preset()->format_index
+                 == LibDLS::FORMAT_ZSTD) {
+            if (!LibDLS::ZStd::available()) {
+                err << "DLS was built without zstd support!";
+            }
+            else {
+                _compression = new LibDLS::CompressionT_ZStd<T>(
+                        _parent_logger->channel_preset()->compression_level,
+                        _parent_logger->dictionary());
+            }
+        }
         else {
             err << "Unknown channel format index "
                 << _parent_logger->channel_preset()->format_index;
@@ -247,6 +305,11 @@ SaverT<T>::SaverT(
     if (err.str() != "") {
         throw ESaver(err.str());
     }
+
+    _compression->set_base64(_block_format == LibDLS::BlockFormatXml);
+    if (_decoder) {
+        _decoder->set_base64(_block_format == LibDLS::BlockFormatXml);
+    }
 }
 
 /*****************************************************************************/
@@ -262,6 +325,7 @@ template <class T>
 SaverT<T>::~SaverT()
 {
     if (_compression) delete _compression;
+    if (_decoder) delete _decoder;
     if (_block_buf) delete [] _block_buf;
     if (_meta_buf) delete [] _meta_buf;
 }
@@ -290,8 +354,11 @@ template <class T>
 void SaverT<T>::_save_block()
 {
     LibDLS::IndexRecord index_record;
-    stringstream pre, post, err;
+    LibDLS::IndexStatRecord stat_record;
+    stringstream err;
     LibDLS::Time start_time, end_time;
+    unsigned int bytes;
+    const T *values;
 
     // Wenn keine Daten im Puffer sind, beenden.
     if (_block_buf_index == 0) return;
@@ -327,23 +394,16 @@ void SaverT<T>::_save_block()
         throw ESaver(err.str());
     }
 
+    // Statistik der gespeicherten (bei verlustbehafteten Formaten der
+    // dekodierten) Werte
+    values = _decode_block();
+    _calc_stats(&stat_record, values);
+
     start_time.set_now(); // Zeiterfassung
 
     try
     {
-        // Tag-Anfang in die Datei schreiben
-        pre << "<d t=\"" << _block_time << "\"";
-        pre << " s=\"" << _block_buf_index << "\"";
-        pre << " d=\"";
-        _data_file.append(pre.str().c_str(), pre.str().length());
-
-        // Komprimierte Daten in die Datei schreiben
-        _data_file.append(_compression->compression_output(),
-                          _compression->compressed_size());
-
-        // Tag-Ende in die Datei schreiben
-        post << "\"/>" << endl;
-        _data_file.append(post.str().c_str(), post.str().length());
+        bytes = _write_block(_block_time, _block_buf_index);
     }
     catch (LibDLS::EFile &e)
     {
@@ -365,12 +425,15 @@ void SaverT<T>::_save_block()
     _compression->free();
 
     // Dem Logger mitteilen, dass Daten gespeichert wurden
-    _parent_logger->bytes_written(pre.str().length()
-                                  + _compression->compressed_size()
-                                  + post.str().length());
+    _parent_logger->bytes_written(bytes);
 
     try
     {
+        // Statistik vor dem Index schreiben: Fehlt ein Statistik-Record,
+        // wird der Block beim Lesen dekomprimiert.
+        _stat_file.append((char *) &stat_record,
+                sizeof(LibDLS::IndexStatRecord));
+
         // Index aktualisieren
         _index_file.append((char *) &index_record,
                 sizeof(LibDLS::IndexRecord));
@@ -382,7 +445,22 @@ void SaverT<T>::_save_block()
     }
 
     // Dem Logger mitteilen, dass Daten gespeichert wurden
-    _parent_logger->bytes_written(sizeof(LibDLS::IndexRecord));
+    _parent_logger->bytes_written(sizeof(LibDLS::IndexRecord)
+            + sizeof(LibDLS::IndexStatRecord));
+
+    // Block an abonnierte Clients weiterreichen, mit denselben Werten, die
+    // eine sptere Datenanfrage liefert
+    if (values && live_relay.subscribed(_parent_logger->job_id(),
+                _parent_logger->channel_dir_index())) {
+        live_relay.send(_parent_logger->job_id(),
+                _parent_logger->channel_dir_index(), _meta_type_value(),
+                _meta_level(), _block_time, _time_of_last, values,
+                _block_buf_index);
+    }
+
+    if (_decoder) {
+        _decoder->free();
+    }
 
     _block_buf_index = 0;
 }
@@ -401,8 +479,8 @@ void SaverT<T>::_save_block()
 template <class T>
 void SaverT<T>::_save_rest()
 {
-    stringstream pre, post, err;
-    LibDLS::Time start_time, end_time;
+    stringstream err;
+    unsigned int bytes;
 
 #ifdef DEBUG
     msg() << "Saving rest";
@@ -431,17 +509,8 @@ void SaverT<T>::_save_rest()
     {
         try
         {
-            // Tag-Anfang in Datei schreiben
-            pre << "<d t=\"0\" s=\"0\" d=\"";
-            _data_file.append(pre.str().c_str(), pre.str().length());
-
-            // Komprimierte Daten in die Datei schreiben
-            _data_file.append(_compression->compression_output(),
-                              _compression->compressed_size());
-
-            // Tag-Ende anhngen
-            post << "\"/>" << endl;
-            _data_file.append(post.str().c_str(), post.str().length());
+            // berhang ohne Zeit und Lnge schreiben
+            bytes = _write_block(LibDLS::Time(), 0);
         }
         catch (LibDLS::EFile &e)
         {
@@ -453,9 +522,7 @@ void SaverT<T>::_save_rest()
         _compression->free();
 
         // Dem Logger mitteilen, dass Daten gespeichert wurden
-        _parent_logger->bytes_written(pre.str().length()
-                                      + _compression->compressed_size()
-                                      + post.str().length());
+        _parent_logger->bytes_written(bytes);
     }
 
 #ifdef DEBUG
@@ -466,6 +533,173 @@ void SaverT<T>::_save_rest()
 
 /*****************************************************************************/
 
+/**
+   Returns the meta type as enumeration value.
+*/
+
+template <class T>
+LibDLS::MetaType SaverT<T>::_meta_type_value() const
+{
+    string type = _meta_type();
+
+    if (type == LibDLS::meta_type_str(LibDLS::MetaMean)) {
+        return LibDLS::MetaMean;
+    }
+    if (type == LibDLS::meta_type_str(LibDLS::MetaMin)) {
+        return LibDLS::MetaMin;
+    }
+    if (type == LibDLS::meta_type_str(LibDLS::MetaMax)) {
+        return LibDLS::MetaMax;
+    }
+
+    return LibDLS::MetaGen;
+}
+
+/*****************************************************************************/
+
+/**
+   Returns the values of the compressed block, as a reader will decode them.
+
+   For lossless formats, these are the values of the block buffer. Blocks
+   of lossy formats are decoded again. MDCT blocks depend on their
+   predecessors and can not be decoded on their own.
+
+   \return Values, or NULL, if unknown.
+*/
+
+template <class T>
+const T *SaverT<T>::_decode_block()
+{
+    if (_parent_logger->channel_preset()->format_index
+            == LibDLS::FORMAT_MDCT) {
+        return NULL;
+    }
+
+    if (!_decoder) {
+        return _block_buf;
+    }
+
+    try {
+        _decoder->uncompress(_compression->compression_output(),
+                _compression->compressed_size(), _block_buf_index);
+    }
+    catch (LibDLS::ECompression &e) {
+        msg() << "Failed to decode block: " << e.msg;
+        log(Warning);
+        return NULL;
+    }
+
+    if (_decoder->decompressed_length() != _block_buf_index) {
+        return NULL;
+    }
+
+    return _decoder->decompression_output();
+}
+
+/*****************************************************************************/
+
+/**
+   Calculates the statistics of the values of a block.
+
+   Without values, an empty record is created. Readers then decode the
+   block instead.
+*/
+
+template <class T>
+void SaverT<T>::_calc_stats(
+        LibDLS::IndexStatRecord *stat,
+        const T *values /**< Block values, or NULL. */
+        ) const
+{
+    double value, min, max, sum = 0.0;
+
+    if (!values) {
+        stat->min = stat->max = stat->mean = 0.0;
+        stat->count = 0;
+        return;
+    }
+
+    min = max = (double) values[0];
+
+    for (unsigned int i = 0; i < _block_buf_index; i++) {
+        value = (double) values[i];
+        if (value < min) {
+            min = value;
+        }
+        if (value > max) {
+            max = value;
+        }
+        sum += value;
+    }
+
+    stat->min = min;
+    stat->max = max;
+    stat->mean = sum / _block_buf_index;
+    stat->count = _block_buf_index;
+}
+
+/*****************************************************************************/
+
+/**
+   Writes the current compression output as a block to the data file.
+
+   Depending on the block format of the channel preset, the block is either
+   written as an XML tag with Base64-encoded data, or as a binary block
+   header followed by the raw compressed data.
+
+   \param time Time of the first value (null for a rest block)
+   \param length Number of values (0 for a rest block)
+   \return Number of bytes written
+   \throw LibDLS::EFile Failed to write to the data file
+*/
+
+template <class T>
+unsigned int SaverT<T>::_write_block(
+        const LibDLS::Time &time,
+        unsigned int length
+        )
+{
+    if (_block_format == LibDLS::BlockFormatBinary) {
+        LibDLS::BlockHeader header;
+
+        header.magic = DLS_BLOCK_MAGIC;
+        header.start_time = time.to_uint64();
+        header.length = length;
+        header.size = _compression->compressed_size();
+        header.checksum = crc32(0L,
+                (const Bytef *) _compression->compression_output(),
+                _compression->compressed_size());
+
+        _data_file.append((const char *) &header,
+                sizeof(LibDLS::BlockHeader));
+        _data_file.append(_compression->compression_output(),
+                _compression->compressed_size());
+
+        return sizeof(LibDLS::BlockHeader) + _compression->compressed_size();
+    }
+
+    stringstream pre, post;
+
+    // Tag-Anfang in die Datei schreiben
+    pre << "<d t=\"" << time << "\"";
+    pre << " s=\"" << length << "\"";
+    pre << " d=\"";
+    _data_file.append(pre.str().c_str(), pre.str().length());
+
+    // Komprimierte Daten in die Datei schreiben
+    _data_file.append(_compression->compression_output(),
+                      _compression->compressed_size());
+
+    // Tag-Ende in die Datei schreiben
+    post << "\"/>" << endl;
+    _data_file.append(post.str().c_str(), post.str().length());
+
+    return pre.str().length() + _compression->compressed_size()
+        + post.str().length();
+}
+
+/*****************************************************************************/
+
 /**
    ffnet neue Daten- und Indexdateien
 
@@ -538,6 +772,20 @@ void SaverT<T>::_begin_files(LibDLS::Time time_of_first)
         throw ESaver(err.str());
     }
 
+    file_name.str("");
+    file_name.clear();
+    file_name << dir_name.str() << "/data" << time_of_first
+        << "_" << _meta_type() << ".stat";
+
+    try {
+        _stat_file.open_read_append(file_name.str().c_str());
+    }
+    catch (LibDLS::EFile &e) {
+        err << "Failed to open statistics file \"" << file_name.str();
+        err << "\": " << e.msg;
+        throw ESaver(err.str());
+    }
+
     // Globalen Index updaten
     file_name.str("");
     file_name.clear();
@@ -603,6 +851,16 @@ void SaverT<T>::_finish_files()
         log(Warning);
     }
 
+    try
+    {
+        _stat_file.close();
+    }
+    catch (LibDLS::EFile &e)
+    {
+        msg() << "Could not close statistics file: " << e.msg;
+        log(Warning);
+    }
+
     // Wenn Dateien geffnet waren und Daten hineingeschrieben wurden
     if (was_open && _time_of_last.to_uint64() != 0)
     {
@@ -0,0 +1,769 @@
+/******************************************************************************
+ *
+ *  This file is part of the Data Logging Service (DLS).
+ *
+ *  DLS is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  DLS is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with DLS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <sstream>
+
+#include "Server.h"
+#include "LiveRelay.h"
+#include "globals.h"
+
+using namespace std;
+
+/*****************************************************************************/
+
+/** Maximum number of events handled per epoll_wait() call. */
+#define IO_MAX_EVENTS 64
+
+/** Maximum number of relayed blocks received per event. */
+#define LIVE_MAX_DATAGRAMS 64
+
+/** Maximum number of workers as a multiple of the configured pool size.
+ * Above it, workers waiting for slow clients are not replaced any more. */
+#define MAX_WORKERS_FACTOR 4
+
+/*****************************************************************************/
+
+Server::Server():
+    _pid(0),
+    _epoll_fd(-1),
+    _wake_fd(-1),
+    _pool_size(0),
+    _waiting(0),
+    _stop(false),
+    _live_fd(-1),
+    _live_buffer(sizeof(LiveBlockHeader) + LIVE_MAX_VALUES * sizeof(double))
+{
+    pthread_mutex_init(&_mutex, NULL);
+    pthread_cond_init(&_cond, NULL);
+    pthread_mutex_init(&_live_mutex, NULL);
+}
+
+/*****************************************************************************/
+
+Server::~Server()
+{
+    stop();
+
+    pthread_mutex_destroy(&_live_mutex);
+    pthread_cond_destroy(&_cond);
+    pthread_mutex_destroy(&_mutex);
+}
+
+/*****************************************************************************/
+
+/** Starts the I/O thread and the workers.
+ *
+ * \return 0 on success, otherwise -1.
+ */
+int Server::start(
+        unsigned int workers, /**< Number of worker threads. */
+        int live_fd /**< Socket receiving relayed blocks (see LiveRelay), or
+                      -1. */
+        )
+{
+    struct epoll_event ev;
+    int ret;
+
+    _epoll_fd = epoll_create1(0);
+    if (_epoll_fd == -1) {
+        msg() << "Failed to create event poll: " << strerror(errno);
+        log(Error);
+        return -1;
+    }
+
+    _wake_fd = eventfd(0, EFD_NONBLOCK);
+    if (_wake_fd == -1) {
+        msg() << "Failed to create event descriptor: " << strerror(errno);
+        log(Error);
+        stop();
+        return -1;
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wake_fd, &ev) == -1) {
+        msg() << "Failed to poll event descriptor: " << strerror(errno);
+        log(Error);
+        stop();
+        return -1;
+    }
+
+    if (live_fd != -1) {
+        ev.events = EPOLLIN;
+        ev.data.ptr = this;
+        if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, live_fd, &ev) == -1) {
+            msg() << "Failed to poll live data socket: " << strerror(errno);
+            log(Warning);
+        }
+        else {
+            _live_fd = live_fd;
+        }
+    }
+
+    _stop = false;
+    _pid = getpid();
+
+    ret = pthread_create(&_io_thread, NULL, _io_static, this);
+    if (ret) {
+        msg() << "Failed to create I/O thread: " << strerror(ret);
+        log(Error);
+        _pid = 0;
+        stop();
+        return -1;
+    }
+
+    if (!workers) {
+        workers = 1;
+    }
+
+    pthread_mutex_lock(&_mutex);
+    _pool_size = workers;
+    _waiting = 0;
+    for (unsigned int i = 0; i < workers; i++) {
+        if (!_start_worker()) {
+            break;
+        }
+    }
+    unsigned int started = _workers.size();
+    pthread_mutex_unlock(&_mutex);
+
+    if (!started) {
+        stop();
+        return -1;
+    }
+
+    msg() << "Serving connections with " << started
+        << " worker thread(s).";
+    log(Info);
+
+    return 0;
+}
+
+/*****************************************************************************/
+
+/** Stops the threads and closes all connections.
+ */
+void Server::stop()
+{
+    if (_pid && _pid == getpid()) {
+        pthread_mutex_lock(&_mutex);
+        _stop = true;
+        for (set<Connection *>::iterator i = _connections.begin();
+                i != _connections.end(); i++) {
+            (*i)->cancel();
+        }
+        pthread_cond_broadcast(&_cond);
+        pthread_mutex_unlock(&_mutex);
+
+        _wake();
+
+        // no workers are started or retired any more
+        pthread_join(_io_thread, NULL);
+        for (vector<pthread_t>::iterator i = _workers.begin();
+                i != _workers.end(); i++) {
+            pthread_join(*i, NULL);
+        }
+        _join_retired();
+
+        for (set<Connection *>::iterator i = _connections.begin();
+                i != _connections.end(); i++) {
+            _unsubscribe_all(*i);
+            delete *i;
+        }
+    }
+    else {
+        // In a forked logging process, the threads do not exist, and the
+        // connections may still be locked by them. Only close the sockets.
+        for (set<Connection *>::iterator i = _connections.begin();
+                i != _connections.end(); i++) {
+            close((*i)->fd());
+        }
+    }
+
+    _workers.clear();
+    _retired.clear();
+    _connections.clear();
+    _ready.clear();
+    _closing.clear();
+    _subscriptions.clear();
+    _live_fd = -1; // owned by the LiveRelay
+    _pid = 0;
+
+    if (_wake_fd != -1) {
+        close(_wake_fd);
+        _wake_fd = -1;
+    }
+
+    if (_epoll_fd != -1) {
+        close(_epoll_fd);
+        _epoll_fd = -1;
+    }
+}
+
+/*****************************************************************************/
+
+/** Adds a new connection.
+ *
+ * The server takes ownership of the connection.
+ *
+ * \return 0 on success, otherwise an error code. In this case, the
+ * connection is not adopted.
+ */
+int Server::add(Connection *conn)
+{
+    struct epoll_event ev;
+
+    if (!_pid) {
+        return EINVAL;
+    }
+
+    pthread_mutex_lock(&_mutex);
+
+    conn->_epoll_fd = _epoll_fd;
+    conn->_events = EPOLLIN;
+
+    ev.events = conn->_events;
+    ev.data.ptr = conn;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, conn->fd(), &ev) == -1) {
+        int err = errno;
+        conn->_epoll_fd = -1;
+        pthread_mutex_unlock(&_mutex);
+        return err;
+    }
+
+    _connections.insert(conn);
+
+    pthread_mutex_unlock(&_mutex);
+
+    conn->send_hello();
+    return 0;
+}
+
+/*****************************************************************************/
+
+/** Locks all connections.
+ *
+ * Waits for the workers to finish their current requests (see
+ * ProcMother::_check_jobs()).
+ */
+void Server::lock_connections()
+{
+    msg() << "Locking connection threads...";
+    log(Info);
+
+    pthread_mutex_lock(&_mutex);
+
+    for (set<Connection *>::iterator i = _connections.begin();
+            i != _connections.end(); i++) {
+        (*i)->lock();
+    }
+
+    msg() << "Threads locked.";
+    log(Info);
+}
+
+/*****************************************************************************/
+
+void Server::unlock_connections()
+{
+    msg() << "Unlocking connection threads...";
+    log(Info);
+
+    for (set<Connection *>::iterator i = _connections.begin();
+            i != _connections.end(); i++) {
+        (*i)->unlock();
+    }
+
+    pthread_mutex_unlock(&_mutex);
+}
+
+/*****************************************************************************/
+
+/** Notifies, that a worker starts waiting for a slow client.
+ *
+ * Has to be called without a connection mutex held. Another worker is
+ * started in place of the waiting one, so that it does not reduce the
+ * number of workers available for the other connections. The number of
+ * threads is limited to MAX_WORKERS_FACTOR times the pool size, though.
+ */
+void Server::begin_wait()
+{
+    pthread_mutex_lock(&_mutex);
+
+    _waiting++;
+
+    if (!_stop && _workers.size() - _waiting < _pool_size
+            && _workers.size() < _pool_size * MAX_WORKERS_FACTOR) {
+        _start_worker();
+    }
+
+    pthread_mutex_unlock(&_mutex);
+}
+
+/*****************************************************************************/
+
+/** Notifies, that a worker stopped waiting for a client.
+ *
+ * One of the workers terminates after its current request, if there are
+ * more than configured.
+ */
+void Server::end_wait()
+{
+    pthread_mutex_lock(&_mutex);
+    _waiting--;
+    pthread_mutex_unlock(&_mutex);
+}
+
+/*****************************************************************************/
+
+void *Server::_io_static(void *arg)
+{
+    ((Server *) arg)->_io_run();
+    return NULL;
+}
+
+/*****************************************************************************/
+
+void Server::_io_run()
+{
+    struct epoll_event events[IO_MAX_EVENTS];
+
+    while (1) {
+        pthread_mutex_lock(&_mutex);
+        _delete_closing();
+        bool stop = _stop;
+        pthread_mutex_unlock(&_mutex);
+
+        if (stop) {
+            break;
+        }
+
+        int count = epoll_wait(_epoll_fd, events, IO_MAX_EVENTS, -1);
+        if (count == -1) {
+            if (errno != EINTR) {
+                msg() << "epoll_wait() failed: " << strerror(errno);
+                log(Error);
+                break;
+            }
+            continue;
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (!events[i].data.ptr) {
+                uint64_t value;
+                if (read(_wake_fd, &value, sizeof(value)) == -1) {
+                    // nothing to reset
+                }
+                continue;
+            }
+
+            if (events[i].data.ptr == this) {
+                _receive_live();
+                continue;
+            }
+
+            Connection *conn = (Connection *) events[i].data.ptr;
+            bool ok = !(events[i].events & EPOLLERR);
+
+            if (ok && events[i].events & (EPOLLIN | EPOLLHUP)) {
+                ok = conn->read_socket();
+            }
+
+            if (ok && events[i].events & EPOLLOUT) {
+                ok = conn->write_socket();
+            }
+
+            pthread_mutex_lock(&_mutex);
+            if (!ok) {
+                _close(conn);
+            }
+            else if (!conn->_queued && !conn->_closed
+                    && conn->request_pending()) {
+                conn->_queued = true;
+                _ready.push_back(conn);
+                pthread_cond_signal(&_cond);
+            }
+            pthread_mutex_unlock(&_mutex);
+        }
+    }
+}
+
+/*****************************************************************************/
+
+void *Server::_worker_static(void *arg)
+{
+    ((Server *) arg)->_worker_run();
+    return NULL;
+}
+
+/*****************************************************************************/
+
+void Server::_worker_run()
+{
+    pthread_mutex_lock(&_mutex);
+
+    while (1) {
+        if (!_stop && _workers.size() - _waiting > _pool_size) {
+            // surplus worker, that was started for a waiting one
+            for (vector<pthread_t>::iterator i = _workers.begin();
+                    i != _workers.end(); i++) {
+                if (pthread_equal(*i, pthread_self())) {
+                    _retired.push_back(*i);
+                    _workers.erase(i);
+                    break;
+                }
+            }
+            break;
+        }
+
+        while (!_stop && _ready.empty()) {
+            pthread_cond_wait(&_cond, &_mutex);
+        }
+
+        if (_stop) {
+            break;
+        }
+
+        Connection *conn = _ready.front();
+        _ready.pop_front();
+
+        if (!conn->_closed) {
+            pthread_mutex_unlock(&_mutex);
+            conn->process_request();
+            pthread_mutex_lock(&_mutex);
+
+            if (!conn->running()) {
+                _close(conn);
+            }
+        }
+
+        if (!conn->_closed && conn->request_pending()) {
+            // give the other clients a chance first
+            _ready.push_back(conn);
+            pthread_cond_signal(&_cond);
+            continue;
+        }
+
+        conn->_queued = false;
+
+        if (conn->_closed) {
+            _closing.push_back(conn);
+            _wake();
+        }
+    }
+
+    pthread_mutex_unlock(&_mutex);
+}
+
+/*****************************************************************************/
+
+/** Starts a worker thread.
+ *
+ * Has to be called with the mutex locked.
+ *
+ * \return true on success.
+ */
+bool Server::_start_worker()
+{
+    pthread_t thread;
+    int ret;
+
+    _join_retired();
+
+    ret = pthread_create(&thread, NULL, _worker_static, this);
+    if (ret) {
+        msg() << "Failed to create worker thread: " << strerror(ret);
+        log(Warning);
+        return false;
+    }
+
+    _workers.push_back(thread);
+    return true;
+}
+
+/*****************************************************************************/
+
+/** Joins the terminated surplus workers.
+ *
+ * Has to be called with the mutex locked or after the workers were stopped.
+ * A retired worker only returns after releasing the mutex.
+ */
+void Server::_join_retired()
+{
+    for (vector<pthread_t>::iterator i = _retired.begin();
+            i != _retired.end(); i++) {
+        pthread_join(*i, NULL);
+    }
+
+    _retired.clear();
+}
+
+/*****************************************************************************/
+
+/** Wakes up the I/O thread.
+ */
+void Server::_wake()
+{
+    uint64_t value = 1;
+
+    if (write(_wake_fd, &value, sizeof(value)) == -1) {
+        // counter already pending
+    }
+}
+
+/*****************************************************************************/
+
+/** Removes a lost connection from the event poll.
+ *
+ * Has to be called with the mutex locked. The connection is deleted by the
+ * I/O thread, as soon as it is not queued any more.
+ */
+void Server::_close(Connection *conn)
+{
+    if (conn->_closed) {
+        return;
+    }
+
+    conn->_closed = true;
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, conn->fd(), NULL);
+    conn->cancel();
+    _unsubscribe_all(conn);
+
+    if (!conn->_queued) {
+        _closing.push_back(conn);
+    }
+}
+
+/*****************************************************************************/
+
+/** Deletes the lost connections.
+ *
+ * Has to be called by the I/O thread with the mutex locked.
+ */
+void Server::_delete_closing()
+{
+    for (list<Connection *>::iterator i = _closing.begin();
+            i != _closing.end(); i++) {
+        _connections.erase(*i);
+        _unsubscribe_all(*i); // subscribed by a request in progress
+        delete *i;
+    }
+
+    _closing.clear();
+}
+
+/*****************************************************************************/
+
+/** Subscribes a connection to the live data of a channel.
+ *
+ * An existing subscription of the connection is updated.
+ */
+void Server::subscribe(
+        Connection *conn, /**< Connection. */
+        unsigned int job_id, /**< Job ID. */
+        unsigned int channel_id, /**< Index of the channel directory. */
+        LibDLS::Data::Encoding encoding, /**< Value encoding. */
+        LibDLS::ChannelType type, /**< Channel type. */
+        bool meta /**< Also push meta levels. */
+        )
+{
+    pthread_mutex_lock(&_live_mutex);
+
+    list<Subscription> &subs =
+        _subscriptions[ChannelKey(job_id, channel_id)];
+    list<Subscription>::iterator sub_i;
+    for (sub_i = subs.begin(); sub_i != subs.end(); sub_i++) {
+        if (sub_i->conn == conn) {
+            break;
+        }
+    }
+
+    if (sub_i == subs.end()) {
+        subs.push_back(Subscription());
+        sub_i = --subs.end();
+        sub_i->conn = conn;
+        sub_i->dropped = 0;
+        live_relay.subscribe(job_id, channel_id);
+    }
+
+    sub_i->encoding = encoding;
+    sub_i->type = type;
+    sub_i->meta = meta;
+
+    pthread_mutex_unlock(&_live_mutex);
+}
+
+/*****************************************************************************/
+
+/** Cancels a subscription of a connection.
+ */
+void Server::unsubscribe(
+        Connection *conn, /**< Connection. */
+        unsigned int job_id, /**< Job ID. */
+        unsigned int channel_id /**< Index of the channel directory. */
+        )
+{
+    pthread_mutex_lock(&_live_mutex);
+
+    map<ChannelKey, list<Subscription> >::iterator s =
+        _subscriptions.find(ChannelKey(job_id, channel_id));
+
+    if (s != _subscriptions.end()) {
+        for (list<Subscription>::iterator sub_i = s->second.begin();
+                sub_i != s->second.end(); sub_i++) {
+            if (sub_i->conn == conn) {
+                s->second.erase(sub_i);
+                live_relay.unsubscribe(job_id, channel_id);
+                break;
+            }
+        }
+
+        if (s->second.empty()) {
+            _subscriptions.erase(s);
+        }
+    }
+
+    pthread_mutex_unlock(&_live_mutex);
+}
+
+/*****************************************************************************/
+
+/** Receives blocks from the logging processes.
+ */
+void Server::_receive_live()
+{
+    for (unsigned int i = 0; i < LIVE_MAX_DATAGRAMS; i++) {
+        ssize_t size = recv(_live_fd, &_live_buffer[0], _live_buffer.size(),
+                MSG_DONTWAIT);
+
+        if (size == -1) {
+            if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
+                msg() << "Failed to receive live data: " << strerror(errno);
+                log(Warning);
+            }
+            return;
+        }
+
+        _dispatch_live(&_live_buffer[0], size);
+    }
+}
+
+/*****************************************************************************/
+
+/** Pushes a relayed block to the subscribed connections.
+ *
+ * A block is dropped for a connection, whose send buffer is full. The next
+ * block pushed to it carries the number of dropped blocks, so that the
+ * client knows about the gap.
+ */
+void Server::_dispatch_live(
+        const char *buffer, /**< Datagram. */
+        size_t size /**< Size of the datagram. */
+        )
+{
+    LiveBlockHeader header;
+    const double *values;
+
+    if (!LiveRelay::parse(buffer, size, header, &values)) {
+        return;
+    }
+
+    pthread_mutex_lock(&_live_mutex);
+
+    map<ChannelKey, list<Subscription> >::iterator s =
+        _subscriptions.find(ChannelKey(header.job_id, header.channel_id));
+
+    if (s != _subscriptions.end()) {
+        LibDLS::Data data;
+        unsigned int decimationCounter = 0;
+
+        data.import(LibDLS::Time(header.start_time),
+                LibDLS::Time(header.time_per_value),
+                (LibDLS::MetaType) header.meta_type, header.meta_level,
+                1, decimationCounter, values, header.count);
+
+        for (list<Subscription>::iterator sub_i = s->second.begin();
+                sub_i != s->second.end(); sub_i++) {
+            if (header.meta_level && !sub_i->meta) {
+                continue;
+            }
+
+            DlsProto::Response res;
+            DlsProto::LiveData *live = res.mutable_live();
+            live->set_job_id(header.job_id);
+            live->set_channel_id(header.channel_id);
+            data.set_data_msg(live->mutable_data(), sub_i->encoding,
+                    sub_i->type);
+            if (sub_i->dropped) {
+                live->set_dropped(sub_i->dropped);
+            }
+
+            if (sub_i->conn->push(res)) {
+                sub_i->dropped = 0;
+            }
+            else {
+                sub_i->dropped++;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&_live_mutex);
+}
+
+/*****************************************************************************/
+
+/** Cancels all subscriptions of a connection.
+ */
+void Server::_unsubscribe_all(Connection *conn)
+{
+    pthread_mutex_lock(&_live_mutex);
+
+    map<ChannelKey, list<Subscription> >::iterator s =
+        _subscriptions.begin();
+
+    while (s != _subscriptions.end()) {
+        map<ChannelKey, list<Subscription> >::iterator cur = s++;
+        list<Subscription>::iterator sub_i = cur->second.begin();
+
+        while (sub_i != cur->second.end()) {
+            if (sub_i->conn == conn) {
+                sub_i = cur->second.erase(sub_i);
+                live_relay.unsubscribe(cur->first.first, cur->first.second);
+            }
+            else {
+                sub_i++;
+            }
+        }
+
+        if (cur->second.empty()) {
+            _subscriptions.erase(cur);
+        }
+    }
+
+    pthread_mutex_unlock(&_live_mutex);
+}
+
+/*****************************************************************************/
@@ -0,0 +1,143 @@
+/******************************************************************************
+ *
+ *  This file is part of the Data Logging Service (DLS).
+ *
+ *  DLS is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  DLS is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with DLS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+#ifndef DLSServerHpp
+#define DLSServerHpp
+
+/*****************************************************************************/
+
+#include <pthread.h>
+#include <sys/types.h>
+
+#include <deque>
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "Connection.h"
+
+/*****************************************************************************/
+
+/** Event loop and worker pool serving the network connections.
+ *
+ * A single I/O thread polls all client sockets with epoll(7). It receives
+ * the requests and sends the buffered responses. Connections with complete
+ * requests are queued for a fixed number of worker threads.
+ *
+ * A worker processes only one request of a connection and then puts the
+ * connection at the end of the queue, if it has more requests pending. So
+ * a client that pipelines many requests can not occupy the workers, while
+ * other clients are waiting.
+ *
+ * A worker streaming a large response to a slow client has to wait for the
+ * client (see Connection::_wait_for_send_buffer()). While it waits, it does
+ * not count as a member of the pool, and an additional worker is started in
+ * its place, so the other clients are still served by the configured number
+ * of workers. The total number of workers is limited to a multiple of the
+ * configured number, so many slow clients can still delay the others, but
+ * not exhaust the threads. Surplus workers terminate after their current
+ * request.
+ *
+ * Lost connections are deleted by the I/O thread only, as soon as no worker
+ * is processing them.
+ *
+ * The I/O thread also receives the blocks relayed by the logging processes
+ * (see LiveRelay) and pushes them to the subscribed connections.
+ */
+class Server
+{
+public:
+    Server();
+    ~Server();
+
+    int start(unsigned int, int = -1);
+    void stop();
+
+    int add(Connection *);
+
+    void subscribe(Connection *, unsigned int, unsigned int,
+            LibDLS::Data::Encoding, LibDLS::ChannelType, bool);
+    void unsubscribe(Connection *, unsigned int, unsigned int);
+
+    void lock_connections();
+    void unlock_connections();
+
+    void begin_wait();
+    void end_wait();
+
+private:
+    /** Live data subscription of a connection. */
+    struct Subscription {
+        Connection *conn; /**< Subscribed connection. */
+        LibDLS::Data::Encoding encoding; /**< Value encoding. */
+        LibDLS::ChannelType type; /**< Channel type for raw encodings. */
+        bool meta; /**< Also push meta levels. */
+        unsigned int dropped; /**< Blocks dropped since the last pushed
+                                one. */
+    };
+
+    /** Job ID and channel directory index. */
+    typedef std::pair<unsigned int, unsigned int> ChannelKey;
+
+    pid_t _pid; /**< Process that started the threads, or 0. */
+    int _epoll_fd; /**< Event poll descriptor. */
+    int _wake_fd; /**< Event file descriptor to wake the I/O thread. */
+    pthread_t _io_thread; /**< I/O thread. */
+    std::vector<pthread_t> _workers; /**< Worker threads. */
+    std::vector<pthread_t> _retired; /**< Terminated surplus workers to be
+                                       joined. */
+    unsigned int _pool_size; /**< Configured number of workers. */
+    unsigned int _waiting; /**< Number of workers waiting for a client. */
+    pthread_mutex_t _mutex; /**< Protects the connection set and queues
+                              and the connections' queueing state. */
+    pthread_cond_t _cond; /**< Signalled, when a connection was queued. */
+    bool _stop; /**< The threads shall terminate. */
+    std::set<Connection *> _connections; /**< All connections. */
+    std::deque<Connection *> _ready; /**< Connections with pending
+                                       requests in order of arrival. */
+    std::list<Connection *> _closing; /**< Lost connections to be deleted
+                                        by the I/O thread. */
+    int _live_fd; /**< Socket receiving the relayed blocks, or -1. */
+    std::vector<char> _live_buffer; /**< Receive buffer for relayed
+                                      blocks. */
+    pthread_mutex_t _live_mutex; /**< Protects _subscriptions. May be
+                                   locked with the mutex or a connection
+                                   mutex held. */
+    std::map<ChannelKey, std::list<Subscription> >
+        _subscriptions; /**< Live data subscriptions. */
+
+    static void *_io_static(void *);
+    void _io_run();
+    static void *_worker_static(void *);
+    void _worker_run();
+    bool _start_worker();
+    void _join_retired();
+    void _wake();
+    void _close(Connection *);
+    void _delete_closing();
+    void _receive_live();
+    void _dispatch_live(const char *, size_t);
+    void _unsubscribe_all(Connection *);
+};
+
+/*****************************************************************************/
+
+#endif
@@ -34,6 +34,8 @@
 #define SAVER_MAX_FILE_SIZE    10485760 // [byte]
 #define ALLOWED_TIME_VARIANCE  500      // in Prozent rel. Fehler
 #define DEFAULT_WAIT_BEFORE_RESTART 30  // seconds
+#define DEFAULT_WORKER_THREADS 4        // Threads processing requests
+#define DEFAULT_BLOCK_CACHE_SIZE 64     // MiB of decoded blocks
 #define BUFFER_LEVEL_WARNING   50       // in Prozent Fllstand
 #define QUOTA_PART_QUOTIENT    10       // Anzahl Chunks in Quota-Bereich
 #define NO_DATA_ABORT_TIME     600      // Zeit ohne Daten, nach der abgebrochen
@@ -89,6 +91,8 @@ extern unsigned int dlsd_job_id;
 extern const char *dls_version_str;
 
 extern unsigned int wait_before_restart;
+extern unsigned int worker_threads;
+extern unsigned int block_cache_size;
 
 /*****************************************************************************/
 
@@ -62,6 +62,8 @@ unsigned long num_files;
 #define WORKING_DIR_SIZE 100
 char working_dir[WORKING_DIR_SIZE + 1];
 unsigned int wait_before_restart = DEFAULT_WAIT_BEFORE_RESTART;
+unsigned int worker_threads = DEFAULT_WORKER_THREADS;
+unsigned int block_cache_size = DEFAULT_BLOCK_CACHE_SIZE;
 
 /*****************************************************************************/
 
@@ -234,7 +236,7 @@ void get_options(int argc, char **argv)
     char *env, *remainder;
 
     do {
-        c = getopt(argc, argv, "d:u:n:kw:bp:rh");
+        c = getopt(argc, argv, "d:u:n:kw:bp:t:c:rh");
 
         switch (c) {
             case 'd':
@@ -279,6 +281,28 @@ void get_options(int argc, char **argv)
                 service = optarg;
                 break;
 
+            case 't':
+                worker_threads = strtoul(optarg, &remainder, 10);
+
+                if (remainder == optarg || *remainder
+                        || worker_threads == 0) {
+                    cerr << "Invalid number of worker threads: "
+                        << optarg << endl;
+                    print_usage();
+                }
+
+                break;
+
+            case 'c':
+                block_cache_size = strtoul(optarg, &remainder, 10);
+
+                if (remainder == optarg || *remainder) {
+                    cerr << "Invalid block cache size: " << optarg << endl;
+                    print_usage();
+                }
+
+                break;
+
             case 'r':
                 read_only = true;
                 break;
@@ -338,6 +362,12 @@ void print_usage()
         << "  -b            Do not bind to network socket." << endl
         << "  -p <port>     Listen port or service name. Default is "
         << DEFAULT_PORT << "." << endl
+        << "  -t <number>   Number of threads processing client" << endl
+        << "                  requests. Default is "
+        << DEFAULT_WORKER_THREADS << "." << endl
+        << "  -c <MiB>      Memory for caching decoded data blocks." << endl
+        << "                  Zero disables the cache. Default is "
+        << DEFAULT_BLOCK_CACHE_SIZE << "." << endl
         << "  -r            Read-only mode (no data logging)." << endl
         << "  -h            Show this help." << endl;
     exit(0);
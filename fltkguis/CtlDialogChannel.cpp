@@ -570,6 +570,60 @@ bool CtlDialogChannel::_save_channels()
                 }
             } // Quant
 
+            else if (_choice_format->value() == LibDLS::FORMAT_DELTA)
+            {
+                channel_i = _channels->begin();
+                while (channel_i != _channels->end())
+                {
+                    if ((*channel_i)->type == LibDLS::TUNKNOWN)
+                    {
+                        msg_win->str() << "Channel \"" << (*channel_i)->name
+                                       << "\" has no type information!";
+                        msg_win->error();
+                        return false;
+                    }
+
+                    // Delta coding only for integer types
+                    if ((*channel_i)->type == LibDLS::TFLT
+                        || (*channel_i)->type == LibDLS::TDBL)
+                    {
+                        msg_win->str() << "Channel \"" << (*channel_i)->name
+                                       << "\" has no integer type!";
+                        msg_win->error();
+                        return false;
+                    }
+
+                    channel_i++;
+                }
+            } // Delta
+
+            else if (_choice_format->value() == LibDLS::FORMAT_XOR)
+            {
+                channel_i = _channels->begin();
+                while (channel_i != _channels->end())
+                {
+                    if ((*channel_i)->type == LibDLS::TUNKNOWN)
+                    {
+                        msg_win->str() << "Channel \"" << (*channel_i)->name
+                                       << "\" has no type information!";
+                        msg_win->error();
+                        return false;
+                    }
+
+                    // XOR coding only for floating-point types
+                    if ((*channel_i)->type != LibDLS::TFLT
+                        && (*channel_i)->type != LibDLS::TDBL)
+                    {
+                        msg_win->str() << "Channel \"" << (*channel_i)->name
+                                       << "\" has no floating-point type!";
+                        msg_win->error();
+                        return false;
+                    }
+
+                    channel_i++;
+                }
+            } // XOR
+
         } // Format selected
     }
     catch (...)
@@ -47,6 +47,7 @@ Base64::Base64()
 {
     _out_buf = 0;
     _out_size = 0;
+    _out_capacity = 0;
 }
 
 /*****************************************************************************/
@@ -69,6 +70,7 @@ Base64::~Base64()
 void Base64::free()
 {
     _out_size = 0;
+    _out_capacity = 0;
 
     if (_out_buf)
     {
@@ -79,6 +81,39 @@ void Base64::free()
 
 /*****************************************************************************/
 
+/**
+   Stellt einen Ergebnispuffer der angegebenen Gre bereit
+
+   Der Puffer wird nur vergrert und bis zum nchsten Aufruf
+   von free() fr alle weiteren Aufrufe wiederverwendet.
+
+   \param size Bentigte Gre in Bytes
+   \throw EBase64 Zu wenig Speicher
+*/
+
+void Base64::_reserve(unsigned int size)
+{
+    stringstream err;
+
+    if (size <= _out_capacity) return;
+
+    free();
+
+    try
+    {
+        _out_buf = new char[size];
+    }
+    catch (...)
+    {
+        err << "Could not allocate " << size << " bytes of memory!";
+        throw EBase64(err.str());
+    }
+
+    _out_capacity = size;
+}
+
+/*****************************************************************************/
+
 /**
    Kodiert beliebige Binrdaten in Base64
 
@@ -95,19 +130,11 @@ void Base64::encode(const char *src, unsigned int src_size)
     unsigned int i;
     stringstream err;
 
-    free();
+    _out_size = 0;
 
     if (!src_size) return;
 
-    try
-    {
-        _out_buf = new char[out_size];
-    }
-    catch (...)
-    {
-        err << "Could not allocate " << out_size << " bytes of memory!";
-        throw EBase64(err.str());
-    }
+    _reserve(out_size);
 
     while (2 < src_size)
     {
@@ -182,19 +209,11 @@ void Base64::decode(const char *src, unsigned int src_size)
     const char *pos;
     stringstream err;
 
-    free();
+    _out_size = 0;
 
     if (!src_size) return;
 
-    try
-    {
-        _out_buf = new char[out_size];
-    }
-    catch (...)
-    {
-        err << "Could not allocate " << out_size << " bytes of memory!";
-        throw EBase64(err.str());
-    }
+    _reserve(out_size);
 
     state = 0;
     tarindex = 0;
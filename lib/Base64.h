@@ -66,6 +66,9 @@ public:
 private:
     char *_out_buf;         /**< Zeiger auf den Ergebnispuffer */
     unsigned int _out_size; /**< Lnge des Ergebnispuffers */
+    unsigned int _out_capacity; /**< Gre des Ergebnispuffers */
+
+    void _reserve(unsigned int);
 };
 
 /*****************************************************************************/
@@ -0,0 +1,217 @@
+/******************************************************************************
+ *
+ *  This file is part of the Data Logging Service (DLS).
+ *
+ *  DLS is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  DLS is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with DLS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef LibDLSBitStreamH
+#define LibDLSBitStreamH
+
+/*****************************************************************************/
+
+#include <stdint.h>
+
+#include "LibDLS/Exception.h"
+
+/*****************************************************************************/
+
+namespace LibDLS {
+
+/*****************************************************************************/
+
+/**
+   Exception of a BitUnpacker object
+*/
+
+class EBitStream : public Exception
+{
+public:
+    EBitStream(const std::string &pmsg) : Exception(pmsg) {};
+};
+
+/*****************************************************************************/
+
+/** Writes a stream of bits, most significant bit first.
+ *
+ * Bits are collected in an accumulator and written to the output buffer
+ * byte by byte. The last byte is padded with zero bits by finish().
+ */
+class BitWriter
+{
+public:
+    BitWriter(char *output):
+        _output(output), _size(0), _acc(0), _bits(0) {}
+
+    /** Appends the lowest \a count bits of \a value (\a count <= 8). */
+    void write(unsigned int value, unsigned int count) {
+        _acc = (_acc << count) | value;
+        _bits += count;
+        if (_bits >= 8) {
+            _bits -= 8;
+            _output[_size++] = (char) (_acc >> _bits);
+        }
+    }
+
+    /** Flushes the remaining bits.
+     *
+     * \return Number of bytes written.
+     */
+    unsigned int finish() {
+        if (_bits) {
+            _output[_size++] = (char) (_acc << (8 - _bits));
+            _bits = 0;
+        }
+        return _size;
+    }
+
+private:
+    char * const _output; /**< Output buffer. */
+    unsigned int _size; /**< Number of bytes written. */
+    unsigned int _acc; /**< Bit accumulator. */
+    unsigned int _bits; /**< Number of pending bits in the accumulator. */
+};
+
+/*****************************************************************************/
+
+/** Reads a stream of bits written by BitWriter.
+ */
+class BitReader
+{
+public:
+    BitReader(const char *input):
+        _input(input), _size(0), _acc(0), _bits(0) {}
+
+    /** Reads the next \a count bits (\a count <= 8). */
+    unsigned int read(unsigned int count) {
+        if (_bits < count) {
+            _acc = (_acc << 8) | (unsigned char) _input[_size++];
+            _bits += 8;
+        }
+        _bits -= count;
+        return (_acc >> _bits) & ((1U << count) - 1);
+    }
+
+    /** \return Number of bytes consumed, including a partial last byte. */
+    unsigned int size() const { return _size; }
+
+private:
+    const char * const _input; /**< Input buffer. */
+    unsigned int _size; /**< Number of bytes read. */
+    unsigned int _acc; /**< Bit accumulator. */
+    unsigned int _bits; /**< Number of unread bits in the accumulator. */
+};
+
+/*****************************************************************************/
+
+/** Packs values with up to 64 bits, least significant bit first.
+ */
+class BitPacker
+{
+public:
+    BitPacker(char *output): _output(output), _size(0), _acc(0),
+        _bits(0) {}
+
+    void write(uint64_t value, unsigned int width) {
+        if (width > 32) {
+            _write(value & 0xffffffffU, 32);
+            _write(value >> 32, width - 32);
+        }
+        else if (width) {
+            _write(value, width);
+        }
+    }
+
+    /** Pads the last byte and returns the number of bytes written. */
+    unsigned int finish() {
+        if (_bits) {
+            _output[_size++] = (char) _acc;
+            _acc = 0;
+            _bits = 0;
+        }
+        return _size;
+    }
+
+private:
+    char * const _output; /**< Output buffer. */
+    unsigned int _size; /**< Number of bytes written. */
+    uint64_t _acc; /**< Bit accumulator. */
+    unsigned int _bits; /**< Number of pending bits in the accumulator. */
+
+    void _write(uint64_t value, unsigned int width) {
+        _acc |= value << _bits;
+        _bits += width;
+        while (_bits >= 8) {
+            _output[_size++] = (char) _acc;
+            _acc >>= 8;
+            _bits -= 8;
+        }
+    }
+};
+
+/*****************************************************************************/
+
+/** Reads values written by BitPacker.
+ */
+class BitUnpacker
+{
+public:
+    BitUnpacker(const char *input, unsigned int size):
+        _input(input), _size(size), _pos(0), _acc(0), _bits(0) {}
+
+    /** \throw EBitStream Input exhausted. */
+    uint64_t read(unsigned int width) {
+        if (width > 32) {
+            uint64_t low = _read(32);
+            return low | (_read(width - 32) << 32);
+        }
+        return width ? _read(width) : 0;
+    }
+
+    /** Discards the bits of a partially read byte. */
+    void align() {
+        _acc = 0;
+        _bits = 0;
+    }
+
+private:
+    const char * const _input; /**< Input buffer. */
+    const unsigned int _size; /**< Size of the input buffer. */
+    unsigned int _pos; /**< Number of bytes read. */
+    uint64_t _acc; /**< Bit accumulator. */
+    unsigned int _bits; /**< Number of unread bits in the accumulator. */
+
+    uint64_t _read(unsigned int width) {
+        while (_bits < width) {
+            if (_pos >= _size) {
+                throw EBitStream("Unexpected end of data!");
+            }
+            _acc |= (uint64_t) (unsigned char) _input[_pos++] << _bits;
+            _bits += 8;
+        }
+        uint64_t value = _acc & ((((uint64_t) 1) << width) - 1);
+        _acc >>= width;
+        _bits -= width;
+        return value;
+    }
+};
+
+/*****************************************************************************/
+
+} // namespace
+
+/*****************************************************************************/
+
+#endif
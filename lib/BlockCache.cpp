@@ -0,0 +1,224 @@
+/******************************************************************************
+ *
+ *  This file is part of the Data Logging Service (DLS).
+ *
+ *  DLS is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  DLS is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with DLS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+#include "BlockCache.h"
+using namespace LibDLS;
+
+/*****************************************************************************/
+
+/** Estimated management overhead of an entry in bytes. */
+#define ENTRY_OVERHEAD 128
+
+/*****************************************************************************/
+
+BlockCache::BlockCache():
+    _limit(0),
+    _size(0),
+    _hits(0),
+    _misses(0)
+{
+    pthread_mutex_init(&_mutex, NULL);
+}
+
+/*****************************************************************************/
+
+BlockCache::~BlockCache()
+{
+    pthread_mutex_destroy(&_mutex);
+}
+
+/*****************************************************************************/
+
+/** Cache shared by all chunks of the process.
+ */
+BlockCache &BlockCache::global()
+{
+    static BlockCache cache;
+    return cache;
+}
+
+/*****************************************************************************/
+
+/** Sets the maximum memory usage.
+ *
+ * Entries exceeding the new limit are removed. A limit of zero disables the
+ * cache.
+ */
+void BlockCache::set_limit(
+        size_t limit /**< Maximum memory usage in bytes. */
+        )
+{
+    pthread_mutex_lock(&_mutex);
+    _limit = limit;
+    _evict();
+    pthread_mutex_unlock(&_mutex);
+}
+
+/*****************************************************************************/
+
+BlockCacheStats BlockCache::stats()
+{
+    BlockCacheStats stats;
+
+    pthread_mutex_lock(&_mutex);
+    stats.hits = _hits;
+    stats.misses = _misses;
+    stats.size = _size;
+    stats.limit = _limit;
+    stats.blocks = _index.size();
+    pthread_mutex_unlock(&_mutex);
+
+    return stats;
+}
+
+/*****************************************************************************/
+
+/** Looks up the decoded values of a block.
+ *
+ * \return true, if the block was found.
+ */
+bool BlockCache::fetch(
+        const std::string &path, /**< Path of the data file. */
+        uint32_t position, /**< Position of the block in the file. */
+        uint64_t start_time, /**< Time of the first value. */
+        std::vector<double> &values /**< Decoded values. */
+        )
+{
+    Key key;
+    key.path = path;
+    key.position = position;
+
+    pthread_mutex_lock(&_mutex);
+
+    std::map<Key, EntryList::iterator>::iterator i = _index.find(key);
+    if (i == _index.end() || i->second->start_time != start_time) {
+        _misses++;
+        pthread_mutex_unlock(&_mutex);
+        return false;
+    }
+
+    // move to the front
+    _entries.splice(_entries.begin(), _entries, i->second);
+    values = i->second->values;
+    _hits++;
+
+    pthread_mutex_unlock(&_mutex);
+    return true;
+}
+
+/*****************************************************************************/
+
+bool BlockCache::Key::operator<(const Key &other) const
+{
+    if (position != other.position) {
+        return position < other.position;
+    }
+
+    return path < other.path;
+}
+
+/*****************************************************************************/
+
+/** Inserts or replaces a block.
+ *
+ * The values are moved into the cache.
+ */
+void BlockCache::_insert(
+        const std::string &path, /**< Path of the data file. */
+        uint32_t position, /**< Position of the block in the file. */
+        uint64_t start_time, /**< Time of the first value. */
+        std::vector<double> &values /**< Decoded values. */
+        )
+{
+    Key key;
+    key.path = path;
+    key.position = position;
+
+    pthread_mutex_lock(&_mutex);
+
+    std::map<Key, EntryList::iterator>::iterator i = _index.find(key);
+    if (i != _index.end()) {
+        _size -= _entry_size(*i->second);
+        _entries.erase(i->second);
+        _index.erase(i);
+    }
+
+    _entries.push_front(Entry());
+    Entry &entry = _entries.front();
+    entry.key = key;
+    entry.start_time = start_time;
+    entry.values.swap(values);
+
+    _index[key] = _entries.begin();
+    _size += _entry_size(entry);
+
+    _evict();
+
+    pthread_mutex_unlock(&_mutex);
+}
+
+/*****************************************************************************/
+
+/** Removes the least recently used entries exceeding the limit.
+ *
+ * Has to be called with the mutex locked.
+ */
+void BlockCache::_evict()
+{
+    while (_size > _limit && !_entries.empty()) {
+        Entry &entry = _entries.back();
+        _size -= _entry_size(entry);
+        _index.erase(entry.key);
+        _entries.pop_back();
+    }
+}
+
+/*****************************************************************************/
+
+size_t BlockCache::_entry_size(const Entry &entry)
+{
+    return entry.values.size() * sizeof(double) + entry.key.path.size()
+        + ENTRY_OVERHEAD;
+}
+
+/*****************************************************************************/
+
+/** Sets the memory limit of the decoded block cache.
+ *
+ * Repeated requests for the same blocks are then served from memory. The
+ * cache is disabled by default.
+ */
+void LibDLS::set_block_cache_size(
+        size_t size /**< Maximum memory usage in bytes, or zero. */
+        )
+{
+    BlockCache::global().set_limit(size);
+}
+
+/*****************************************************************************/
+
+/** Returns the statistics of the decoded block cache.
+ */
+BlockCacheStats LibDLS::block_cache_stats()
+{
+    return BlockCache::global().stats();
+}
+
+/*****************************************************************************/
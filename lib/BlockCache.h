@@ -0,0 +1,131 @@
+/******************************************************************************
+ *
+ *  This file is part of the Data Logging Service (DLS).
+ *
+ *  DLS is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  DLS is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with DLS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+#ifndef LibDLSBlockCacheH
+#define LibDLSBlockCacheH
+
+/*****************************************************************************/
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "LibDLS/globals.h"
+
+/*****************************************************************************/
+
+namespace LibDLS {
+
+/*****************************************************************************/
+
+/** Least-recently-used cache for decoded data blocks.
+ *
+ * Used by Chunk::fetch_data() and shared by all threads of the process, so
+ * that repeated requests for the same time range are served without
+ * reading, parsing and decompressing the blocks again.
+ *
+ * A block is identified by the path of its data file (which determines the
+ * chunk, the meta level and the meta type) and its position in that file.
+ * The start time of the block is stored as well and compared on lookup, so
+ * that a recreated data file can not deliver outdated values.
+ *
+ * The cache is disabled with a size limit of zero, which is the default
+ * (see set_block_cache_size()).
+ */
+class BlockCache
+{
+public:
+    BlockCache();
+    ~BlockCache();
+
+    static BlockCache &global();
+
+    void set_limit(size_t);
+    bool enabled() const { return _limit > 0; }
+    BlockCacheStats stats();
+
+    bool fetch(const std::string &, uint32_t, uint64_t,
+            std::vector<double> &);
+    template <class T>
+        void store(const std::string &, uint32_t, uint64_t,
+                const T *, unsigned int);
+
+private:
+    struct Key {
+        std::string path; /**< Path of the data file. */
+        uint32_t position; /**< Position of the block in the file. */
+
+        bool operator<(const Key &) const;
+    };
+
+    struct Entry {
+        Key key; /**< Cache key. */
+        uint64_t start_time; /**< Time of the first value. */
+        std::vector<double> values; /**< Decoded values. */
+    };
+
+    typedef std::list<Entry> EntryList;
+
+    pthread_mutex_t _mutex; /**< Protects the members below. */
+    size_t _limit; /**< Maximum memory usage in bytes. */
+    size_t _size; /**< Current memory usage in bytes. */
+    EntryList _entries; /**< Entries, most recently used first. */
+    std::map<Key, EntryList::iterator> _index; /**< Entries by key. */
+    uint64_t _hits; /**< Number of successful lookups. */
+    uint64_t _misses; /**< Number of failed lookups. */
+
+    void _insert(const std::string &, uint32_t, uint64_t,
+            std::vector<double> &);
+    void _evict();
+    static size_t _entry_size(const Entry &);
+};
+
+/*****************************************************************************/
+
+/** Stores the decoded values of a block.
+ */
+template <class T>
+void BlockCache::store(
+        const std::string &path, /**< Path of the data file. */
+        uint32_t position, /**< Position of the block in the file. */
+        uint64_t start_time, /**< Time of the first value. */
+        const T *data, /**< Decoded values. */
+        unsigned int length /**< Number of values. */
+        )
+{
+    if (!enabled() || !length) {
+        return;
+    }
+
+    std::vector<double> values(data, data + length);
+    _insert(path, position, start_time, values);
+}
+
+/*****************************************************************************/
+
+} // namespace
+
+/*****************************************************************************/
+
+#endif
@@ -0,0 +1,226 @@
+/******************************************************************************
+ *
+ *  This file is part of the Data Logging Service (DLS).
+ *
+ *  DLS is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  DLS is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with DLS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include <sstream>
+using namespace std;
+
+#include "BlockDecoder.h"
+using namespace LibDLS;
+
+/*****************************************************************************/
+
+/** Constructor.
+ *
+ * Starts the worker threads. If no thread can be started, the blocks are
+ * decoded in the calling thread.
+ */
+BlockDecoder::BlockDecoder(
+        unsigned int threads, /**< Number of worker threads. */
+        ChannelType type, /**< Channel type of the blocks. */
+        DataCallback cb, /**< Target callback. */
+        void *cb_data /**< Target callback parameter. */
+        ):
+    _type(type),
+    _cb(cb),
+    _cb_data(cb_data),
+    _max_pending(4 * (threads ? threads : 1)),
+    _stop(false)
+{
+    pthread_mutex_init(&_mutex, NULL);
+    pthread_cond_init(&_work_cond, NULL);
+    pthread_cond_init(&_done_cond, NULL);
+
+    for (unsigned int i = 0; i < threads; i++) {
+        pthread_t thread;
+        int ret = pthread_create(&thread, NULL, _run_static, this);
+        if (ret) {
+            stringstream err;
+            err << "WARNING: Failed to start decoder thread: " << ret;
+            log(err.str());
+            break;
+        }
+        _threads.push_back(thread);
+    }
+}
+
+/*****************************************************************************/
+
+/** Destructor.
+ *
+ * Passes the remaining blocks to the target callback and stops the
+ * workers.
+ */
+BlockDecoder::~BlockDecoder()
+{
+    flush();
+
+    pthread_mutex_lock(&_mutex);
+    _stop = true;
+    pthread_cond_broadcast(&_work_cond);
+    pthread_mutex_unlock(&_mutex);
+
+    for (vector<pthread_t>::iterator thread_i = _threads.begin();
+            thread_i != _threads.end(); thread_i++) {
+        pthread_join(*thread_i, NULL);
+    }
+
+    pthread_cond_destroy(&_done_cond);
+    pthread_cond_destroy(&_work_cond);
+    pthread_mutex_destroy(&_mutex);
+}
+
+/*****************************************************************************/
+
+/** Data callback feeding the decoder.
+ *
+ * \return Always 1, because the data are adopted.
+ */
+int BlockDecoder::data_callback(Data *data, void *cb_data)
+{
+    BlockDecoder *decoder = (BlockDecoder *) cb_data;
+    decoder->_add(data);
+    decoder->_deliver(decoder->_max_pending);
+    return 1;
+}
+
+/*****************************************************************************/
+
+/** Waits for all blocks and passes them to the target callback.
+ */
+void BlockDecoder::flush()
+{
+    _deliver(0);
+}
+
+/*****************************************************************************/
+
+void BlockDecoder::_add(Data *data)
+{
+    Item *item = new Item;
+    item->data = data;
+    item->done = !data->has_block();
+
+    if (!item->done && _threads.empty()) {
+        try {
+            data->decode_block(_type);
+        }
+        catch (DataException &e) {
+            item->error = e.msg;
+        }
+        item->done = true;
+    }
+
+    pthread_mutex_lock(&_mutex);
+    _items.push_back(item);
+    if (!item->done) {
+        _todo.push_back(item);
+        pthread_cond_signal(&_work_cond);
+    }
+    pthread_mutex_unlock(&_mutex);
+}
+
+/*****************************************************************************/
+
+/** Passes decoded blocks to the target callback in their original order.
+ *
+ * Waits for the oldest block as long as more than \a max_pending blocks
+ * are queued.
+ */
+void BlockDecoder::_deliver(unsigned int max_pending)
+{
+    pthread_mutex_lock(&_mutex);
+
+    while (!_items.empty()) {
+        Item *item = _items.front();
+
+        if (!item->done) {
+            if (_items.size() <= max_pending) {
+                break;
+            }
+            pthread_cond_wait(&_done_cond, &_mutex);
+            continue;
+        }
+
+        _items.pop_front();
+        pthread_mutex_unlock(&_mutex);
+
+        if (!item->error.empty()) {
+            stringstream err;
+            err << "ERROR: " << item->error;
+            log(err.str());
+        }
+
+        if (!_cb(item->data, _cb_data)) {
+            delete item->data;
+        }
+        delete item;
+
+        pthread_mutex_lock(&_mutex);
+    }
+
+    pthread_mutex_unlock(&_mutex);
+}
+
+/*****************************************************************************/
+
+void *BlockDecoder::_run_static(void *arg)
+{
+    ((BlockDecoder *) arg)->_run();
+    return NULL;
+}
+
+/*****************************************************************************/
+
+/** Worker thread function.
+ */
+void BlockDecoder::_run()
+{
+    pthread_mutex_lock(&_mutex);
+
+    while (1) {
+        while (_todo.empty() && !_stop) {
+            pthread_cond_wait(&_work_cond, &_mutex);
+        }
+
+        if (_todo.empty()) {
+            break; // stopped
+        }
+
+        Item *item = _todo.front();
+        _todo.pop_front();
+        pthread_mutex_unlock(&_mutex);
+
+        string error;
+        try {
+            item->data->decode_block(_type);
+        }
+        catch (DataException &e) {
+            error = e.msg;
+        }
+
+        pthread_mutex_lock(&_mutex);
+        item->error = error;
+        item->done = true;
+        pthread_cond_broadcast(&_done_cond);
+    }
+
+    pthread_mutex_unlock(&_mutex);
+}
+
+/*****************************************************************************/
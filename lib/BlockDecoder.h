@@ -0,0 +1,90 @@
+/******************************************************************************
+ *
+ *  This file is part of the Data Logging Service (DLS).
+ *
+ *  DLS is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  DLS is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with DLS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef LibDLSBlockDecoderH
+#define LibDLSBlockDecoderH
+
+/*****************************************************************************/
+
+#include <pthread.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "LibDLS/Chunk.h"
+
+/*****************************************************************************/
+
+namespace LibDLS {
+
+/*****************************************************************************/
+
+/** Decodes compressed data blocks on a pool of worker threads.
+ *
+ * The decoder is used as data callback for Chunk::fetch_data() with
+ * undecoded blocks. The blocks are decoded in parallel, but passed to the
+ * target callback in their original order and always from the thread that
+ * feeds the decoder. Already decoded data are passed through in order.
+ */
+class BlockDecoder
+{
+public:
+    BlockDecoder(unsigned int, ChannelType, DataCallback, void *);
+    ~BlockDecoder();
+
+    static int data_callback(Data *, void *);
+    void flush();
+
+private:
+    struct Item {
+        Data *data; /**< Data block. */
+        bool done; /**< Decoding finished. */
+        std::string error; /**< Decoding error message. */
+    };
+
+    const ChannelType _type; /**< Channel type of the blocks. */
+    const DataCallback _cb; /**< Target callback. */
+    void * const _cb_data; /**< Target callback parameter. */
+    const unsigned int _max_pending; /**< Maximum number of blocks in the
+                                       queue. */
+
+    std::vector<pthread_t> _threads; /**< Worker threads. */
+    pthread_mutex_t _mutex; /**< Protects the queues. */
+    pthread_cond_t _work_cond; /**< Signals new blocks to the workers. */
+    pthread_cond_t _done_cond; /**< Signals decoded blocks. */
+    std::deque<Item *> _items; /**< All blocks in callback order. */
+    std::deque<Item *> _todo; /**< Blocks still to be decoded. */
+    bool _stop; /**< Workers shall terminate. */
+
+    void _add(Data *);
+    void _deliver(unsigned int);
+    static void *_run_static(void *);
+    void _run();
+
+    BlockDecoder(); // private
+};
+
+/*****************************************************************************/
+
+} // namespace
+
+/*****************************************************************************/
+
+#endif
@@ -26,6 +26,7 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <vector>
 using namespace std;
 
 /*****************************************************************************/
@@ -41,6 +42,7 @@ using namespace std;
 #include "IndexT.h"
 #include "XmlParser.h"
 #include "IndexT.h"
+#include "BlockDecoder.h"
 using namespace LibDLS;
 
 #ifdef DEBUG_TIMING
@@ -49,6 +51,231 @@ using namespace LibDLS;
 
 /*****************************************************************************/
 
+/** Minimum/maximum envelope of a time range, see Channel::fetch_envelope().
+ */
+class Envelope
+{
+    public:
+        Envelope(Time start, Time end, unsigned int buckets):
+            _start(start),
+            _width(((end - start).to_int64() + buckets - 1) / buckets),
+            _min(buckets),
+            _max(buckets),
+            _count(buckets, 0) {}
+
+        static int data_callback(Data *data, void *cb_data) {
+            ((Envelope *) cb_data)->add(*data);
+            return 0; // not adopted
+        }
+
+        void add(const Data &);
+        bool add(const BlockStats &);
+        void emit(DataCallback, void *) const;
+
+    private:
+        const Time _start; /**< Start of the first bucket. */
+        const Time _width; /**< Bucket width. */
+        std::vector<double> _min; /**< Minimum per bucket. */
+        std::vector<double> _max; /**< Maximum per bucket. */
+        std::vector<unsigned int> _count; /**< Values per bucket. */
+
+        void _emit_run(unsigned int, unsigned int, DataCallback,
+                void *) const;
+};
+
+/*****************************************************************************/
+
+/** Adds the values of a data block to their buckets.
+ */
+void Envelope::add(const Data &data)
+{
+    for (unsigned int i = 0; i < data.size(); i++) {
+        Time t = data.time(i);
+        if (t < _start) {
+            continue;
+        }
+
+        uint64_t bucket = (t - _start).to_uint64() / _width.to_uint64();
+        if (bucket >= _count.size()) {
+            break;
+        }
+
+        double value = data.value(i);
+        if (!_count[bucket] || value < _min[bucket]) {
+            _min[bucket] = value;
+        }
+        if (!_count[bucket] || value > _max[bucket]) {
+            _max[bucket] = value;
+        }
+        _count[bucket]++;
+    }
+}
+
+/*****************************************************************************/
+
+/** Adds the statistics of a block, if it lies within a single bucket.
+ *
+ * \return false, if the block has to be decoded.
+ */
+bool Envelope::add(const BlockStats &block)
+{
+    if (!block.count || block.start < _start) {
+        return false;
+    }
+
+    uint64_t bucket = (block.start - _start).to_uint64() / _width.to_uint64();
+    if (bucket >= _count.size()
+            || (block.end - _start).to_uint64() / _width.to_uint64()
+            != bucket) {
+        return false;
+    }
+
+    if (!_count[bucket] || block.min < _min[bucket]) {
+        _min[bucket] = block.min;
+    }
+    if (!_count[bucket] || block.max > _max[bucket]) {
+        _max[bucket] = block.max;
+    }
+    _count[bucket] += block.count;
+    return true;
+}
+
+/*****************************************************************************/
+
+/** Passes the envelope to a data callback.
+ *
+ * Each run of consecutive non-empty buckets is passed as a pair of MetaMin
+ * and MetaMax data blocks with one value per bucket.
+ */
+void Envelope::emit(DataCallback cb, void *cb_data) const
+{
+    unsigned int run_start = 0;
+
+    for (unsigned int i = 0; i <= _count.size(); i++) {
+        if (i < _count.size() && _count[i]) {
+            continue;
+        }
+
+        if (i > run_start) {
+            _emit_run(run_start, i - run_start, cb, cb_data);
+        }
+        run_start = i + 1;
+    }
+}
+
+/*****************************************************************************/
+
+void Envelope::_emit_run(
+        unsigned int first, /**< First bucket. */
+        unsigned int count, /**< Number of buckets. */
+        DataCallback cb, /**< Data callback. */
+        void *cb_data /**< Arbitrary callback parameter. */
+        ) const
+{
+    Time start = _start + _width * first;
+    unsigned int counter = 0;
+
+    Data *min = new Data();
+    min->import(start, _width, MetaMin, 0, 1, counter, &_min[first], count);
+    if (!cb(min, cb_data)) {
+        delete min;
+    }
+
+    Data *max = new Data();
+    max->import(start, _width, MetaMax, 0, 1, counter, &_max[first], count);
+    if (!cb(max, cb_data)) {
+        delete max;
+    }
+}
+
+/*****************************************************************************/
+
+/** Calculates an envelope from the block statistics of local chunks.
+ *
+ * Blocks without statistics or spanning several buckets are decoded;
+ * consecutive ones are fetched together.
+ */
+static void fetch_envelope_local(
+        Channel::ChunkMap &chunks, /**< Chunks of the channel. */
+        Time start, /**< start of requested time range */
+        Time end, /**< end of requested time range */
+        unsigned int buckets, /**< Number of buckets. */
+        Envelope &envelope /**< Envelope to fill. */
+        )
+{
+    Channel::ChunkMap::iterator chunk_i;
+    vector<BlockStats> stats;
+    vector<BlockStats>::const_iterator block_i;
+    Time decode_start, decode_end;
+    MetaType decode_type = MetaGen;
+    unsigned int level;
+    bool decode_pending;
+
+    for (chunk_i = chunks.begin(); chunk_i != chunks.end(); chunk_i++) {
+        Chunk &chunk = chunk_i->second;
+
+        // several blocks per bucket, so that only few are decoded
+        stats.clear();
+        level = chunk.fetch_block_stats(start, end, 4 * buckets, stats);
+
+        decode_pending = false;
+        for (block_i = stats.begin(); block_i != stats.end(); block_i++) {
+            if (envelope.add(*block_i)) {
+                continue;
+            }
+
+            if (decode_pending && block_i->meta_type != decode_type) {
+                chunk.fetch_level_data(decode_start, decode_end, level,
+                        decode_type, Envelope::data_callback, &envelope);
+                decode_pending = false;
+            }
+
+            if (!decode_pending) {
+                decode_start = block_i->start;
+                decode_type = block_i->meta_type;
+                decode_pending = true;
+            }
+            // the range end must lie behind the last value
+            decode_end = block_i->end + Time((int64_t) 1);
+        }
+
+        if (decode_pending) {
+            chunk.fetch_level_data(decode_start, decode_end, level,
+                    decode_type, Envelope::data_callback, &envelope);
+        }
+    }
+}
+
+/*****************************************************************************/
+
+/** Minimum and maximum of an envelope with a single bucket, see
+ * Channel::calc_min_max().
+ */
+struct MinMax
+{
+    MinMax(): min(0.0), max(0.0), found(false) {}
+
+    static int data_callback(Data *data, void *cb_data) {
+        MinMax *min_max = (MinMax *) cb_data;
+        if (data->size()) {
+            if (data->meta_type() == MetaMin) {
+                min_max->min = data->value(0);
+                min_max->found = true;
+            }
+            else if (data->meta_type() == MetaMax) {
+                min_max->max = data->value(0);
+            }
+        }
+        return 0; // not adopted
+    }
+
+    double min; /**< Minimum. */
+    double max; /**< Maximum. */
+    bool found; /**< The time range contains values. */
+};
+
+/*****************************************************************************/
+
 /**
    Constructor.
 */
@@ -163,6 +390,56 @@ std::pair<std::set<Chunk *>, std::set<int64_t> > Channel::fetch_chunks()
 
 /*****************************************************************************/
 
+/** Takes over the chunk list of another object of the same channel.
+ *
+ * Allows to share the results of fetch_chunks() between multiple
+ * directory objects. The chunks are copied, so that both channels can be
+ * used independently afterwards.
+ *
+ * \return Updated and removed chunks, like fetch_chunks().
+ */
+std::pair<std::set<Chunk *>, std::set<int64_t> > Channel::update_chunks(
+        const Channel &other /**< Channel to copy the chunks from. */
+        )
+{
+    std::pair<std::set<Chunk *>, std::set<int64_t> > ret;
+    ChunkMap::const_iterator other_i;
+    ChunkMap::iterator chunk_i;
+
+    for (other_i = other._chunks.begin(); other_i != other._chunks.end();
+            other_i++) {
+        chunk_i = _chunks.find(other_i->first);
+        if (chunk_i == _chunks.end()) {
+            chunk_i = _chunks.insert(*other_i).first;
+        }
+        else if (!(chunk_i->second == other_i->second)
+                || chunk_i->second.incomplete()
+                != other_i->second.incomplete()) {
+            chunk_i->second = other_i->second;
+        }
+        else {
+            continue;
+        }
+        ret.first.insert(&chunk_i->second);
+    }
+
+    chunk_i = _chunks.begin();
+    while (chunk_i != _chunks.end()) {
+        ChunkMap::iterator cur = chunk_i++;
+        if (other._chunks.find(cur->first) == other._chunks.end()) {
+            ret.second.insert(cur->first);
+            _chunks.erase(cur);
+        }
+    }
+
+    _range_start = other._range_start;
+    _range_end = other._range_end;
+
+    return ret;
+}
+
+/*****************************************************************************/
+
 /**
    Loads data values of the specified time range and resolution.
 
@@ -180,11 +457,14 @@ void Channel::fetch_data(
         unsigned int min_values, /**< minimal number */
         DataCallback cb, /**< callback */
         void *cb_data, /**< arbitrary callback parameter */
-        unsigned int decimation /**< Decimation. */
+        unsigned int decimation, /**< Decimation. */
+        bool blocks /**< Pass compressed blocks undecoded, where possible
+                      (local directories only, see Chunk::fetch_data()). */
         )
 {
     if (_job->dir()->access() == Directory::Local) {
-        _fetch_data_local(start, end, min_values, cb, cb_data, decimation);
+        _fetch_data_local(start, end, min_values, cb, cb_data, decimation,
+                blocks);
     }
     else {
         _fetch_data_network(start, end, min_values, cb, cb_data, decimation);
@@ -193,6 +473,221 @@ void Channel::fetch_data(
 
 /*****************************************************************************/
 
+/** Loads the minimum/maximum envelope of a time range.
+ *
+ * The time range is divided into \a buckets buckets of equal width (e. g.
+ * one per pixel), and the minimum and maximum of the values in each bucket
+ * are calculated from the best suitable meta level. The envelope is passed
+ * to the callback as MetaMin and MetaMax data blocks with one value per
+ * bucket, one pair for each run of non-empty buckets.
+ *
+ * Servers with protocol version 6 or later calculate the envelope
+ * themselves, so that the amount of transferred data does not depend on
+ * the time range.
+ */
+void Channel::fetch_envelope(
+        Time start, /**< start of requested time range */
+        Time end, /**< end of requested time range */
+        unsigned int buckets, /**< Number of buckets. */
+        DataCallback cb, /**< callback */
+        void *cb_data /**< arbitrary callback parameter */
+        )
+{
+    if (!buckets || start >= end) {
+        return;
+    }
+
+    if (_job->dir()->access() == Directory::Network
+            && _job->dir()->_protocol_version >= 6) {
+        _fetch_data_network(start, end, buckets, cb, cb_data, 1, buckets);
+        return;
+    }
+
+    Envelope envelope(start, end, buckets);
+
+    if (_job->dir()->access() == Directory::Local) {
+        try {
+            fetch_envelope_local(_chunks, start, end, buckets, envelope);
+        } catch (ChunkException &e) {
+            stringstream err;
+            err << "Failed to fetch data from chunk: " << e.msg;
+            throw ChannelException(err.str());
+        }
+    }
+    else {
+        fetch_data(start, end, buckets, Envelope::data_callback, &envelope);
+    }
+
+    envelope.emit(cb, cb_data);
+}
+
+/*****************************************************************************/
+
+/** Calculates minimum and maximum of a time range.
+ *
+ * Local directories and servers with protocol version 6 or later answer
+ * this from the block statistics, so only the blocks at the borders of the
+ * time range are decompressed.
+ *
+ * \return Non-zero, if the time range contains values.
+ */
+int Channel::calc_min_max(
+        Time start, /**< start of requested time range */
+        Time end, /**< end of requested time range */
+        double *min, /**< Minimum. */
+        double *max /**< Maximum. */
+        )
+{
+    MinMax min_max;
+
+    fetch_envelope(start, end, 1, MinMax::data_callback, &min_max);
+
+    if (!min_max.found) {
+        return 0;
+    }
+
+    *min = min_max.min;
+    *max = min_max.max;
+    return 1;
+}
+
+/*****************************************************************************/
+
+/** Returns the largest number of values per block in a time range.
+ *
+ * The block size is only known for local directories, otherwise zero is
+ * returned.
+ */
+unsigned int Channel::max_block_size(
+        Time start, /**< start of requested time range */
+        Time end /**< end of requested time range */
+        )
+{
+    unsigned int size = 0;
+
+    if (_job->dir()->access() != Directory::Local) {
+        return 0;
+    }
+
+    try {
+        for (ChunkMap::iterator chunk_i = _chunks.begin();
+                chunk_i != _chunks.end(); chunk_i++) {
+            Chunk &chunk = chunk_i->second;
+            if (chunk.start().is_null() || chunk.start() > end
+                    || (!chunk.end().is_null() && chunk.end() < start)) {
+                continue;
+            }
+            if (chunk.block_size() > size) {
+                size = chunk.block_size();
+            }
+        }
+    } catch (ChunkException &e) {
+        stringstream err;
+        err << "Failed to import chunk: " << e.msg;
+        throw ChannelException(err.str());
+    }
+
+    return size;
+}
+
+/*****************************************************************************/
+
+/** Subscribes to the live data of the channel.
+ *
+ * Servers with protocol version 7 or later push the blocks of subscribed
+ * channels, as soon as they are saved. The blocks are passed to the
+ * callback, when they are received by the directory, i. e. while waiting
+ * for the response to another request, or in Directory::process_live().
+ * The callback must not send requests itself.
+ *
+ * An existing subscription of the channel is replaced. The subscription
+ * ends with unsubscribe() or with the connection.
+ *
+ * \throw ChannelException Live data are not available.
+ */
+void Channel::subscribe(
+        DataCallback cb, /**< callback */
+        void *cb_data, /**< arbitrary callback parameter */
+        bool meta /**< Also pass the blocks of the meta levels. */
+        )
+{
+    Directory *dir = _job->dir();
+    Directory::LiveKey key(_job->id(), _dir_index);
+
+    if (dir->access() != Directory::Network) {
+        throw ChannelException("Live data are only available from"
+                " network directories!");
+    }
+
+    try {
+        dir->_connect();
+    }
+    catch (DirectoryException &e) {
+        stringstream err;
+        err << "Failed to subscribe: " << e.msg;
+        throw ChannelException(err.str());
+    }
+
+    if (!dir->serverSupportsLiveData()) {
+        throw ChannelException("Server does not support live data."
+                " Please update to protocol version 7 or later.");
+    }
+
+    // data may be pushed before the response arrives
+    Directory::LiveSubscriber sub;
+    sub.cb = cb;
+    sub.cb_data = cb_data;
+    sub.dropped = 0;
+    dir->_live_subscribers[key] = sub;
+
+    try {
+        _send_subscription(true, meta);
+    }
+    catch (ChannelException &e) {
+        dir->_live_subscribers.erase(key);
+        throw;
+    }
+}
+
+/*****************************************************************************/
+
+/** Cancels the live data subscription of the channel.
+ *
+ * \throw ChannelException The server refused to cancel it.
+ */
+void Channel::unsubscribe()
+{
+    Directory *dir = _job->dir();
+
+    if (!dir->_live_subscribers.erase(
+                Directory::LiveKey(_job->id(), _dir_index))
+            || !dir->connected()) {
+        return;
+    }
+
+    _send_subscription(false, false);
+}
+
+/*****************************************************************************/
+
+/** Returns the number of live blocks dropped by the server.
+ *
+ * The server drops blocks, if the client does not receive them fast enough.
+ * The number is counted since subscribe() and is already updated, when the
+ * callback receives the first block after the gap.
+ */
+unsigned int Channel::live_dropped() const
+{
+    std::map<Directory::LiveKey, Directory::LiveSubscriber>::const_iterator
+        sub_i = _job->dir()->_live_subscribers.find(
+                Directory::LiveKey(_job->id(), _dir_index));
+
+    return sub_i != _job->dir()->_live_subscribers.end() ?
+        sub_i->second.dropped : 0;
+}
+
+/*****************************************************************************/
+
 /**
    Returns true, if this channel has exactly the same chunk times
    as the other channel.
@@ -293,7 +788,7 @@ Channel::_fetch_chunks_local()
         IndexT<ChannelIndexRecord> index;
 
         try {
-            index.open_read(indexPath.str());
+            index.open_read_mapped(indexPath.str());
         }
         catch (EIndexT &e) {
             cerr << "Failed to open index: " << e.msg << endl;
@@ -561,7 +1056,7 @@ Channel::_fetch_chunks_network()
     }
 
     try {
-        _job->dir()->_receive_message(res);
+        _job->dir()->_receive_response(res);
     }
     catch (DirectoryException &e) {
         stringstream err;
@@ -669,7 +1164,8 @@ void Channel::_fetch_data_local(
         unsigned int min_values, /**< minimal number */
         DataCallback cb, /**< callback */
         void *cb_data, /**< arbitrary callback parameter */
-        unsigned int decimation /**< Decimation. */
+        unsigned int decimation, /**< Decimation. */
+        bool blocks /**< Pass compressed blocks undecoded. */
         )
 {
 #ifdef DEBUG_TIMING
@@ -686,19 +1182,32 @@ void Channel::_fetch_data_local(
 #endif
 
     ChunkMap::iterator chunk_i;
+    BlockDecoder *decoder = NULL;
 
     if (start < end) {
+        if (!blocks && _job->dir()->decoder_threads() > 1) {
+            // fetch undecoded blocks and decode them in parallel
+            decoder = new BlockDecoder(_job->dir()->decoder_threads(),
+                    _type, cb, cb_data);
+            cb = BlockDecoder::data_callback;
+            cb_data = decoder;
+            blocks = true;
+        }
+
         try {
             for (chunk_i = _chunks.begin(); chunk_i != _chunks.end();
                     chunk_i++) {
                 chunk_i->second.fetch_data(start, end,
-                        min_values, cb, cb_data, decimation);
+                        min_values, cb, cb_data, decimation, blocks);
             }
         } catch (ChunkException &e) {
+            delete decoder;
             stringstream err;
             err << "Failed to fetch data from chunk: " << e.msg;
             throw ChannelException(err.str());
         }
+
+        delete decoder; // passes the remaining data
     }
 
 #ifdef DEBUG_TIMING
@@ -718,7 +1227,8 @@ void Channel::_fetch_data_network(
         unsigned int min_values, /**< minimal number */
         DataCallback cb, /**< callback */
         void *cb_data, /**< arbitrary callback parameter */
-        unsigned int decimation /**< Decimation. */
+        unsigned int decimation, /**< Decimation. */
+        unsigned int envelope /**< Number of envelope buckets, or zero. */
         ) const
 {
     DlsProto::Request req;
@@ -735,15 +1245,7 @@ void Channel::_fetch_data_network(
     ts.set_now();
 #endif
 
-    DlsProto::JobRequest *job_req = req.mutable_job_request();
-    job_req->set_id(_job->id());
-    DlsProto::ChannelRequest *ch_req = job_req->mutable_channel_request();
-    ch_req->set_id(_dir_index);
-    DlsProto::DataRequest *data_req = ch_req->mutable_data_request();
-    data_req->set_start(start.to_uint64());
-    data_req->set_end(end.to_uint64());
-    data_req->set_min_values(min_values);
-    data_req->set_decimation(decimation);
+    _set_data_request(&req, start, end, min_values, decimation, envelope);
 
     try {
         _job->dir()->_send_message(req);
@@ -757,7 +1259,7 @@ void Channel::_fetch_data_network(
 
     while(1) {
         try {
-            _job->dir()->_receive_message(res, 0);
+            _job->dir()->_receive_response(res, 0);
         }
         catch (DirectoryException &e) {
             stringstream err;
@@ -809,6 +1311,85 @@ void Channel::_fetch_data_network(
 
 /*****************************************************************************/
 
+/** Fills in a data request for the channel.
+ */
+void Channel::_set_data_request(
+        DlsProto::Request *req, /**< Request message. */
+        Time start, /**< start of requested time range */
+        Time end, /**< end of requested time range */
+        unsigned int min_values, /**< minimal number */
+        unsigned int decimation, /**< Decimation. */
+        unsigned int envelope /**< Number of envelope buckets, or zero. */
+        ) const
+{
+    DlsProto::JobRequest *job_req = req->mutable_job_request();
+    job_req->set_id(_job->id());
+    DlsProto::ChannelRequest *ch_req = job_req->mutable_channel_request();
+    ch_req->set_id(_dir_index);
+    DlsProto::DataRequest *data_req = ch_req->mutable_data_request();
+    data_req->set_start(start.to_uint64());
+    data_req->set_end(end.to_uint64());
+    data_req->set_min_values(min_values);
+    data_req->set_decimation(decimation);
+    if (envelope) {
+        data_req->set_envelope(envelope);
+    }
+    if (_job->dir()->_protocol_version >= 3) {
+        Data::Encoding encoding = _job->dir()->_data_encoding;
+        if (encoding == Data::CompressedBlocks
+                && _job->dir()->_protocol_version < 4) {
+            encoding = Data::RawValues;
+        }
+        data_req->set_encoding((DlsProto::DataEncoding) encoding);
+    }
+}
+
+/*****************************************************************************/
+
+/** Sends a subscription request and receives the response.
+ *
+ * \throw ChannelException Failed or refused.
+ */
+void Channel::_send_subscription(
+        bool enable, /**< Subscribe or cancel. */
+        bool meta /**< Also push the meta levels. */
+        )
+{
+    DlsProto::Request req;
+    DlsProto::Response res;
+
+    DlsProto::JobRequest *job_req = req.mutable_job_request();
+    job_req->set_id(_job->id());
+    DlsProto::ChannelRequest *ch_req = job_req->mutable_channel_request();
+    ch_req->set_id(_dir_index);
+    DlsProto::Subscription *sub = ch_req->mutable_subscription();
+    sub->set_enable(enable);
+    if (enable) {
+        sub->set_encoding(
+                (DlsProto::DataEncoding) _job->dir()->_data_encoding);
+        sub->set_meta(meta);
+    }
+
+    try {
+        _job->dir()->_send_message(req);
+        _job->dir()->_receive_response(res);
+    }
+    catch (DirectoryException &e) {
+        stringstream err;
+        err << "Failed to " << (enable ? "subscribe" : "unsubscribe")
+            << ": " << e.msg;
+        throw ChannelException(err.str());
+    }
+
+    if (res.has_error()) {
+        stringstream err;
+        err << "Error response: " << res.error().message();
+        throw ChannelException(err.str());
+    }
+}
+
+/*****************************************************************************/
+
 void Channel::_update_index_local()
 {
     {
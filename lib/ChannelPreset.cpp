@@ -69,7 +69,10 @@ bool ChannelPreset::operator!=(const ChannelPreset &other) const
         meta_reduction != other.meta_reduction ||
         format_index != other.format_index ||
         mdct_block_size != other.mdct_block_size ||
-        accuracy != other.accuracy;
+        accuracy != other.accuracy ||
+        compression_level != other.compression_level ||
+        dictionary != other.dictionary ||
+        block_format != other.block_format;
 }
 
 /*****************************************************************************/
@@ -128,6 +131,19 @@ void ChannelPreset::read_from_tag(const XmlTag *tag)
             accuracy = tag->att("accuracy")->to_dbl();
         }
 
+        if (format_index == FORMAT_ZSTD)
+        {
+            if (tag->has_att("level"))
+            {
+                compression_level = tag->att("level")->to_int();
+            }
+
+            if (tag->has_att("dictionary"))
+            {
+                dictionary = tag->att("dictionary")->to_str();
+            }
+        }
+
         if (tag->has_att("type"))
         {
             type = str_to_channel_type(tag->att("type")->to_str());
@@ -136,6 +152,19 @@ void ChannelPreset::read_from_tag(const XmlTag *tag)
         {
             type = TUNKNOWN;
         }
+
+        if (tag->has_att("block_format"))
+        {
+            format_string = tag->att("block_format")->to_str();
+            block_format = str_to_block_format(format_string);
+
+            if (block_format == BlockFormatCount)
+            {
+                clear();
+                err << "Unknown block format \"" << format_string << "\"!";
+                throw EChannelPreset(err.str());
+            }
+        }
     }
     catch (EXmlTag &e)
     {
@@ -184,10 +213,28 @@ void ChannelPreset::write_to_tag(XmlTag *tag) const
         tag->push_att("accuracy", accuracy);
     }
 
+    if (format_index == FORMAT_ZSTD)
+    {
+        if (compression_level)
+        {
+            tag->push_att("level", compression_level);
+        }
+
+        if (dictionary != "")
+        {
+            tag->push_att("dictionary", dictionary);
+        }
+    }
+
     if (type != TUNKNOWN)
     {
         tag->push_att("type", channel_type_to_str(type));
     }
+
+    if (block_format != BlockFormatXml)
+    {
+        tag->push_att("block_format", block_format_strings[block_format]);
+    }
 }
 
 /*****************************************************************************/
@@ -206,7 +253,10 @@ void ChannelPreset::clear()
     format_index = FORMAT_INVALID;
     mdct_block_size = 0;
     accuracy = 0.0;
+    compression_level = 0;
+    dictionary = "";
     type = TUNKNOWN;
+    block_format = BlockFormatXml;
 }
 
 /*****************************************************************************/
@@ -21,6 +21,7 @@
 #include <fcntl.h>
 #include <math.h>
 #include <string.h>
+#include <zlib.h>
 
 #include <iostream>
 #include <fstream>
@@ -35,6 +36,7 @@ using namespace std;
 #include "File.h"
 #include "RingBufferT.h"
 #include "CompressionT.h"
+#include "BlockCache.h"
 
 #include "proto/dls.pb.h"
 
@@ -122,6 +124,27 @@ void Chunk::output_timing()
 
 /*****************************************************************************/
 
+/** Index search predicate: Record ends before a given time.
+ *
+ * A zero end time marks the data file that is currently written, so such a
+ * record does not end before any time.
+ */
+template <class REC>
+class RecordEndsBefore
+{
+    public:
+        RecordEndsBefore(Time time): _time(time) {}
+
+        bool operator()(const REC &rec) const {
+            return rec.end_time != 0 && Time(rec.end_time) < _time;
+        }
+
+    private:
+        Time _time;
+};
+
+/*****************************************************************************/
+
 /**
   Constructor.
  */
@@ -131,6 +154,8 @@ Chunk::Chunk():
     _meta_reduction(0),
     _format_index(0),
     _mdct_block_size(0),
+    _block_size(0),
+    _block_format(BlockFormatXml),
     _type(TUNKNOWN),
     _incomplete(true),
     _load_state(Empty)
@@ -144,6 +169,8 @@ Chunk::Chunk(const DlsProto::ChunkInfo &info, ChannelType type):
     _meta_reduction(0),
     _format_index(0),
     _mdct_block_size(0),
+    _block_size(0),
+    _block_format(BlockFormatXml),
     _start(info.start()),
     _end(info.end()),
     _type(type),
@@ -171,7 +198,7 @@ Chunk::~Chunk()
 void Chunk::import(const string &path, ChannelType type)
 {
     stringstream err;
-    string chunk_file_name, format_str;
+    string chunk_file_name, format_str, dict_file_name;
     fstream file;
     XmlParser xml;
     int i;
@@ -201,6 +228,9 @@ void Chunk::import(const string &path, ChannelType type)
 
         _sample_frequency = xml.tag()->att("sample_frequency")->to_dbl();
         _meta_reduction = xml.tag()->att("meta_reduction")->to_int();
+        if (xml.tag()->has_att("block_size")) {
+            _block_size = xml.tag()->att("block_size")->to_int();
+        }
         format_str = xml.tag()->att("format")->to_str();
 
         _format_index = FORMAT_INVALID;
@@ -218,6 +248,27 @@ void Chunk::import(const string &path, ChannelType type)
         if (_format_index == FORMAT_MDCT) {
             _mdct_block_size = xml.tag()->att("mdct_block_size")->to_int();
         }
+
+        if (_format_index == FORMAT_ZSTD && xml.tag()->has_att("dictionary")) {
+            dict_file_name =
+                _dir + "/" + xml.tag()->att("dictionary")->to_str();
+        }
+
+        // chunks without block format attribute use XML blocks
+        if (xml.tag()->has_att("block_format")) {
+            string block_format_str =
+                xml.tag()->att("block_format")->to_str();
+            _block_format = str_to_block_format(block_format_str);
+            if (_block_format == BlockFormatCount) {
+                file.close();
+                err << "Unknown block format \"" << block_format_str
+                    << "\"!";
+                throw ChunkException(err.str());
+            }
+        }
+        else {
+            _block_format = BlockFormatXml;
+        }
     }
     catch (EXmlParser &e) {
         file.close();
@@ -241,6 +292,21 @@ void Chunk::import(const string &path, ChannelType type)
 
     TRACE_TIMING(t_import_close);
 
+    _dictionary = "";
+    if (dict_file_name != "") {
+        fstream dict_file;
+        stringstream contents;
+
+        dict_file.open(dict_file_name.c_str(), ios::in | ios::binary);
+        if (!dict_file.is_open()) {
+            err << "Failed to open dictionary \"" << dict_file_name
+                << "\"!";
+            throw ChunkException(err.str());
+        }
+        contents << dict_file.rdbuf();
+        _dictionary = contents.str();
+    }
+
     _load_state = Full;
 }
 
@@ -256,6 +322,9 @@ void Chunk::preload(const string &path, ChannelType type,
     _meta_reduction = 0;
     _format_index = 0;
     _mdct_block_size = 0;
+    _block_size = 0;
+    _block_format = BlockFormatXml;
+    _dictionary = "";
     _start = start;
     _end = end;
     _type = type;
@@ -265,6 +334,21 @@ void Chunk::preload(const string &path, ChannelType type,
 
 /*****************************************************************************/
 
+/** Returns the number of values per block.
+ *
+ * The chunk description is imported, if necessary.
+ */
+unsigned int Chunk::block_size()
+{
+    if (_load_state != Full) {
+        import(_dir, _type);
+    }
+
+    return _block_size;
+}
+
+/*****************************************************************************/
+
 /**
    Fetches data.
 */
@@ -275,7 +359,9 @@ void Chunk::fetch_data(
         unsigned int min_values,
         DataCallback cb,
         void *cb_data, /**< arbitrary callback param */
-        unsigned int decimation
+        unsigned int decimation,
+        bool blocks /**< Pass compressed blocks instead of values, if
+                      possible (see Data::import_block()). */
         )
 {
     if (!decimation) {
@@ -310,6 +396,15 @@ void Chunk::fetch_data(
         import(_dir, _type);
     }
 
+    // MDCT blocks depend on their predecessors, ZStd blocks on the chunk's
+    // dictionary, decimation needs the values and the size of long integers
+    // is platform-dependent, so these are always decompressed.
+    if (_format_index == FORMAT_MDCT || _format_index == FORMAT_ZSTD
+            || decimation > 1
+            || _type == TLINT || _type == TULINT) {
+        blocks = false;
+    }
+
     unsigned int level = _calc_optimal_level(start, end, min_values);
     unsigned int decimationCounter = 0;
     Data *data = NULL;
@@ -333,14 +428,14 @@ void Chunk::fetch_data(
         if (!level) {
             _fetch_level_data_wrapper(start, end, MetaGen, level,
                     time_per_value, &data, cb, cb_data,
-                    decimation, decimationCounter, last);
+                    decimation, decimationCounter, last, blocks);
         } else {
             _fetch_level_data_wrapper(start, end, MetaMin, level,
                     time_per_value, &data, cb, cb_data,
-                    decimation, decimationCounter, last);
+                    decimation, decimationCounter, last, blocks);
             _fetch_level_data_wrapper(start, end, MetaMax, level,
                     time_per_value, &data, cb, cb_data,
-                    decimation, decimationCounter, last);
+                    decimation, decimationCounter, last, blocks);
         }
 
         Time diff_to_end = end_to_use - last;
@@ -390,59 +485,60 @@ void Chunk::_fetch_level_data_wrapper(Time start,
                                                                parameter */
                                               unsigned int decimation,
                                               unsigned int &decimationCounter,
-                                              Time &last
+                                              Time &last,
+                                              bool blocks
                                               ) const
 {
     switch (_type) {
         case TCHAR:
             _fetch_level_data<char>(start, end, meta_type, level,
                     time_per_value, data, cb, cb_data, decimation,
-                    decimationCounter, last);
+                    decimationCounter, last, blocks);
             break;
         case TUCHAR:
             _fetch_level_data<unsigned char>(start, end, meta_type, level,
                     time_per_value, data, cb, cb_data, decimation,
-                    decimationCounter, last);
+                    decimationCounter, last, blocks);
             break;
         case TSHORT:
             _fetch_level_data<short>(start, end, meta_type, level,
                     time_per_value, data, cb, cb_data, decimation,
-                    decimationCounter, last);
+                    decimationCounter, last, blocks);
             break;
         case TUSHORT:
             _fetch_level_data<unsigned short>(start, end, meta_type, level,
                     time_per_value, data, cb, cb_data, decimation,
-                    decimationCounter, last);
+                    decimationCounter, last, blocks);
             break;
         case TINT:
             _fetch_level_data<int>(start, end, meta_type, level,
                     time_per_value, data, cb, cb_data, decimation,
-                    decimationCounter, last);
+                    decimationCounter, last, blocks);
             break;
         case TUINT:
             _fetch_level_data<unsigned int>(start, end, meta_type, level,
                     time_per_value, data, cb, cb_data, decimation,
-                    decimationCounter, last);
+                    decimationCounter, last, blocks);
             break;
         case TLINT:
             _fetch_level_data<long>(start, end, meta_type, level,
                     time_per_value, data, cb, cb_data, decimation,
-                    decimationCounter, last);
+                    decimationCounter, last, blocks);
             break;
         case TULINT:
             _fetch_level_data<unsigned long>(start, end, meta_type, level,
                     time_per_value, data, cb, cb_data, decimation,
-                    decimationCounter, last);
+                    decimationCounter, last, blocks);
             break;
         case TFLT:
             _fetch_level_data<float>(start, end, meta_type, level,
                     time_per_value, data, cb, cb_data, decimation,
-                    decimationCounter, last);
+                    decimationCounter, last, blocks);
             break;
         case TDBL:
             _fetch_level_data<double>(start, end, meta_type, level,
                     time_per_value, data, cb, cb_data, decimation,
-                    decimationCounter, last);
+                    decimationCounter, last, blocks);
             break;
 
         default: {
@@ -471,18 +567,20 @@ void Chunk::_fetch_level_data(Time start,
                          parameter */
         unsigned int decimation,
         unsigned int &decimationCounter,
-        Time &last
+        Time &last,
+        bool blocks
         ) const
 {
     stringstream level_dir_name;
     string global_index_file_name;
     stringstream data_file_name;
     IndexT<GlobalIndexRecord> global_index;
+    IndexT<GlobalIndexRecord>::iterator global_i;
     GlobalIndexRecord global_index_record;
     IndexT<IndexRecord> index;
     IndexRecord index_record, next_index_record;
     File data_file;
-    unsigned int i, index_row, blocks_read = 0;
+    unsigned int index_row, blocks_read = 0;
     CompressionT<T> *comp;
     bool next_record_already_read = false;
 
@@ -521,6 +619,32 @@ void Chunk::_fetch_level_data(Time start,
             return;
         }
     }
+    else if (_format_index == FORMAT_DELTA) {
+        if (typeid(T) == typeid(float) || typeid(T) == typeid(double)) {
+            stringstream err;
+            err << "ERROR: Delta only for integer types!";
+            log(err.str());
+            return;
+        }
+        comp = new CompressionT_Delta<T>();
+    }
+    else if (_format_index == FORMAT_XOR) {
+        if (typeid(T) == typeid(float)) {
+            comp = (CompressionT<T> *) new CompressionT_XOR<float>();
+        }
+        else if (typeid(T) == typeid(double)) {
+            comp = (CompressionT<T> *) new CompressionT_XOR<double>();
+        }
+        else {
+            stringstream err;
+            err << "ERROR: XOR only for floating point types!";
+            log(err.str());
+            return;
+        }
+    }
+    else if (_format_index == FORMAT_ZSTD) {
+        comp = new CompressionT_ZStd<T>(0, _dictionary);
+    }
     else {
         stringstream err;
         err << "ERROR: Unknown compression type index: "
@@ -529,25 +653,40 @@ void Chunk::_fetch_level_data(Time start,
         return;
     }
 
+    comp->set_base64(_block_format == BlockFormatXml);
+
     level_dir_name << _dir << "/level" << level;
     global_index_file_name = level_dir_name.str() + "/data_"
         + meta_type_str(meta_type) + ".idx";
 
     try {
-        global_index.open_read(global_index_file_name);
+        global_index.open_read_mapped(global_index_file_name);
     } catch (EIndexT &e) {
         // global index not found.
         delete comp;
         return;
     }
 
-    // loop through all indexed data files -- FIXME use binary search
-    for (i = 0; i < global_index.record_count(); i++) {
+    // skip all data files covering time ranges before the requested range
+    try {
+        global_i = global_index.lower_bound(
+                RecordEndsBefore<GlobalIndexRecord>(start));
+    } catch (EIndexT &e) {
+        stringstream err;
+        err << "ERROR: Failed to search global index \""
+            << global_index_file_name << "\". Reason: " << e.msg;
+        log(err.str());
+        delete comp;
+        return;
+    }
+
+    // loop through the indexed data files
+    for (; global_i != global_index.end(); ++global_i) {
         try {
-            global_index_record = global_index[i];
+            global_index_record = *global_i;
         } catch (EIndexT &e) {
             stringstream err;
-            err << "ERROR: Failed read record " << i
+            err << "ERROR: Failed read record " << global_i.row()
                  << " from global index \"";
             err << global_index_file_name << "\". Reason: " << e.msg;
             log(err.str());
@@ -555,12 +694,6 @@ void Chunk::_fetch_level_data(Time start,
             return;
         }
 
-        if (Time(global_index_record.end_time) < start
-            && global_index_record.end_time != 0) {
-            // this data file covers a time range before the requested range
-            continue;
-        }
-
         if (Time(global_index_record.start_time) > end) {
             // from here, all data files cover time ranges after
             // the requested range -> abort search
@@ -575,7 +708,7 @@ void Chunk::_fetch_level_data(Time start,
 
         string indexPath = data_file_name.str() + ".idx";
         try {
-            index.open_read(indexPath);
+            index.open_read_mapped(indexPath);
             data_file.open_read(data_file_name.str().c_str());
         } catch (EIndexT &e) {
             stringstream err;
@@ -595,8 +728,21 @@ void Chunk::_fetch_level_data(Time start,
 
         bool next_record_already_read = false;
 
-        // loop through all index records -- FIXME use binary search!
-        for (index_row = 0; index_row < index.record_count(); index_row++) {
+        // skip all blocks covering time ranges before the requested range
+        try {
+            index_row = index.lower_bound(
+                    RecordEndsBefore<IndexRecord>(start)).row();
+        } catch (EIndexT &e) {
+            stringstream err;
+            err << "ERROR: Could not search index \"" << indexPath
+                << "\": " << e.msg;
+            log(err.str());
+            delete comp;
+            return;
+        }
+
+        // loop through the index records
+        for (; index_row < index.record_count(); index_row++) {
             if (next_record_already_read) {
                 index_record = next_index_record;
             }
@@ -628,7 +774,7 @@ void Chunk::_fetch_level_data(Time start,
             if (!_read_tag(index, index_row, index_record, next_index_record,
                         next_record_already_read, data_file, comp, meta_type,
                         level, time_per_value, data, cb, cb_data, decimation,
-                        decimationCounter, last)) {
+                        decimationCounter, last, blocks)) {
                 delete comp;
                 return;
             }
@@ -644,7 +790,7 @@ void Chunk::_fetch_level_data(Time start,
         if (!_read_tag(index, index_row, index_record, next_index_record,
                     next_record_already_read, data_file, comp, meta_type,
                     level, time_per_value, data, cb, cb_data, decimation,
-                    decimationCounter, last)) {
+                    decimationCounter, last, blocks)) {
             delete comp;
             return;
         }
@@ -655,6 +801,178 @@ void Chunk::_fetch_level_data(Time start,
 
 /*****************************************************************************/
 
+/** Appends the statistics of the stored blocks intersecting a time range.
+ *
+ * The statistics are read from the ".stat" files next to the data file
+ * indices, so no block is decompressed. The meta level is chosen, so that
+ * the time range contains at least \a min_blocks blocks. On level 0, the
+ * statistics of the generic values are returned, on higher levels those of
+ * the minimum and maximum values.
+ *
+ * Blocks without statistics (e. g. from older versions) are returned with
+ * a count of zero; their values can be fetched with fetch_level_data().
+ *
+ * \return Meta level.
+ */
+unsigned int Chunk::fetch_block_stats(
+        Time start, /**< Start of the time range. */
+        Time end, /**< End of the time range. */
+        unsigned int min_blocks, /**< Minimum number of blocks. */
+        std::vector<BlockStats> &stats /**< Statistics. */
+        )
+{
+    unsigned int level;
+
+    if (start > _end || end < _start) {
+        return 0;
+    }
+
+    if (_load_state != Full) {
+        import(_dir, _type);
+    }
+
+    level = _calc_optimal_level(start, end, min_blocks * _block_size);
+
+    if (!level) {
+        _fetch_block_stats(start, end, level, MetaGen, stats);
+    }
+    else {
+        _fetch_block_stats(start, end, level, MetaMin, stats);
+        _fetch_block_stats(start, end, level, MetaMax, stats);
+    }
+
+    return level;
+}
+
+/*****************************************************************************/
+
+/** Passes the decoded values of a meta level to a data callback.
+ *
+ * Complements fetch_block_stats() for blocks without usable statistics.
+ */
+void Chunk::fetch_level_data(
+        Time start, /**< Start of the time range. */
+        Time end, /**< End of the time range. */
+        unsigned int level, /**< Meta level. */
+        MetaType meta_type, /**< Meta type. */
+        DataCallback cb, /**< Callback. */
+        void *cb_data /**< Arbitrary callback parameter. */
+        )
+{
+    unsigned int decimationCounter = 0;
+    Data *data = NULL;
+    Time last;
+
+    if (_load_state != Full) {
+        import(_dir, _type);
+    }
+
+    _fetch_level_data_wrapper(start, end, meta_type, level,
+            _time_per_value(level), &data, cb, cb_data, 1,
+            decimationCounter, last, false);
+
+    if (data) {
+        delete data;
+    }
+}
+
+/*****************************************************************************/
+
+/** Appends the statistics of the blocks of a meta level and type.
+ */
+void Chunk::_fetch_block_stats(
+        Time start, /**< Start of the time range. */
+        Time end, /**< End of the time range. */
+        unsigned int level, /**< Meta level. */
+        MetaType meta_type, /**< Meta type. */
+        std::vector<BlockStats> &stats /**< Statistics. */
+        ) const
+{
+    stringstream level_dir_name;
+    string path;
+    IndexT<GlobalIndexRecord> global_index;
+    IndexT<GlobalIndexRecord>::iterator global_i;
+    IndexT<IndexRecord> index;
+    IndexT<IndexStatRecord> stat_index;
+    unsigned int row;
+
+    level_dir_name << _dir << "/level" << level;
+
+    try {
+        global_index.open_read_mapped(level_dir_name.str() + "/data_"
+                + meta_type_str(meta_type) + ".idx");
+        global_i = global_index.lower_bound(
+                RecordEndsBefore<GlobalIndexRecord>(start));
+    } catch (EIndexT &e) {
+        return; // no data
+    }
+
+    for (; global_i != global_index.end(); ++global_i) {
+        GlobalIndexRecord global_record = *global_i;
+
+        if (Time(global_record.start_time) > end) {
+            break;
+        }
+
+        stringstream data_file_name;
+        data_file_name << level_dir_name.str() << "/data"
+            << global_record.start_time << "_" << meta_type_str(meta_type);
+
+        path = data_file_name.str() + ".idx";
+        try {
+            index.open_read_mapped(path);
+            row = index.lower_bound(RecordEndsBefore<IndexRecord>(start)).row();
+        } catch (EIndexT &e) {
+            stringstream err;
+            err << "Failed to read index \"" << path << "\": " << e.msg;
+            throw ChunkException(err.str());
+        }
+
+        try {
+            stat_index.open_read_mapped(data_file_name.str() + ".stat");
+        } catch (EIndexT &e) {
+            stat_index.close(); // no statistics
+        }
+
+        try {
+            for (; row < index.record_count(); row++) {
+                IndexRecord index_record = index[row];
+                BlockStats block;
+
+                if (Time(index_record.start_time) > end) {
+                    break;
+                }
+
+                block.meta_type = meta_type;
+                block.start = index_record.start_time;
+                block.end = index_record.end_time;
+                block.min = block.max = block.mean = 0.0;
+                block.count = 0;
+
+                if (stat_index.open() && row < stat_index.record_count()) {
+                    IndexStatRecord stat_record = stat_index[row];
+                    block.min = stat_record.min;
+                    block.max = stat_record.max;
+                    block.mean = stat_record.mean;
+                    block.count = stat_record.count;
+                }
+
+                stats.push_back(block);
+            }
+
+            index.close();
+            stat_index.close();
+        } catch (EIndexT &e) {
+            stringstream err;
+            err << "Failed to read block statistics of \""
+                << data_file_name.str() << "\": " << e.msg;
+            throw ChunkException(err.str());
+        }
+    }
+}
+
+/*****************************************************************************/
+
 /** Read one data tag.
  */
 template <class T>
@@ -674,12 +992,47 @@ bool Chunk::_read_tag(
         void *cb_data, /**< arbitrary callback parameter */
         unsigned int decimation,
         unsigned int &decimationCounter,
-        Time &last
+        Time &last,
+        bool blocks
         ) const
 {
     size_t to_read, read_bytes;
     XmlParser xml;
 
+    // MDCT blocks depend on their predecessors and can not be cached
+    bool cached = !blocks && _format_index != FORMAT_MDCT
+        && BlockCache::global().enabled();
+
+    if (cached) {
+        vector<double> values;
+
+        if (BlockCache::global().fetch(data_file.path(),
+                    index_record.position, index_record.start_time,
+                    values)) {
+            if (!*data) {
+                *data = new Data();
+            }
+
+            (*data)->import(index_record.start_time, time_per_value,
+                    meta_type, level, decimation, decimationCounter,
+                    &values[0], values.size());
+
+            last = Time(index_record.start_time)
+                + time_per_value * (unsigned int) (values.size() - 1);
+
+            // the next index record was not read
+            next_record_already_read = false;
+
+            // invoke data callback
+            if (cb(*data, cb_data)) {
+                // data structure adopted: forget its address.
+                *data = NULL;
+            }
+
+            return true;
+        }
+    }
+
     // determine data size to read
     if (index_row < index.record_count() - 1) {
         // there is a following index tag, so we can take the amount of
@@ -740,6 +1093,60 @@ bool Chunk::_read_tag(
         return false;
     }
 
+    if (_block_format == BlockFormatBinary) {
+        BlockHeader header;
+        const char *payload;
+
+        if (buffer.size() < sizeof(BlockHeader)) {
+            stringstream err;
+            err << "ERROR: Incomplete block header in \"" << data_file.path()
+                << "\" at position " << index_record.position << ".";
+            log(err.str());
+            return false;
+        }
+
+        memcpy(&header, buffer.data(), sizeof(BlockHeader));
+        payload = buffer.data() + sizeof(BlockHeader);
+
+        if (header.magic != DLS_BLOCK_MAGIC) {
+            stringstream err;
+            err << "ERROR: Invalid block header in \"" << data_file.path()
+                << "\" at position " << index_record.position << ".";
+            log(err.str());
+            return false;
+        }
+
+        if (header.size > buffer.size() - sizeof(BlockHeader)) {
+            stringstream err;
+            err << "ERROR: Block in \"" << data_file.path()
+                << "\" at position " << index_record.position
+                << " exceeds the indexed range.";
+            log(err.str());
+            return false;
+        }
+
+        if (crc32(0L, (const Bytef *) payload, header.size)
+                != header.checksum) {
+            stringstream err;
+            err << "ERROR: Checksum mismatch in block of \""
+                << data_file.path() << "\" at position "
+                << index_record.position << ".";
+            log(err.str());
+            return false;
+        }
+
+        if (_process_data_block(payload, header.size, header.length,
+                    index_record.start_time, meta_type, level,
+                    time_per_value, comp, data, cb, cb_data, decimation,
+                    decimationCounter, last, blocks) && cached) {
+            BlockCache::global().store(data_file.path(),
+                    index_record.position, index_record.start_time,
+                    comp->decompression_output(),
+                    comp->decompressed_length());
+        }
+        return true;
+    }
+
     try {
         istringstream str(buffer);
         xml.parse(&str);
@@ -757,11 +1164,19 @@ bool Chunk::_read_tag(
 
     if (xml.tag()->title() == "d") {
         try {
-            _process_data_tag(xml.tag(), index_record.start_time,
-                    meta_type, level, time_per_value,
-                    comp, data, cb, cb_data,
-                    decimation, decimationCounter,
-                    last);
+            const string &block_data = xml.tag()->att("d")->to_str();
+            if (_process_data_block(block_data.c_str(), block_data.size(),
+                        xml.tag()->att("s")->to_int(),
+                        index_record.start_time,
+                        meta_type, level, time_per_value,
+                        comp, data, cb, cb_data,
+                        decimation, decimationCounter,
+                        last, blocks) && cached) {
+                BlockCache::global().store(data_file.path(),
+                        index_record.position, index_record.start_time,
+                        comp->decompression_output(),
+                        comp->decompressed_length());
+            }
         } catch (EXmlTag &e) {
             stringstream err;
             err << "ERROR: Could not read block: " << e.msg;
@@ -776,11 +1191,21 @@ bool Chunk::_read_tag(
 /*****************************************************************************/
 
 /**
-   Loads data from an XML tag.
+   Uncompresses a data block and passes the values to the callback.
+
+   \param block_data Compressed data (Base64-encoded for XML blocks)
+   \param data_size Size of the compressed data in bytes
+   \param block_size Number of values in the block, or zero for a flushed
+   rest block.
+
+   \return true, if the block was decompressed. The values are then
+   available from the compression object.
 */
 
 template <class T>
-void Chunk::_process_data_tag(const XmlTag *tag,
+bool Chunk::_process_data_block(const char *block_data,
+        unsigned int data_size,
+        unsigned int block_size,
         Time start_time,
         MetaType meta_type,
         unsigned int level,
@@ -792,23 +1217,36 @@ void Chunk::_process_data_tag(const XmlTag *tag,
                          parameter */
         unsigned int decimation,
         unsigned int &decimationCounter,
-        Time &last
+        Time &last,
+        bool blocks
         ) const
 {
-    unsigned int block_size;
-    const char *block_data;
+    if (block_size && blocks) {
+        if (!*data) {
+            *data = new Data();
+        }
+
+        (*data)->import_block(start_time, time_per_value, meta_type, level,
+                _format_index, comp->base64(), block_data, data_size,
+                block_size);
 
-    block_data = tag->att("d")->to_str().c_str();
-    block_size = tag->att("s")->to_int();
+        last = start_time + time_per_value * (block_size - 1);
 
-    if (block_size) {
+        // invoke data callback
+        if (cb(*data, cb_data)) {
+            // data structure adopted: forget its address.
+            *data = NULL;
+        }
+
+        return false;
+    } else if (block_size) {
         try {
-            comp->uncompress(block_data, strlen(block_data), block_size);
+            comp->uncompress(block_data, data_size, block_size);
         } catch (ECompression &e) {
             stringstream err;
             err << "ERROR while uncompressing: " << e.msg;
             log(err.str());
-            return;
+            return false;
         }
 
         if (!*data) {
@@ -832,14 +1270,16 @@ void Chunk::_process_data_tag(const XmlTag *tag,
             // data structure adopted: forget its address.
             *data = NULL;
         }
+
+        return true;
     } else if (_format_index == FORMAT_MDCT) {
         try {
-            comp->flush_uncompress(block_data, strlen(block_data));
+            comp->flush_uncompress(block_data, data_size);
         } catch (ECompression &e) {
             stringstream err;
             err << "ERROR while uncompressing: " << e.msg;
             log(err.str());
-            return;
+            return false;
         }
 
         if (!*data) {
@@ -863,7 +1303,11 @@ void Chunk::_process_data_tag(const XmlTag *tag,
             // data structure adopted: forget its address.
             *data = NULL;
         }
+
+        return true;
     }
+
+    return false;
 }
 
 /*****************************************************************************/
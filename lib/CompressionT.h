@@ -23,9 +23,12 @@
 /*****************************************************************************/
 
 #include "ZLib.h"
+#include "ZStd.h"
 #include "Base64.h"
 #include "MdctT.h"
 #include "QuantT.h"
+#include "DeltaT.h"
+#include "XorT.h"
 #include "LibDLS/Exception.h"
 
 //#define DEBUG
@@ -56,15 +59,32 @@ template <class T>
 class CompressionT
 {
 public:
-    CompressionT() {};
+    CompressionT(): _encode_base64(true) {};
     virtual ~CompressionT() {};
 
+    /**
+       Enables or disables the final Base64 encoding step.
+
+       Binary block containers store the compressed data raw, so that
+       compress() delivers and uncompress() expects the data without
+       Base64 encoding, if disabled.
+    */
+
+    void set_base64(bool enable) { _encode_base64 = enable; }
+    bool base64() const { return _encode_base64; }
+
     /**
        Gibt alle persistenten Speicher frei.
 
-       Die Speicher werden bei der nchsten Anforderung immer
-       neu angelegt. Durch den Aufruf von free() wird der
-       Speicher in der Zwischenzeit nicht unntig belegt.
+       Die Speicher werden bei der nchsten Anforderung wieder
+       angelegt. Durch den Aufruf von free() wird der Speicher in
+       der Zwischenzeit nicht unntig belegt.
+
+       Ohne free() werden die Ausgabespeicher fr alle weiteren
+       Aufrufe von compress() und uncompress() wiederverwendet und
+       nur bei Bedarf vergrert. Ein Objekt, das ber viele Blcke
+       hinweg zum Dekomprimieren benutzt wird, kommt so ohne weitere
+       Speicheranforderungen aus.
     */
 
     virtual void free() = 0;
@@ -153,6 +173,9 @@ public:
     */
 
     virtual unsigned int decompressed_length() const = 0;
+
+protected:
+    bool _encode_base64; /**< Base64-encode the compressed data. */
 };
 
 /*****************************************************************************/
@@ -229,7 +252,9 @@ void CompressionT_ZLib<T>::compress(const T *input,
     try
     {
         _zlib.compress((char *) input, length * sizeof(T));
-        _base64.encode(_zlib.output(), _zlib.output_size());
+        if (this->_encode_base64) {
+            _base64.encode(_zlib.output(), _zlib.output_size());
+        }
     }
     catch (EZLib &e)
     {
@@ -252,13 +277,14 @@ void CompressionT_ZLib<T>::uncompress(const char *input,
 {
     stringstream err;
 
-    free();
-
     try
     {
-        _base64.decode(input, size);
-        _zlib.uncompress(_base64.output(), _base64.output_size(),
-                         length * sizeof(T));
+        if (this->_encode_base64) {
+            _base64.decode(input, size);
+            input = _base64.output();
+            size = _base64.output_size();
+        }
+        _zlib.uncompress(input, size, length * sizeof(T));
     }
     catch (EBase64 &e)
     {
@@ -308,7 +334,7 @@ void CompressionT_ZLib<T>::flush_uncompress(const char *input,
 template<class T>
 const char *CompressionT_ZLib<T>::compression_output() const
 {
-    return _base64.output();
+    return this->_encode_base64 ? _base64.output() : _zlib.output();
 }
 
 /*****************************************************************************/
@@ -316,7 +342,8 @@ const char *CompressionT_ZLib<T>::compression_output() const
 template<class T>
 unsigned int CompressionT_ZLib<T>::compressed_size() const
 {
-    return _base64.output_size();
+    return this->_encode_base64 ?
+        _base64.output_size() : _zlib.output_size();
 }
 
 /*****************************************************************************/
@@ -429,7 +456,9 @@ void CompressionT_MDCT<T>::compress(const T *input,
         _mdct->transform(input, length);
         _zlib.compress((char *) _mdct->mdct_output(),
                        _mdct->mdct_output_size());
-        _base64.encode(_zlib.output(), _zlib.output_size());
+        if (this->_encode_base64) {
+            _base64.encode(_zlib.output(), _zlib.output_size());
+        }
     }
     catch (EMDCT &e)
     {
@@ -462,8 +491,12 @@ void CompressionT_MDCT<T>::uncompress(const char *input,
 
     try
     {
-        _base64.decode(input, size);
-        _zlib.uncompress(_base64.output(), _base64.output_size(), max_size);
+        if (this->_encode_base64) {
+            _base64.decode(input, size);
+            input = _base64.output();
+            size = _base64.output_size();
+        }
+        _zlib.uncompress(input, size, max_size);
         _mdct->detransform(_zlib.output(), length);
     }
     catch (EBase64 &e)
@@ -502,7 +535,9 @@ void CompressionT_MDCT<T>::flush_compress()
     {
         _mdct->flush_transform();
         _zlib.compress(_mdct->mdct_output(), _mdct->mdct_output_size());
-        _base64.encode(_zlib.output(), _zlib.output_size());
+        if (this->_encode_base64) {
+            _base64.encode(_zlib.output(), _zlib.output_size());
+        }
     }
     catch (EMDCT &e)
     {
@@ -535,8 +570,12 @@ void CompressionT_MDCT<T>::flush_uncompress(const char *input,
 
     try
     {
-        _base64.decode(input, size);
-        _zlib.uncompress(_base64.output(), _base64.output_size(), max_size);
+        if (this->_encode_base64) {
+            _base64.decode(input, size);
+            input = _base64.output();
+            size = _base64.output_size();
+        }
+        _zlib.uncompress(input, size, max_size);
         _mdct->flush_detransform(_zlib.output(), _zlib.output_size());
     }
     catch (EBase64 &e)
@@ -561,7 +600,7 @@ void CompressionT_MDCT<T>::flush_uncompress(const char *input,
 template<class T>
 const char *CompressionT_MDCT<T>::compression_output() const
 {
-    return _base64.output();
+    return this->_encode_base64 ? _base64.output() : _zlib.output();
 }
 
 /*****************************************************************************/
@@ -569,7 +608,8 @@ const char *CompressionT_MDCT<T>::compression_output() const
 template<class T>
 unsigned int CompressionT_MDCT<T>::compressed_size() const
 {
-    return _base64.output_size();
+    return this->_encode_base64 ?
+        _base64.output_size() : _zlib.output_size();
 }
 
 /*****************************************************************************/
@@ -687,7 +727,9 @@ void CompressionT_Quant<T>::compress(const T *input,
     {
         _quant->quantize(input, length);
         _zlib.compress(_quant->quant_output(), _quant->quant_output_size());
-        _base64.encode(_zlib.output(), _zlib.output_size());
+        if (this->_encode_base64) {
+            _base64.encode(_zlib.output(), _zlib.output_size());
+        }
     }
     catch (EQuant &e)
     {
@@ -717,14 +759,14 @@ void CompressionT_Quant<T>::uncompress(const char *input,
 
     if (!_quant) throw Exception("No quantization object!");
 
-    free();
-
     try
     {
-        _base64.decode(input, size);
-        _zlib.uncompress(_base64.output(),
-                         _base64.output_size(),
-                         length * sizeof(T));
+        if (this->_encode_base64) {
+            _base64.decode(input, size);
+            input = _base64.output();
+            size = _base64.output_size();
+        }
+        _zlib.uncompress(input, size, length * sizeof(T));
         _quant->dequantize(_zlib.output(), _zlib.output_size(), length);
     }
     catch (EBase64 &e)
@@ -780,7 +822,7 @@ void CompressionT_Quant<T>::flush_uncompress(const char *input,
 template<class T>
 const char *CompressionT_Quant<T>::compression_output() const
 {
-    return _base64.output();
+    return this->_encode_base64 ? _base64.output() : _zlib.output();
 }
 
 /*****************************************************************************/
@@ -788,7 +830,8 @@ const char *CompressionT_Quant<T>::compression_output() const
 template<class T>
 unsigned int CompressionT_Quant<T>::compressed_size() const
 {
-    return _base64.output_size();
+    return this->_encode_base64 ?
+        _base64.output_size() : _zlib.output_size();
 }
 
 /*****************************************************************************/
@@ -811,6 +854,578 @@ unsigned int CompressionT_Quant<T>::decompressed_length() const
     return _quant->dequant_output_length();
 }
 
+/*****************************************************************************/
+//
+//  Delta / Base64
+//
+/*****************************************************************************/
+
+/**
+   Kompressionsobjekt: Verlustfreie Delta-Kodierung, dann Base64
+
+   Nur fr Integer-Typen.
+*/
+
+template <class T>
+class CompressionT_Delta : public CompressionT<T>
+{
+public:
+    CompressionT_Delta();
+    ~CompressionT_Delta();
+
+    void compress(const T *input,
+                  unsigned int length);
+    void uncompress(const char *input,
+                    unsigned int size,
+                    unsigned int length);
+    void clear();
+    void flush_compress();
+    void flush_uncompress(const char *input,
+                          unsigned int size);
+
+    void free();
+
+    const char *compression_output() const;
+    unsigned int compressed_size() const;
+    const T *decompression_output() const;
+    unsigned int decompressed_length() const;
+
+private:
+    DeltaT<T> _delta;      /**< Delta-Kodierer */
+    Base64 _base64;        /**< Base64-Objekt zum Kodieren */
+};
+
+/*****************************************************************************/
+
+template <class T>
+CompressionT_Delta<T>::CompressionT_Delta()
+{
+}
+
+/*****************************************************************************/
+
+template <class T>
+CompressionT_Delta<T>::~CompressionT_Delta()
+{
+    free();
+}
+
+/*****************************************************************************/
+
+template <class T>
+void CompressionT_Delta<T>::free()
+{
+    _delta.free();
+    _base64.free();
+}
+
+/*****************************************************************************/
+
+template <class T>
+void CompressionT_Delta<T>::compress(const T *input,
+                                     unsigned int length)
+{
+    stringstream err;
+
+    try
+    {
+        _delta.encode(input, length);
+        if (this->_encode_base64) {
+            _base64.encode(_delta.encode_output(),
+                           _delta.encode_output_size());
+        }
+    }
+    catch (EBase64 &e)
+    {
+        err << "Base64: " << e.msg;
+        throw ECompression(err.str());
+    }
+    catch (...)
+    {
+        throw ECompression("Delta: Could not allocate memory!");
+    }
+}
+
+/*****************************************************************************/
+
+template <class T>
+void CompressionT_Delta<T>::uncompress(const char *input,
+                                       unsigned int size,
+                                       unsigned int length)
+{
+    stringstream err;
+
+    try
+    {
+        if (this->_encode_base64) {
+            _base64.decode(input, size);
+            input = _base64.output();
+            size = _base64.output_size();
+        }
+        _delta.decode(input, size, length);
+    }
+    catch (EBase64 &e)
+    {
+        err << "While Base64-decoding: " << e.msg << endl;
+        throw ECompression(err.str());
+    }
+    catch (EDelta &e)
+    {
+        err << "While Delta-decoding: " << e.msg << endl;
+        throw ECompression(err.str());
+    }
+    catch (EBitStream &e)
+    {
+        err << "While Delta-decoding: " << e.msg << endl;
+        throw ECompression(err.str());
+    }
+    catch (...)
+    {
+        throw ECompression("While Delta-decoding:"
+                           " Could not allocate memory!");
+    }
+}
+
+/*****************************************************************************/
+
+template <class T>
+void CompressionT_Delta<T>::clear()
+{
+}
+
+/*****************************************************************************/
+
+template <class T>
+void CompressionT_Delta<T>::flush_compress()
+{
+    free();
+}
+
+/*****************************************************************************/
+
+template <class T>
+void CompressionT_Delta<T>::flush_uncompress(const char *input,
+                                             unsigned int size)
+{
+    free();
+}
+
+/*****************************************************************************/
+
+template<class T>
+const char *CompressionT_Delta<T>::compression_output() const
+{
+    return this->_encode_base64 ?
+        _base64.output() : _delta.encode_output();
+}
+
+/*****************************************************************************/
+
+template<class T>
+unsigned int CompressionT_Delta<T>::compressed_size() const
+{
+    return this->_encode_base64 ?
+        _base64.output_size() : _delta.encode_output_size();
+}
+
+/*****************************************************************************/
+
+template<class T>
+const T *CompressionT_Delta<T>::decompression_output() const
+{
+    return _delta.decode_output();
+}
+
+/*****************************************************************************/
+
+template<class T>
+unsigned int CompressionT_Delta<T>::decompressed_length() const
+{
+    return _delta.decode_output_length();
+}
+
+/*****************************************************************************/
+//
+//  XOR / Base64
+//
+/*****************************************************************************/
+
+/**
+   Kompressionsobjekt: Verlustfreie XOR-Kodierung, dann Base64
+
+   Nur fr Fliekomma-Typen.
+*/
+
+template <class T>
+class CompressionT_XOR : public CompressionT<T>
+{
+public:
+    CompressionT_XOR();
+    ~CompressionT_XOR();
+
+    void compress(const T *input,
+                  unsigned int length);
+    void uncompress(const char *input,
+                    unsigned int size,
+                    unsigned int length);
+    void clear();
+    void flush_compress();
+    void flush_uncompress(const char *input,
+                          unsigned int size);
+
+    void free();
+
+    const char *compression_output() const;
+    unsigned int compressed_size() const;
+    const T *decompression_output() const;
+    unsigned int decompressed_length() const;
+
+private:
+    XorT<T> _xor;          /**< XOR-Kodierer */
+    Base64 _base64;        /**< Base64-Objekt zum Kodieren */
+};
+
+/*****************************************************************************/
+
+template <class T>
+CompressionT_XOR<T>::CompressionT_XOR()
+{
+}
+
+/*****************************************************************************/
+
+template <class T>
+CompressionT_XOR<T>::~CompressionT_XOR()
+{
+    free();
+}
+
+/*****************************************************************************/
+
+template <class T>
+void CompressionT_XOR<T>::free()
+{
+    _xor.free();
+    _base64.free();
+}
+
+/*****************************************************************************/
+
+template <class T>
+void CompressionT_XOR<T>::compress(const T *input,
+                                     unsigned int length)
+{
+    stringstream err;
+
+    try
+    {
+        _xor.encode(input, length);
+        if (this->_encode_base64) {
+            _base64.encode(_xor.encode_output(),
+                           _xor.encode_output_size());
+        }
+    }
+    catch (EBase64 &e)
+    {
+        err << "Base64: " << e.msg;
+        throw ECompression(err.str());
+    }
+    catch (...)
+    {
+        throw ECompression("XOR: Could not allocate memory!");
+    }
+}
+
+/*****************************************************************************/
+
+template <class T>
+void CompressionT_XOR<T>::uncompress(const char *input,
+                                       unsigned int size,
+                                       unsigned int length)
+{
+    stringstream err;
+
+    try
+    {
+        if (this->_encode_base64) {
+            _base64.decode(input, size);
+            input = _base64.output();
+            size = _base64.output_size();
+        }
+        _xor.decode(input, size, length);
+    }
+    catch (EBase64 &e)
+    {
+        err << "While Base64-decoding: " << e.msg << endl;
+        throw ECompression(err.str());
+    }
+    catch (EXor &e)
+    {
+        err << "While XOR-decoding: " << e.msg << endl;
+        throw ECompression(err.str());
+    }
+    catch (EBitStream &e)
+    {
+        err << "While XOR-decoding: " << e.msg << endl;
+        throw ECompression(err.str());
+    }
+    catch (...)
+    {
+        throw ECompression("While XOR-decoding:"
+                           " Could not allocate memory!");
+    }
+}
+
+/*****************************************************************************/
+
+template <class T>
+void CompressionT_XOR<T>::clear()
+{
+}
+
+/*****************************************************************************/
+
+template <class T>
+void CompressionT_XOR<T>::flush_compress()
+{
+    free();
+}
+
+/*****************************************************************************/
+
+template <class T>
+void CompressionT_XOR<T>::flush_uncompress(const char *input,
+                                             unsigned int size)
+{
+    free();
+}
+
+/*****************************************************************************/
+
+template<class T>
+const char *CompressionT_XOR<T>::compression_output() const
+{
+    return this->_encode_base64 ?
+        _base64.output() : _xor.encode_output();
+}
+
+/*****************************************************************************/
+
+template<class T>
+unsigned int CompressionT_XOR<T>::compressed_size() const
+{
+    return this->_encode_base64 ?
+        _base64.output_size() : _xor.encode_output_size();
+}
+
+/*****************************************************************************/
+
+template<class T>
+const T *CompressionT_XOR<T>::decompression_output() const
+{
+    return _xor.decode_output();
+}
+
+/*****************************************************************************/
+
+template<class T>
+unsigned int CompressionT_XOR<T>::decompressed_length() const
+{
+    return _xor.decode_output_length();
+}
+
+/*****************************************************************************/
+//
+//  ZStd / Base64
+//
+/*****************************************************************************/
+
+/**
+   Kompressionsobjekt: Erst Zstandard, dann Base64
+
+   Die Kompressionsstufe und das optionale Wrterbuch werden
+   im Konstruktor angegeben.
+*/
+
+template <class T>
+class CompressionT_ZStd : public CompressionT<T>
+{
+public:
+    CompressionT_ZStd(int = 0, const string & = string());
+    ~CompressionT_ZStd();
+
+    void compress(const T *input,
+                  unsigned int length);
+    void uncompress(const char *input,
+                    unsigned int size,
+                    unsigned int length);
+    void clear();
+    void flush_compress();
+    void flush_uncompress(const char *input,
+                          unsigned int size);
+
+    void free();
+
+    const char *compression_output() const;
+    unsigned int compressed_size() const;
+    const T *decompression_output() const;
+    unsigned int decompressed_length() const;
+
+private:
+    ZStd _zstd;            /**< ZStd-Objekt zum Komprimieren */
+    Base64 _base64;        /**< Base64-Objekt zum Kodieren */
+};
+
+/*****************************************************************************/
+
+template <class T>
+CompressionT_ZStd<T>::CompressionT_ZStd(
+        int level, /**< Kompressionsstufe (0: Vorgabe der Bibliothek) */
+        const string &dictionary /**< Inhalt des Wrterbuchs oder leer */
+        )
+{
+    _zstd.set_level(level);
+    _zstd.set_dictionary(dictionary);
+}
+
+/*****************************************************************************/
+
+template <class T>
+CompressionT_ZStd<T>::~CompressionT_ZStd()
+{
+    free();
+}
+
+/*****************************************************************************/
+
+template <class T>
+void CompressionT_ZStd<T>::free()
+{
+    _zstd.free();
+    _base64.free();
+}
+
+/*****************************************************************************/
+
+template <class T>
+void CompressionT_ZStd<T>::compress(const T *input,
+                                       unsigned int length)
+{
+    stringstream err;
+
+    try
+    {
+        _zstd.compress((char *) input, length * sizeof(T));
+        if (this->_encode_base64) {
+            _base64.encode(_zstd.output(), _zstd.output_size());
+        }
+    }
+    catch (EZStd &e)
+    {
+        err << "ZStd: " << e.msg;
+        throw ECompression(err.str());
+    }
+    catch (EBase64 &e)
+    {
+        err << "Base64: " << e.msg;
+        throw ECompression(err.str());
+    }
+}
+
+/*****************************************************************************/
+
+template <class T>
+void CompressionT_ZStd<T>::uncompress(const char *input,
+                                         unsigned int size,
+                                         unsigned int length)
+{
+    stringstream err;
+
+    try
+    {
+        if (this->_encode_base64) {
+            _base64.decode(input, size);
+            input = _base64.output();
+            size = _base64.output_size();
+        }
+        _zstd.uncompress(input, size, length * sizeof(T));
+    }
+    catch (EBase64 &e)
+    {
+        err << "While Base64-decoding: " << e.msg << endl;
+        throw ECompression(err.str());
+    }
+    catch (EZStd &e)
+    {
+        err << "While ZStd-uncompressing: " << e.msg << endl;
+        throw ECompression(err.str());
+    }
+
+    if (_zstd.output_size() != length * sizeof(T))
+    {
+        err << "ZStd output does not have expected size: ";
+        err << _zstd.output_size() << " / " << length * sizeof(T);
+        throw ECompression(err.str());
+    }
+}
+
+/*****************************************************************************/
+
+template <class T>
+void CompressionT_ZStd<T>::clear()
+{
+}
+
+/*****************************************************************************/
+
+template <class T>
+void CompressionT_ZStd<T>::flush_compress()
+{
+    free();
+}
+
+/*****************************************************************************/
+
+template <class T>
+void CompressionT_ZStd<T>::flush_uncompress(const char *input,
+                                               unsigned int size)
+{
+    free();
+}
+
+/*****************************************************************************/
+
+template<class T>
+const char *CompressionT_ZStd<T>::compression_output() const
+{
+    return this->_encode_base64 ? _base64.output() : _zstd.output();
+}
+
+/*****************************************************************************/
+
+template<class T>
+unsigned int CompressionT_ZStd<T>::compressed_size() const
+{
+    return this->_encode_base64 ?
+        _base64.output_size() : _zstd.output_size();
+}
+
+/*****************************************************************************/
+
+template<class T>
+const T *CompressionT_ZStd<T>::decompression_output() const
+{
+    return (T *) _zstd.output();
+}
+
+/*****************************************************************************/
+
+template<class T>
+unsigned int CompressionT_ZStd<T>::decompressed_length() const
+{
+    return _zstd.output_size() / sizeof(T);
+}
+
 /*****************************************************************************/
 
 #ifdef DEBUG
@@ -17,6 +17,9 @@
  *
  *****************************************************************************/
 
+#include <stdint.h>
+#include <string.h>
+
 #include <iostream>
 #include <sstream>
 using namespace std;
@@ -24,15 +27,246 @@ using namespace std;
 #include "LibDLS/Data.h"
 using namespace LibDLS;
 
+#include "ZLib.h"
+#include "CompressionT.h"
+
 #include "proto/dls.pb.h"
 
 /*****************************************************************************/
 
+/** Swaps bytes on big endian hosts, so that raw values are little endian.
+ */
+static inline void to_little_endian(char *value, size_t size)
+{
+    const uint16_t test = 1;
+
+    if (*(const char *) &test) {
+        return; // little endian host
+    }
+
+    for (size_t i = 0; i < size / 2; i++) {
+        char tmp = value[i];
+        value[i] = value[size - 1 - i];
+        value[size - 1 - i] = tmp;
+    }
+}
+
+/*****************************************************************************/
+
+/** Encodes values as raw little endian bytes of type T.
+ */
+template <class T>
+static void encode_raw(string &raw, const vector<double> &data)
+{
+    raw.resize(data.size() * sizeof(T));
+
+    for (size_t i = 0; i < data.size(); i++) {
+        T value = (T) data[i];
+        char *dst = &raw[i * sizeof(T)];
+        memcpy(dst, &value, sizeof(T));
+        to_little_endian(dst, sizeof(T));
+    }
+}
+
+/*****************************************************************************/
+
+/** Decodes raw little endian bytes of type T.
+ */
+template <class T>
+static void decode_raw(vector<double> &data, const char *raw, size_t size)
+{
+    size_t count = size / sizeof(T);
+    char buf[sizeof(T)];
+    T value;
+
+    data.reserve(count);
+
+    for (size_t i = 0; i < count; i++) {
+        memcpy(buf, raw + i * sizeof(T), sizeof(T));
+        to_little_endian(buf, sizeof(T));
+        memcpy(&value, buf, sizeof(T));
+        data.push_back((double) value);
+    }
+}
+
+/*****************************************************************************/
+
+/** Encodes values as raw bytes of the given channel type.
+ *
+ * \return false, if the type is unknown.
+ */
+static bool encode_raw_type(string &raw, const vector<double> &data,
+        ChannelType type)
+{
+    switch (type) {
+        case TCHAR: encode_raw<int8_t>(raw, data); break;
+        case TUCHAR: encode_raw<uint8_t>(raw, data); break;
+        case TSHORT: encode_raw<int16_t>(raw, data); break;
+        case TUSHORT: encode_raw<uint16_t>(raw, data); break;
+        case TINT: encode_raw<int32_t>(raw, data); break;
+        case TUINT: encode_raw<uint32_t>(raw, data); break;
+        case TLINT: encode_raw<int64_t>(raw, data); break;
+        case TULINT: encode_raw<uint64_t>(raw, data); break;
+        case TFLT: encode_raw<float>(raw, data); break;
+        case TDBL: encode_raw<double>(raw, data); break;
+        default: return false;
+    }
+
+    return true;
+}
+
+/*****************************************************************************/
+
+/** Decodes raw bytes of the given channel type.
+ *
+ * \return false, if the type is unknown.
+ */
+static bool decode_raw_type(vector<double> &data, const char *raw,
+        size_t size, ChannelType type)
+{
+    switch (type) {
+        case TCHAR: decode_raw<int8_t>(data, raw, size); break;
+        case TUCHAR: decode_raw<uint8_t>(data, raw, size); break;
+        case TSHORT: decode_raw<int16_t>(data, raw, size); break;
+        case TUSHORT: decode_raw<uint16_t>(data, raw, size); break;
+        case TINT: decode_raw<int32_t>(data, raw, size); break;
+        case TUINT: decode_raw<uint32_t>(data, raw, size); break;
+        case TLINT: decode_raw<int64_t>(data, raw, size); break;
+        case TULINT: decode_raw<uint64_t>(data, raw, size); break;
+        case TFLT: decode_raw<float>(data, raw, size); break;
+        case TDBL: decode_raw<double>(data, raw, size); break;
+        default: return false;
+    }
+
+    return true;
+}
+
+/*****************************************************************************/
+
+/** Uncompresses a stored block with the given compression object.
+ */
+template <class T>
+static void uncompress_block(vector<double> &data, CompressionT<T> *comp,
+        bool base64, const string &block, unsigned int length)
+{
+    comp->set_base64(base64);
+
+    try {
+        comp->uncompress(block.data(), block.size(), length);
+    }
+    catch (ECompression &e) {
+        delete comp;
+        throw;
+    }
+
+    const T *output = comp->decompression_output();
+    data.reserve(comp->decompressed_length());
+    for (unsigned int i = 0; i < comp->decompressed_length(); i++) {
+        data.push_back((double) output[i]);
+    }
+
+    delete comp;
+}
+
+/*****************************************************************************/
+
+/** Uncompresses a stored block of the given format and channel type.
+ *
+ * \return false, if the format or type is not supported.
+ */
+template <class T>
+static bool uncompress_block_type(vector<double> &data, int format,
+        bool base64, const string &block, unsigned int length)
+{
+    CompressionT<T> *comp;
+
+    switch (format) {
+        case FORMAT_ZLIB: comp = new CompressionT_ZLib<T>(); break;
+        case FORMAT_DELTA: comp = new CompressionT_Delta<T>(); break;
+        default: return false;
+    }
+
+    uncompress_block(data, comp, base64, block, length);
+    return true;
+}
+
+template <>
+bool uncompress_block_type<float>(vector<double> &data, int format,
+        bool base64, const string &block, unsigned int length)
+{
+    CompressionT<float> *comp;
+
+    switch (format) {
+        case FORMAT_ZLIB: comp = new CompressionT_ZLib<float>(); break;
+        case FORMAT_QUANT: comp = new CompressionT_Quant<float>(0.0); break;
+        case FORMAT_XOR: comp = new CompressionT_XOR<float>(); break;
+        default: return false;
+    }
+
+    uncompress_block(data, comp, base64, block, length);
+    return true;
+}
+
+template <>
+bool uncompress_block_type<double>(vector<double> &data, int format,
+        bool base64, const string &block, unsigned int length)
+{
+    CompressionT<double> *comp;
+
+    switch (format) {
+        case FORMAT_ZLIB: comp = new CompressionT_ZLib<double>(); break;
+        case FORMAT_QUANT: comp = new CompressionT_Quant<double>(0.0); break;
+        case FORMAT_XOR: comp = new CompressionT_XOR<double>(); break;
+        default: return false;
+    }
+
+    uncompress_block(data, comp, base64, block, length);
+    return true;
+}
+
+/*****************************************************************************/
+
+/** Uncompresses a stored block of the given channel type.
+ *
+ * Stored blocks contain the values in the host representation of the
+ * channel type, so TLINT and TULINT blocks are never passed undecoded.
+ *
+ * \return false, if the format or type is not supported.
+ */
+static bool uncompress_block_any(vector<double> &data, ChannelType type,
+        int format, bool base64, const string &block, unsigned int length)
+{
+    switch (type) {
+        case TCHAR: return uncompress_block_type<char>(
+                            data, format, base64, block, length);
+        case TUCHAR: return uncompress_block_type<unsigned char>(
+                            data, format, base64, block, length);
+        case TSHORT: return uncompress_block_type<short>(
+                            data, format, base64, block, length);
+        case TUSHORT: return uncompress_block_type<unsigned short>(
+                            data, format, base64, block, length);
+        case TINT: return uncompress_block_type<int>(
+                            data, format, base64, block, length);
+        case TUINT: return uncompress_block_type<unsigned int>(
+                            data, format, base64, block, length);
+        case TFLT: return uncompress_block_type<float>(
+                            data, format, base64, block, length);
+        case TDBL: return uncompress_block_type<double>(
+                            data, format, base64, block, length);
+        default: return false;
+    }
+}
+
+/*****************************************************************************/
+
 /**
    Konstruktor
 */
 
-Data::Data()
+Data::Data():
+    _block_length(0),
+    _block_format(FORMAT_INVALID),
+    _block_base64(false)
 {
 }
 
@@ -47,22 +281,86 @@ Data::Data(const Data &o)
     _meta_type = o._meta_type;
     _meta_level = o._meta_level;
     _data = o._data;
+    _block = o._block;
+    _block_length = o._block_length;
+    _block_format = o._block_format;
+    _block_base64 = o._block_base64;
 }
 
 /*****************************************************************************/
 
 /** Constructor from protocol message.
+ *
+ * Decodes the values of any of the encodings in Data::Encoding.
 */
-Data::Data(const DlsProto::Data &d)
+Data::Data(const DlsProto::Data &d):
+    _block_length(0),
+    _block_format(FORMAT_INVALID),
+    _block_base64(false)
 {
     _start_time = d.start_time();
     _time_per_value = d.time_per_value();
     _meta_type = (MetaType) d.meta_type();
     _meta_level = d.meta_level();
 
+    if (d.has_block()) {
+        try {
+            if (!uncompress_block_any(_data, (ChannelType) d.raw_type(),
+                        d.block_format(), d.block_base64(), d.block(),
+                        d.block_length())) {
+                stringstream err;
+                err << "ERROR: Unsupported block format " << d.block_format()
+                    << " for data type " << d.raw_type() << "!";
+                log(err.str());
+            }
+        }
+        catch (ECompression &e) {
+            stringstream err;
+            err << "ERROR: Failed to uncompress data block: " << e.msg;
+            log(err.str());
+            _data.clear();
+        }
+        return;
+    }
+
+    if (d.has_raw_value()) {
+        const string &raw = d.raw_value();
+        ZLib zlib;
+        const char *raw_data = raw.data();
+        size_t raw_size = raw.size();
+
+        if (d.has_raw_size()) {
+            try {
+                zlib.uncompress(raw.data(), raw.size(), d.raw_size());
+            }
+            catch (EZLib &e) {
+                stringstream err;
+                err << "ERROR: Failed to uncompress data: " << e.msg;
+                log(err.str());
+                return;
+            }
+            raw_data = zlib.output();
+            raw_size = zlib.output_size();
+        }
+
+        if (!decode_raw_type(_data, raw_data, raw_size,
+                    (ChannelType) d.raw_type())) {
+            stringstream err;
+            err << "ERROR: Unknown raw data type " << d.raw_type() << "!";
+            log(err.str());
+        }
+        return;
+    }
+
+    _data.reserve(d.value_size() + d.packed_value_size());
+
     for (int i = 0; i < d.value_size(); i++) {
         _data.push_back(d.value(i));
     }
+
+    for (int i = 0; i < d.packed_value_size(); i++) {
+        _data.push_back(d.packed_value(i));
+    }
 }
 
 /*****************************************************************************/
@@ -99,6 +397,160 @@ void Data::push_back(const Data &other)
 
 /*****************************************************************************/
 
+/** Stores a compressed block as read from a data file.
+ *
+ * The block is not decoded; it can only be forwarded with
+ * set_data_msg() using CompressedBlocks. Only stateless formats (ZLib,
+ * quantization and delta coding) are allowed.
+ */
+void Data::import_block(
+        Time time, /**< Start time. */
+        Time tpv, /**< Time per value. */
+        MetaType meta_type, /**< Meta type. */
+        unsigned int meta_level, /**< Meta level. */
+        int format, /**< Compression format (FORMAT_*). */
+        bool base64, /**< Block is Base64-encoded. */
+        const char *block, /**< Block data. */
+        unsigned int size, /**< Block data size in bytes. */
+        unsigned int length /**< Number of values in the block. */
+        )
+{
+    _start_time = time;
+    _time_per_value = tpv;
+    _meta_type = meta_type;
+    _meta_level = meta_level;
+    _data.clear();
+    _block.assign(block, size);
+    _block_length = length;
+    _block_format = format;
+    _block_base64 = base64;
+}
+
+/*****************************************************************************/
+
+/** Decodes a compressed block imported with import_block().
+ *
+ * Afterwards, the values are available as for imported data. The method
+ * does not log and can be called from worker threads.
+ *
+ * \throw DataException The block could not be decoded. The data are empty
+ *                      afterwards.
+ */
+void Data::decode_block(
+        ChannelType type /**< Channel type. */
+        )
+{
+    if (!has_block()) {
+        return;
+    }
+
+    stringstream err;
+
+    try {
+        if (!uncompress_block_any(_data, type, _block_format,
+                    _block_base64, _block, _block_length)) {
+            err << "Unsupported block format " << _block_format
+                << " for data type " << type << "!";
+        }
+    }
+    catch (ECompression &e) {
+        err << "Failed to uncompress data block: " << e.msg;
+        _data.clear();
+    }
+
+    _block.clear();
+    _block_length = 0;
+
+    if (!err.str().empty()) {
+        throw DataException(err.str());
+    }
+}
+
+/*****************************************************************************/
+
+/** Stores the data block in a protocol message.
+ *
+ * If the channel type is unknown, raw encodings fall back to packed
+ * doubles. Compressed blocks can only be sent with CompressedBlocks.
+ */
+void Data::set_data_msg(
+        DlsProto::Data *msg, /**< Protocol message. */
+        Encoding encoding, /**< Value encoding. */
+        ChannelType type /**< Channel type for raw encodings. */
+        ) const
+{
+    string raw;
+
+    msg->set_start_time(_start_time.to_int64());
+    msg->set_time_per_value(_time_per_value.to_int64());
+    msg->set_meta_type((DlsProto::MetaType) _meta_type);
+    msg->set_meta_level(_meta_level);
+
+    if (has_block()) {
+        if (encoding == CompressedBlocks) {
+            msg->set_raw_type((DlsProto::ChannelType) type);
+            msg->set_block(_block);
+            msg->set_block_length(_block_length);
+            msg->set_block_format(_block_format);
+            msg->set_block_base64(_block_base64);
+        }
+        else {
+            stringstream err;
+            err << "ERROR: Compressed data block can not be encoded!";
+            log(err.str());
+        }
+        return;
+    }
+
+    if (encoding == CompressedBlocks) {
+        encoding = RawValues;
+    }
+
+    if ((encoding == RawValues || encoding == CompressedRawValues)
+            && !encode_raw_type(raw, _data, type)) {
+        encoding = PackedValues;
+    }
+
+    switch (encoding) {
+        case PackedValues:
+            msg->mutable_packed_value()->Reserve(_data.size());
+            for (size_t i = 0; i < _data.size(); i++) {
+                msg->add_packed_value(_data[i]);
+            }
+            break;
+
+        case CompressedRawValues:
+            if (!raw.empty()) {
+                ZLib zlib;
+
+                try {
+                    zlib.compress(raw.data(), raw.size());
+                    msg->set_raw_type((DlsProto::ChannelType) type);
+                    msg->set_raw_value(zlib.output(), zlib.output_size());
+                    msg->set_raw_size(raw.size());
+                    break;
+                }
+                catch (EZLib &e) {
+                    // send uncompressed
+                }
+            }
+            // fall through
+
+        case RawValues:
+            msg->set_raw_type((DlsProto::ChannelType) type);
+            msg->set_raw_value(raw);
+            break;
+
+        default:
+            for (size_t i = 0; i < _data.size(); i++) {
+                msg->add_value(_data[i]);
+            }
+            break;
+    }
+}
+
+/*****************************************************************************/
+
 int Data::calc_min_max(double *min, double *max) const
 {
     vector<double>::const_iterator data_i;
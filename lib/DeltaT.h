@@ -0,0 +1,378 @@
+/******************************************************************************
+ *
+ *  This file is part of the Data Logging Service (DLS).
+ *
+ *  DLS is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  DLS is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with DLS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef LibDLSDeltaTH
+#define LibDLSDeltaTH
+
+/*****************************************************************************/
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "LibDLS/globals.h"
+#include "LibDLS/Exception.h"
+
+#include "BitStream.h"
+
+/*****************************************************************************/
+
+namespace LibDLS {
+
+/*****************************************************************************/
+
+enum {
+    DELTA_FRAME_LENGTH = 128 /**< Number of values per frame. */
+};
+
+/*****************************************************************************/
+
+/**
+   Exception of a DeltaT object
+*/
+
+class EDelta : public Exception
+{
+public:
+    EDelta(const std::string &pmsg) : Exception(pmsg) {};
+};
+
+/*****************************************************************************/
+
+/** Lossless delta coding for integer values.
+ *
+ * The first value of a block is stored with 64 bits. The remaining values
+ * are split into frames of DELTA_FRAME_LENGTH values, each starting at a
+ * byte boundary:
+ *
+ * - Header byte: Bit 7 selects the prediction (0: difference to the
+ *   previous value, 1: difference to the previous difference, suitable for
+ *   counters and ramps), bits 0 to 6 contain the bit width of the packed
+ *   residuals.
+ * - Number of exceptions (one byte), followed by the bit width of the
+ *   exceptions, if there are any.
+ * - The lower bits of all zigzag-coded residuals, packed LSB first.
+ * - For every exception: Value index (7 bits) and the upper bits of the
+ *   residual.
+ *
+ * Differences are calculated modulo the range of the value type, so that
+ * overflows do not widen the residuals. The encoder chooses the prediction
+ * and bit width with the smallest frame size. Constant and linearly
+ * rising signals thus need two bytes per frame, a single step costs a
+ * few bits more.
+ */
+template <class T>
+class DeltaT
+{
+public:
+    DeltaT(): _encode_size(0), _decode_length(0) {};
+
+    void encode(const T *, unsigned int);
+    void decode(const char *, unsigned int, unsigned int);
+
+    const char *encode_output() const {
+        return _encode_output.empty() ? 0 : &_encode_output[0];
+    }
+    unsigned int encode_output_size() const { return _encode_size; }
+    const T *decode_output() const {
+        return _decode_output.empty() ? 0 : &_decode_output[0];
+    }
+    unsigned int decode_output_length() const { return _decode_length; }
+
+    void free();
+
+private:
+    std::vector<char> _encode_output; /**< Encoded data. */
+    unsigned int _encode_size; /**< Number of bytes in _encode_output. */
+    std::vector<T> _decode_output; /**< Decoded values. */
+    unsigned int _decode_length; /**< Number of values in
+                                   _decode_output. */
+
+    /** Sign-extends a difference from the width of the value type. */
+    static uint64_t _wrap(uint64_t v) {
+        const unsigned int shift = 64 - 8 * sizeof(T);
+        return shift ? (uint64_t) ((int64_t) (v << shift) >> shift) : v;
+    }
+    static uint64_t _zigzag(uint64_t v) {
+        return (v << 1) ^ (uint64_t) ((int64_t) v >> 63);
+    }
+    static uint64_t _unzigzag(uint64_t z) {
+        return (z >> 1) ^ (uint64_t) -(int64_t) (z & 1);
+    }
+    static unsigned int _width(uint64_t);
+    static unsigned int _plan(const uint64_t *, unsigned int,
+            unsigned int *, unsigned int *);
+};
+
+/*****************************************************************************/
+
+/** Releases the output buffers.
+ */
+template <class T>
+void DeltaT<T>::free()
+{
+    std::vector<char>().swap(_encode_output);
+    _encode_size = 0;
+    std::vector<T>().swap(_decode_output);
+    _decode_length = 0;
+}
+
+/*****************************************************************************/
+
+/** Number of significant bits.
+ */
+template <class T>
+unsigned int DeltaT<T>::_width(uint64_t v)
+{
+#ifdef __GNUC__
+    return v ? 64 - __builtin_clzll(v) : 0;
+#else
+    unsigned int width = 0;
+
+    while (v) {
+        v >>= 1;
+        width++;
+    }
+
+    return width;
+#endif
+}
+
+/*****************************************************************************/
+
+/** Chooses the bit width for a frame of residuals.
+ *
+ * \return Size of the packed residuals in bits.
+ */
+template <class T>
+unsigned int DeltaT<T>::_plan(
+        const uint64_t *res, /**< Zigzag-coded residuals. */
+        unsigned int count, /**< Number of residuals. */
+        unsigned int *width, /**< Chosen bit width. */
+        unsigned int *exc_width /**< Bit width of the exceptions. */
+        )
+{
+    unsigned int hist[65] = {0}, max_width = 0, above = 0, cost, best, i;
+
+    for (i = 0; i < count; i++) {
+        hist[_width(res[i])]++;
+    }
+
+    for (i = 64; i > 0 && !hist[i]; i--);
+    max_width = i;
+
+    // without exceptions
+    best = count * max_width;
+    *width = max_width;
+
+    // fewer bits for all values, the rest as exceptions
+    for (i = max_width; i > 0; i--) {
+        above += hist[i];
+        cost = count * (i - 1) + above * (7 + max_width - (i - 1));
+        if (cost < best) {
+            best = cost;
+            *width = i - 1;
+        }
+    }
+
+    *exc_width = max_width - *width;
+    return best;
+}
+
+/*****************************************************************************/
+
+/** Encodes an array of values.
+ *
+ * The output buffer is kept for further calls until free() is called.
+ */
+template <class T>
+void DeltaT<T>::encode(
+        const T *input, /**< Values. */
+        unsigned int length /**< Number of values. */
+        )
+{
+    uint64_t res[2][DELTA_FRAME_LENGTH];
+    uint64_t prev, prev_diff, value, diff, *r;
+    unsigned int i, j, count, order, width[2], exc_width[2], exc;
+
+    _encode_size = 0;
+
+    if (!length) {
+        return;
+    }
+
+    // worst case: first value, three header bytes and 64 bits per value
+    _encode_output.resize(8 + 3 * (length / DELTA_FRAME_LENGTH + 1)
+            + 8 * (size_t) length);
+
+    BitPacker writer(&_encode_output[0]);
+
+    prev = (uint64_t) (int64_t) input[0];
+    prev_diff = 0;
+    writer.write(prev, 64);
+
+    for (i = 1; i < length; i += count) {
+        count = length - i;
+        if (count > DELTA_FRAME_LENGTH) {
+            count = DELTA_FRAME_LENGTH;
+        }
+
+        for (j = 0; j < count; j++) {
+            value = (uint64_t) (int64_t) input[i + j];
+            diff = _wrap(value - prev);
+            res[0][j] = _zigzag(diff);
+            res[1][j] = _zigzag(_wrap(diff - prev_diff));
+            prev = value;
+            prev_diff = diff;
+        }
+
+        order = _plan(res[1], count, &width[1], &exc_width[1])
+            < _plan(res[0], count, &width[0], &exc_width[0]);
+        r = res[order];
+
+        exc = 0;
+        if (exc_width[order]) {
+            for (j = 0; j < count; j++) {
+                if (r[j] >> width[order]) {
+                    exc++;
+                }
+            }
+        }
+
+        writer.write(order << 7 | width[order], 8);
+        writer.write(exc, 8);
+        if (exc) {
+            writer.write(exc_width[order], 8);
+        }
+
+        for (j = 0; j < count; j++) {
+            writer.write(width[order] < 64 ?
+                    r[j] & ((((uint64_t) 1) << width[order]) - 1) : r[j],
+                    width[order]);
+        }
+
+        if (exc) {
+            for (j = 0; j < count; j++) {
+                if (r[j] >> width[order]) {
+                    writer.write(j, 7);
+                    writer.write(r[j] >> width[order], exc_width[order]);
+                }
+            }
+        }
+
+        // frames start at byte boundaries
+        writer.finish();
+    }
+
+    _encode_size = writer.finish();
+}
+
+/*****************************************************************************/
+
+/** Decodes data created by encode().
+ *
+ * The output buffer is kept for further calls until free() is called.
+ *
+ * \throw EDelta Invalid data.
+ * \throw EBitStream Truncated data.
+ */
+template <class T>
+void DeltaT<T>::decode(
+        const char *input, /**< Encoded data. */
+        unsigned int size, /**< Size of the encoded data in bytes. */
+        unsigned int length /**< Expected number of values. */
+        )
+{
+    uint64_t res[DELTA_FRAME_LENGTH];
+    uint64_t prev, prev_diff, diff;
+    unsigned int i, j, count, header, width, exc, exc_width, index;
+    BitUnpacker reader(input, size);
+
+    _decode_length = 0;
+
+    if (!length) {
+        return;
+    }
+
+    if (_decode_output.size() < length) {
+        _decode_output.resize(length);
+    }
+
+    prev = reader.read(64);
+    prev_diff = 0;
+    _decode_output[0] = (T) prev;
+
+    for (i = 1; i < length; i += count) {
+        count = length - i;
+        if (count > DELTA_FRAME_LENGTH) {
+            count = DELTA_FRAME_LENGTH;
+        }
+
+        header = reader.read(8);
+        width = header & 0x7f;
+        exc = reader.read(8);
+        exc_width = exc ? reader.read(8) : 0;
+        if (width + exc_width > 64 || (exc && !exc_width)
+                || exc > count) {
+            throw EDelta("Invalid frame header!");
+        }
+
+        for (j = 0; j < count; j++) {
+            res[j] = reader.read(width);
+        }
+
+        for (j = 0; j < exc; j++) {
+            index = reader.read(7);
+            if (index >= count) {
+                throw EDelta("Invalid exception index!");
+            }
+            res[index] |= reader.read(exc_width) << width;
+        }
+
+        if (header & 0x80) {
+            for (j = 0; j < count; j++) {
+                diff = _wrap(prev_diff + _unzigzag(res[j]));
+                prev += diff;
+                prev_diff = diff;
+                _decode_output[i + j] = (T) prev;
+            }
+        }
+        else {
+            for (j = 0; j < count; j++) {
+                diff = _wrap(_unzigzag(res[j]));
+                prev += diff;
+                prev_diff = diff;
+                _decode_output[i + j] = (T) prev;
+            }
+        }
+
+        reader.align();
+    }
+
+    _decode_length = length;
+}
+
+/*****************************************************************************/
+
+} // namespace
+
+/*****************************************************************************/
+
+#endif
@@ -27,10 +27,12 @@
 #include <ws2tcpip.h>
 #else
 #include <sys/socket.h>
+#include <sys/select.h>
 #include <netdb.h>
 #endif
 
 #include <unistd.h>
+#include <string.h>
 #include <errno.h>
 
 #include <google/protobuf/io/coded_stream.h>
@@ -56,6 +58,10 @@ using namespace LibDLS;
 #define DLS_CLOSE_SOCKET ::close
 #endif
 
+/** Minimum free space in the receive buffer for each recv() call.
+ */
+#define DLS_RECEIVE_CHUNK_SIZE (64 * 1024)
+
 /*****************************************************************************/
 
 void MyLogHandler(google::protobuf::LogLevel level,
@@ -72,8 +78,12 @@ void MyLogHandler(google::protobuf::LogLevel level,
 Directory::Directory(const std::string &uri_text):
     _access(Unknown),
     _sock(DLS_INVALID_SOCKET),
+    _receive_start(0),
+    _receive_end(0),
     _protocol_version(0),
-    _proto_messages_warning_given(false)
+    _proto_messages_warning_given(false),
+    _data_encoding(Data::CompressedBlocks),
+    _decoder_threads(1)
 {
     set_uri(uri_text);
 
@@ -377,7 +387,7 @@ void Directory::_importNetwork()
     dir_req->set_path(_path);
 
     _send_message(req);
-    _receive_message(res);
+    _receive_response(res);
 
     if (res.has_error()) {
         _error_msg = res.error().message();
@@ -499,6 +509,9 @@ void Directory::_disconnect()
     _protocol_version = 0;
     _proto_messages_warning_given = false;
     _receive_buffer.clear();
+    _receive_start = 0;
+    _receive_end = 0;
+    _live_subscribers.clear(); // ended by the server
 }
 
 /*****************************************************************************/
@@ -566,22 +579,44 @@ void Directory::_send_message(const DlsProto::Request &req)
 
 /*****************************************************************************/
 
+/** Receives data from the socket directly into the receive buffer.
+ *
+ * Unprocessed data are only moved to the front of the buffer, if there is
+ * not enough space left behind them, so that large responses are received
+ * without copying each message.
+ */
 void Directory::_receive_data()
 {
 #ifdef DEBUG_STREAM
     cerr << __func__ << "()" << endl;
 #endif
 
+    if (_receive_buffer.size() - _receive_end < DLS_RECEIVE_CHUNK_SIZE) {
+        if (_receive_start > 0) {
+            size_t length = _receive_end - _receive_start;
+            if (length) {
+                memmove(&_receive_buffer[0],
+                        &_receive_buffer[_receive_start], length);
+            }
+            _receive_start = 0;
+            _receive_end = length;
+        }
+
+        if (_receive_buffer.size() - _receive_end < DLS_RECEIVE_CHUNK_SIZE) {
+            _receive_buffer.resize(_receive_end + DLS_RECEIVE_CHUNK_SIZE);
+        }
+    }
+
     ssize_t ret;
-    char data[1024];
-    ret = recv(_sock, data, sizeof(data), 0);
+    ret = recv(_sock, &_receive_buffer[_receive_end],
+            _receive_buffer.size() - _receive_end, 0);
 
 #ifdef DEBUG_STREAM
     cerr << "recv() returned " << ret << endl;
 #endif
 
     if (ret > 0) {
-        _receive_buffer += string(data, ret);
+        _receive_end += ret;
     }
     else if (ret == 0) {
         stringstream err;
@@ -611,52 +646,56 @@ void Directory::_receive_message(
         bool debug
         )
 {
-    if (_receive_buffer.empty()) {
+    if (_receive_start == _receive_end) {
         _receive_data();
     }
 
     unsigned int messageSize = 0;
+    size_t varIntSize;
 
     while (1) {
         google::protobuf::io::CodedInputStream
-            ci((const google::protobuf::uint8 *) _receive_buffer.c_str(),
-                    _receive_buffer.size());
+            ci((const google::protobuf::uint8 *)
+                    &_receive_buffer[_receive_start],
+                    _receive_end - _receive_start);
         if (ci.ReadVarint32(&messageSize)) {
+            varIntSize = ci.CurrentPosition();
             break;
         }
 
         // try to fetch more data to complete varint
 #ifdef DEBUG_STREAM
-        cerr << "Varint32 incomplete (" << _receive_buffer.size()
+        cerr << "Varint32 incomplete (" << _receive_end - _receive_start
             << " bytes). Fetching more data... " << endl;
 #endif
         _receive_data();
     }
 
-    int varIntSize =
-        google::protobuf::io::CodedOutputStream::VarintSize32(
-                messageSize);
-    _receive_buffer.erase(0, varIntSize);
-
-    while ((unsigned int) _receive_buffer.size() < messageSize) {
+    while (_receive_end - _receive_start < varIntSize + messageSize) {
         _receive_data();
     }
 
-    bool success = msg.ParseFromArray(_receive_buffer.c_str(), messageSize);
+    // parse in place
+    bool success = msg.ParseFromArray(
+            &_receive_buffer[_receive_start + varIntSize], messageSize);
     if (!success) {
         stringstream err;
-        err << "ParseFromArray(" << _receive_buffer.size()
+        err << "ParseFromArray(" << _receive_end - _receive_start
             << " / " << messageSize << ") failed!";
         log(err.str());
         _disconnect();
         throw DirectoryException(err.str());
     }
 
-    _receive_buffer.erase(0, messageSize);
+    _receive_start += varIntSize + messageSize;
+    if (_receive_start == _receive_end) {
+        _receive_start = 0;
+        _receive_end = 0;
+    }
 
 #ifdef DLS_PROTO_DEBUG
     cerr << "Received message with " << messageSize << " bytes. "
-        << _receive_buffer.size() << " remaining. " << endl;
+        << _receive_end - _receive_start << " remaining. " << endl;
     if (debug) {
         cerr << msg.DebugString() << endl;
     }
@@ -665,6 +704,122 @@ void Directory::_receive_message(
 
 /*****************************************************************************/
 
+/** Receives the response to a request.
+ *
+ * Live data pushed before the response are passed to the subscribers.
+ */
+void Directory::_receive_response(
+        DlsProto::Response &res,
+        bool debug
+        )
+{
+    while (1) {
+        _receive_message(res, debug);
+
+        if (!res.has_live()) {
+            return;
+        }
+
+        _dispatch_live(res.live());
+    }
+}
+
+/*****************************************************************************/
+
+/** Checks, if the receive buffer contains a complete message.
+ */
+bool Directory::_message_pending() const
+{
+    uint32_t messageSize;
+
+    if (_receive_start == _receive_end) {
+        return false;
+    }
+
+    google::protobuf::io::CodedInputStream
+        ci((const google::protobuf::uint8 *)
+                &_receive_buffer[_receive_start],
+                _receive_end - _receive_start);
+    if (!ci.ReadVarint32(&messageSize)) {
+        return false;
+    }
+
+    return _receive_end - _receive_start
+        >= ci.CurrentPosition() + messageSize;
+}
+
+/*****************************************************************************/
+
+/** Waits, until the socket is readable.
+ *
+ * \return true, if data can be received.
+ */
+bool Directory::_wait_readable(
+        int timeout /**< Timeout in milliseconds. */
+        )
+{
+    fd_set fds;
+    struct timeval tv;
+
+    FD_ZERO(&fds);
+    FD_SET(_sock, &fds);
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+
+    int ret = select(_sock + 1, &fds, NULL, NULL, &tv);
+    if (ret < 0) {
+#ifdef _WIN32
+        int e = WSAGetLastError();
+#else
+        int e = errno;
+        if (e == EINTR) {
+            return false;
+        }
+#endif
+        stringstream err;
+        err << "select() failed: " << strerror(e);
+        log(err.str());
+        return false;
+    }
+
+    return ret > 0;
+}
+
+/*****************************************************************************/
+
+/** Passes pushed live data to the subscriber.
+ *
+ * Data of cancelled subscriptions, that were still on the way, are
+ * discarded. Blocks dropped by the server are counted (see
+ * Channel::live_dropped()).
+ */
+void Directory::_dispatch_live(const DlsProto::LiveData &live)
+{
+    map<LiveKey, LiveSubscriber>::iterator sub_i =
+        _live_subscribers.find(LiveKey(live.job_id(), live.channel_id()));
+
+    if (sub_i == _live_subscribers.end()) {
+        return;
+    }
+
+    if (live.dropped()) {
+        sub_i->second.dropped += live.dropped();
+
+        stringstream err;
+        err << "WARNING: Server dropped " << live.dropped()
+            << " live data block(s) of channel " << live.channel_id()
+            << " of job " << live.job_id() << ".";
+        log(err.str());
+    }
+
+    Data *d = new Data(live.data());
+    if (!sub_i->second.cb(d, sub_i->second.cb_data)) {
+        delete d;
+    }
+}
+
+/*****************************************************************************/
+
 void Directory::_receive_hello()
 {
     DlsProto::Hello hello;
@@ -714,3 +869,95 @@ bool Directory::serverSupportsMessages()
 }
 
 /*****************************************************************************/
+
+/** Returns true, if the server answers pipelined requests (see
+ * Job::fetch_data()).
+ */
+bool Directory::serverSupportsPipelining()
+{
+    return connected() && _protocol_version >= 5;
+}
+
+/*****************************************************************************/
+
+/** Returns true, if the server pushes the live data of subscribed channels
+ * (see Channel::subscribe()).
+ */
+bool Directory::serverSupportsLiveData()
+{
+    return connected() && _protocol_version >= 7;
+}
+
+/*****************************************************************************/
+
+/** Passes received live data to the subscribers.
+ *
+ * Live data arriving while the response to another request is received are
+ * passed on immediately. Otherwise, they are only received by this method,
+ * which shall be called regularly by clients with subscriptions, e. g.
+ * from their event loop. If no complete message was received yet, it waits
+ * up to \a timeout milliseconds for the socket to become readable.
+ *
+ * \return Number of passed data blocks.
+ * \throw DirectoryException Connection lost.
+ */
+unsigned int Directory::process_live(
+        int timeout /**< Timeout in milliseconds. */
+        )
+{
+    unsigned int count = 0;
+
+    while (connected()) {
+        if (!_message_pending()) {
+            if (!_wait_readable(timeout)) {
+                break;
+            }
+            _receive_data();
+            timeout = 0; // only dispatch what is already there
+            continue;
+        }
+
+        DlsProto::Response res;
+        _receive_message(res, 0);
+
+        if (res.has_live()) {
+            _dispatch_live(res.live());
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/*****************************************************************************/
+
+/** Sets the value encoding to request for data from a network server.
+ *
+ * The default is Data::CompressedBlocks, i. e. the server forwards the
+ * compressed blocks from its data files where possible, and sends the
+ * values in the native channel type otherwise (Data::RawValues).
+ * Data::CompressedRawValues saves bandwidth also for decimated data at the
+ * cost of CPU time on the server. Servers with a protocol version below 4
+ * get Data::RawValues instead of Data::CompressedBlocks, servers with a
+ * protocol version below 3 always send one double per value.
+ */
+void Directory::set_data_encoding(Data::Encoding encoding)
+{
+    _data_encoding = encoding;
+}
+
+/*****************************************************************************/
+
+/** Sets the number of threads for decoding data blocks.
+ *
+ * With more than one thread, Channel::fetch_data() decodes the blocks of
+ * local data files on a pool of worker threads. The data callback is still
+ * called in order from the calling thread. MDCT-compressed and decimated
+ * data are always decoded sequentially. The default is 1.
+ */
+void Directory::set_decoder_threads(unsigned int threads)
+{
+    _decoder_threads = threads;
+}
+
+/*****************************************************************************/
@@ -17,6 +17,11 @@
  *
  *****************************************************************************/
 
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
 #include <sstream>
 #include <limits>
 #include <iomanip>
@@ -25,6 +30,8 @@ using namespace std;
 #include "LibDLS/Export.h"
 
 #include "File.h"
+#include "DeltaT.h"
+#include "XorT.h"
 
 using namespace LibDLS;
 
@@ -80,11 +87,138 @@ void Export::setTrim(const Time &start, const Time &end)
     _impl->trimEnd = end;
 }
 
+/*****************************************************************************/
+
+/** Completes the export after the last channel.
+ *
+ * Needed by exporters that write multiple channels into one file.
+ */
+void Export::finish()
+{
+}
+
 /******************************************************************************
  * ExportAscii
  *****************************************************************************/
 
-ExportAscii::ExportAscii()
+#define ASCII_BUFFER_SIZE (256 * 1024)
+
+/** Maximum length of a line: Time, tab, the longest fixed-point
+ * representation of a double (denormals), newline. */
+#define ASCII_LINE_SIZE 400
+
+/*****************************************************************************/
+
+/** Formats an integer.
+ *
+ * \return Pointer behind the last digit.
+ */
+static char *format_int64(char *p, int64_t value)
+{
+    static const char pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233"
+        "34353637383940414243444546474849505152535455565758596061626364656667"
+        "6869707172737475767778798081828384858687888990919293949596979899";
+    char digits[20], *d = digits + sizeof(digits);
+    uint64_t u = value;
+
+    if (value < 0) {
+        *p++ = '-';
+        u = -u;
+    }
+
+    while (u >= 100) {
+        unsigned int i = (u % 100) * 2;
+        u /= 100;
+        *--d = pairs[i + 1];
+        *--d = pairs[i];
+    }
+    if (u >= 10) {
+        *--d = pairs[u * 2 + 1];
+        *--d = pairs[u * 2];
+    }
+    else {
+        *--d = '0' + u;
+    }
+
+    size_t len = digits + sizeof(digits) - d;
+    memcpy(p, d, len);
+    return p + len;
+}
+
+/*****************************************************************************/
+
+/** Formats a double in fixed-point notation.
+ *
+ * Uses the first of 15, 16 and 17 significant digits, that reads back to
+ * the same value, without trailing zeros. The digits are determined with
+ * printf() and strtod() in scientific notation, so the output is the same
+ * with all standard libraries, that round correctly. The decimal point of
+ * the locale is replaced with a dot.
+ *
+ * \return Pointer behind the last character.
+ */
+static char *format_double(char *p, double value)
+{
+    char sci[32];
+    const char *s = sci;
+    int prec, exp, count, i;
+
+    if (!isfinite(value)) {
+        return p + snprintf(p, ASCII_LINE_SIZE - 22, "%f", value);
+    }
+
+    for (prec = 14; ; prec++) {
+        snprintf(sci, sizeof(sci), "%.*e", prec, value);
+        if (prec == 16 || strtod(sci, NULL) == value) {
+            break;
+        }
+    }
+
+    // sci is [-]d.ddde[+-]xx, the decimal point is one character
+    if (*s == '-') {
+        *p++ = '-';
+        s++;
+    }
+
+    char digits[17];
+    digits[0] = s[0];
+    memcpy(digits + 1, s + 2, prec);
+    exp = atoi(s + 3 + prec);
+
+    count = prec + 1;
+    while (count > 1 && digits[count - 1] == '0') {
+        count--;
+    }
+
+    if (exp < 0) {
+        *p++ = '0';
+        *p++ = '.';
+        for (i = -1; i > exp; i--) {
+            *p++ = '0';
+        }
+        memcpy(p, digits, count);
+        p += count;
+    }
+    else {
+        for (i = 0; i <= exp; i++) {
+            *p++ = i < count ? digits[i] : '0';
+        }
+        if (count > exp + 1) {
+            *p++ = '.';
+            memcpy(p, digits + exp + 1, count - exp - 1);
+            p += count - exp - 1;
+        }
+    }
+
+    return p;
+}
+
+/*****************************************************************************/
+
+ExportAscii::ExportAscii():
+    _buffer(ASCII_BUFFER_SIZE),
+    _fill(0)
 {
 }
 
@@ -128,11 +262,16 @@ void ExportAscii::begin(
     _file << "%    Unit: " << channel.unit() << endl;
     _file << "%" << endl;
 
-    _file << setprecision(std::numeric_limits<long double>::digits10);
+    _fill = 0;
 }
 
 /*****************************************************************************/
 
+/** Appends the values as lines of time (in microseconds) and value.
+ *
+ * The lines are collected in a buffer, that is written with few system
+ * calls.
+ */
 void ExportAscii::data(const Data *data)
 {
     unsigned int i;
@@ -141,8 +280,17 @@ void ExportAscii::data(const Data *data)
         Time time(data->time(i));
         if (!_impl->trim ||
                 (time >= _impl->trimStart && time <= _impl->trimEnd)) {
-            _file << fixed << time - _impl->referenceTime << "\t"
-                << fixed << data->value(i) << endl;
+            if (_fill + ASCII_LINE_SIZE > _buffer.size()) {
+                _flush();
+            }
+
+            char *start = &_buffer[_fill], *p;
+            p = format_int64(start,
+                    (time - _impl->referenceTime).to_int64());
+            *p++ = '\t';
+            p = format_double(p, data->value(i));
+            *p++ = '\n';
+            _fill += p - start;
         }
     }
 }
@@ -151,9 +299,28 @@ void ExportAscii::data(const Data *data)
 
 void ExportAscii::end()
 {
+    _flush();
     _file.close();
 }
 
+/*****************************************************************************/
+
+/** Writes the buffered lines to the file.
+ */
+void ExportAscii::_flush()
+{
+    if (!_fill) {
+        return;
+    }
+
+    _file.write(&_buffer[0], _fill);
+    _fill = 0;
+
+    if (_file.fail()) {
+        throw ExportException("Failed to write to export file!");
+    }
+}
+
 /******************************************************************************
  * ExportMat4
  *****************************************************************************/
@@ -230,4 +397,357 @@ void ExportMat4::end()
     _file->close();
 }
 
+/******************************************************************************
+ * ExportColumns
+ *****************************************************************************/
+
+#define COLUMNS_MAGIC "DLSCOL1" // including the terminating zero
+
+/*****************************************************************************/
+
+/** Constructor.
+ */
+ExportColumns::ExportColumns(
+        const string &name /**< File name without extension. */
+        ):
+    _target(new Target()),
+    _primary(true),
+    _column(0),
+    _group(0)
+{
+    _target->name = name;
+    _target->group_duration = 60000000; // one minute
+    pthread_mutex_init(&_target->mutex, NULL);
+}
+
+/*****************************************************************************/
+
+/** Constructor for an exporter attached to the file of another one.
+ *
+ * The primary exporter has to exist, until this one is deleted.
+ */
+ExportColumns::ExportColumns(
+        ExportColumns *primary /**< Exporter owning the file. */
+        ):
+    _target(primary->_target),
+    _primary(false),
+    _column(0),
+    _group(0)
+{
+}
+
+/*****************************************************************************/
+
+ExportColumns::~ExportColumns()
+{
+    if (!_primary) {
+        return;
+    }
+
+    if (_target->file.is_open()) {
+        _target->file.close(); // incomplete without footer
+    }
+
+    pthread_mutex_destroy(&_target->mutex);
+    delete _target;
+}
+
+/*****************************************************************************/
+
+/** Sets the duration of a row group.
+ *
+ * Has to be called before the first channel is exported. Applies to all
+ * attached exporters.
+ */
+void ExportColumns::setRowGroupDuration(const Time &duration)
+{
+    if (duration.to_int64() > 0) {
+        pthread_mutex_lock(&_target->mutex);
+        _target->group_duration = duration.to_int64();
+        pthread_mutex_unlock(&_target->mutex);
+    }
+}
+
+/*****************************************************************************/
+
+void ExportColumns::begin(
+        const Channel &channel,
+        const string &path,
+        const string &filename
+        )
+{
+    Column column;
+    column.dir_index = channel.dir_index();
+    column.name = channel.name();
+    column.unit = channel.unit();
+    if (filename.empty()) {
+        stringstream str;
+        str << "channel" << channel.dir_index();
+        column.filename = str.str();
+    }
+    else {
+        column.filename = filename;
+    }
+
+    pthread_mutex_lock(&_target->mutex);
+
+    try {
+        if (!_target->file.is_open()) {
+            _target->path = path + "/" + _target->name + ".dlsc";
+            _target->file.open(_target->path.c_str(),
+                    ios::binary | ios::trunc);
+            if (!_target->file.is_open()) {
+                stringstream err;
+                err << "Failed to open file \"" << _target->path << "\"!";
+                throw ExportException(err.str());
+            }
+            _write(_target, COLUMNS_MAGIC, sizeof(COLUMNS_MAGIC));
+        }
+    }
+    catch (ExportException &e) {
+        pthread_mutex_unlock(&_target->mutex);
+        throw;
+    }
+
+    _column = _target->columns.size();
+    _target->columns.push_back(column);
+
+    pthread_mutex_unlock(&_target->mutex);
+
+    _times.clear();
+    _values.clear();
+}
+
+/*****************************************************************************/
+
+void ExportColumns::data(const Data *data)
+{
+    unsigned int i;
+    int64_t group_duration;
+
+    pthread_mutex_lock(&_target->mutex);
+    bool empty = _target->columns.empty();
+    group_duration = _target->group_duration;
+    pthread_mutex_unlock(&_target->mutex);
+
+    if (empty) {
+        return;
+    }
+
+    for (i = 0; i < data->size(); i++) {
+        Time time(data->time(i));
+        if (_impl->trim &&
+                (time < _impl->trimStart || time > _impl->trimEnd)) {
+            continue;
+        }
+
+        int64_t t = time.to_int64();
+        int64_t group = t / group_duration;
+        if (t < 0 && t % group_duration) {
+            group--; // round towards minus infinity
+        }
+
+        if (group != _group && !_times.empty()) {
+            _flush_group();
+        }
+        _group = group;
+
+        _times.push_back((time - _impl->referenceTime).to_int64());
+        _values.push_back(data->value(i));
+    }
+}
+
+/*****************************************************************************/
+
+void ExportColumns::end()
+{
+    _flush_group();
+}
+
+/*****************************************************************************/
+
+/** Writes the footer and closes the file.
+ *
+ * The footer contains the channel list and the index of all column chunks
+ * per row group, followed by its size and the magic number.
+ *
+ * Only the primary exporter writes the footer. Attached exporters have to
+ * be ended before.
+ */
+void ExportColumns::finish()
+{
+    uint32_t u32;
+    uint64_t footer_start, footer_size;
+    std::map<int64_t, std::map<unsigned int, ColumnChunk> >::const_iterator
+        group_i;
+    std::map<unsigned int, ColumnChunk>::const_iterator chunk_i;
+    vector<Column>::const_iterator column_i;
+    Target *t = _target;
+
+    if (!_primary || !t->file.is_open()) {
+        return;
+    }
+
+    footer_start = t->file.tellp();
+
+    _write_le(t, t->columns.size(), 4);
+    for (column_i = t->columns.begin(); column_i != t->columns.end();
+            column_i++) {
+        _write_le(t, column_i->dir_index, 4);
+        _write_le(t, column_i->name.size(), 4);
+        _write(t, column_i->name.c_str(), column_i->name.size());
+        _write_le(t, column_i->unit.size(), 4);
+        _write(t, column_i->unit.c_str(), column_i->unit.size());
+        _write_le(t, column_i->filename.size(), 4);
+        _write(t, column_i->filename.c_str(), column_i->filename.size());
+    }
+
+    _write_le(t, _impl->referenceTime.to_int64(), 8);
+    _write_le(t, t->group_duration, 8);
+
+    _write_le(t, t->groups.size(), 4);
+    for (group_i = t->groups.begin(); group_i != t->groups.end();
+            group_i++) {
+        _write_le(t, group_i->first * t->group_duration, 8);
+
+        for (u32 = 0; u32 < t->columns.size(); u32++) {
+            ColumnChunk chunk;
+            chunk_i = group_i->second.find(u32);
+            if (chunk_i != group_i->second.end()) {
+                chunk = chunk_i->second;
+            }
+            else {
+                memset(&chunk, 0, sizeof(chunk));
+            }
+            _write_le(t, chunk.offset, 8);
+            _write_le(t, chunk.time_size, 4);
+            _write_le(t, chunk.value_size, 4);
+            _write_le(t, chunk.count, 4);
+            _write_double(t, chunk.min);
+            _write_double(t, chunk.max);
+        }
+    }
+
+    footer_size = (uint64_t) t->file.tellp() - footer_start;
+    _write_le(t, footer_size, 8);
+    _write(t, COLUMNS_MAGIC, sizeof(COLUMNS_MAGIC));
+
+    t->file.close();
+    if (t->file.fail()) {
+        stringstream err;
+        err << "Failed to close file \"" << t->path << "\"!";
+        throw ExportException(err.str());
+    }
+
+    t->columns.clear();
+    t->groups.clear();
+}
+
+/*****************************************************************************/
+
+/** Writes the column chunk of the current row group.
+ *
+ * The columns are encoded without holding the mutex of the file.
+ */
+void ExportColumns::_flush_group()
+{
+    DeltaT<int64_t> times;
+    XorT<double> values;
+    ColumnChunk chunk;
+    unsigned int i;
+
+    if (_times.empty()) {
+        return;
+    }
+
+    try {
+        times.encode(&_times[0], _times.size());
+        values.encode(&_values[0], _values.size());
+    }
+    catch (EDelta &e) {
+        throw ExportException("Failed to encode times: " + e.msg);
+    }
+    catch (EXor &e) {
+        throw ExportException("Failed to encode values: " + e.msg);
+    }
+
+    chunk.time_size = times.encode_output_size();
+    chunk.value_size = values.encode_output_size();
+    chunk.count = _values.size();
+    chunk.min = chunk.max = _values[0];
+    for (i = 1; i < _values.size(); i++) {
+        if (_values[i] < chunk.min) {
+            chunk.min = _values[i];
+        }
+        if (_values[i] > chunk.max) {
+            chunk.max = _values[i];
+        }
+    }
+
+    pthread_mutex_lock(&_target->mutex);
+
+    try {
+        chunk.offset = _target->file.tellp();
+        _write(_target, times.encode_output(), chunk.time_size);
+        _write(_target, values.encode_output(), chunk.value_size);
+    }
+    catch (ExportException &e) {
+        pthread_mutex_unlock(&_target->mutex);
+        throw;
+    }
+
+    _target->groups[_group][_column] = chunk;
+
+    pthread_mutex_unlock(&_target->mutex);
+
+    _times.clear();
+    _values.clear();
+}
+
+/*****************************************************************************/
+
+void ExportColumns::_write(Target *target, const void *data, size_t size)
+{
+    target->file.write((const char *) data, size);
+
+    if (target->file.fail()) {
+        stringstream err;
+        err << "Failed to write to \"" << target->path << "\"!";
+        throw ExportException(err.str());
+    }
+}
+
+/*****************************************************************************/
+
+/** Writes the lower bytes of an integer in little-endian byte order.
+ */
+void ExportColumns::_write_le(
+        Target *target,
+        uint64_t value, /**< Value. Signed values are written in two's
+                          complement. */
+        unsigned int size /**< Number of bytes (at most 8). */
+        )
+{
+    char bytes[8];
+
+    for (unsigned int i = 0; i < size; i++) {
+        bytes[i] = value & 0xff;
+        value >>= 8;
+    }
+
+    _write(target, bytes, size);
+}
+
+/*****************************************************************************/
+
+/** Writes a double in little-endian byte order.
+ */
+void ExportColumns::_write_double(Target *target, double value)
+{
+    uint64_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+    _write_le(target, bits, sizeof(bits));
+}
+
 /*****************************************************************************/
@@ -23,6 +23,9 @@
 #include <errno.h>
 #include <string.h>
 #include <unistd.h>
+#ifndef __WIN32__
+#include <sys/mman.h>
+#endif
 
 #include <iostream>
 #include <sstream>
@@ -44,6 +47,8 @@ using namespace LibDLS;
 File::File()
 {
     _mode = fomClosed;
+    _map_addr = NULL;
+    _map_size = 0;
 }
 
 /*****************************************************************************/
@@ -246,6 +251,8 @@ void File::close()
         return;
     }
 
+    File::unmap();
+
 #if _BSD_SOURCE || _XOPEN_SOURCE || _POSIX_C_SOURCE >= 200112L
     if (_mode != fomOpenRead) { // open for writing/appending
         if (fsync(_fd) == -1) {
@@ -586,3 +593,64 @@ uint64_t File::calc_size()
 
 /*****************************************************************************/
 
+/**
+   Maps the beginning of the file read-only into memory
+
+   The mapping is shared, so changes to the mapped range by other processes
+   are visible. It is removed with unmap() or when closing the file.
+
+   \param size Number of bytes to map, counted from the start of the file
+   \return Start address of the mapping
+   \throw EFile File not open, or mapping not possible
+*/
+
+const char *File::map(uint64_t size)
+{
+    stringstream err;
+
+    if (_mode == fomClosed) {
+        throw EFile("File not open!");
+    }
+
+    File::unmap();
+
+#ifndef __WIN32__
+    if (!size || size > (uint64_t) (size_t) -1) {
+        err << "Invalid mapping size " << size << "!";
+        throw EFile(err.str());
+    }
+
+    void *addr = mmap(NULL, size, PROT_READ, MAP_SHARED, _fd, 0);
+
+    if (addr == MAP_FAILED) {
+        err << "Could not map file \"" << _path << "\": " << strerror(errno);
+        throw EFile(err.str());
+    }
+
+    _map_addr = addr;
+    _map_size = size;
+    return (const char *) addr;
+#else
+    throw EFile("Memory mapping not supported!");
+#endif
+}
+
+/*****************************************************************************/
+
+/**
+   Removes the memory mapping created with map()
+*/
+
+void File::unmap()
+{
+#ifndef __WIN32__
+    if (_map_addr) {
+        munmap(_map_addr, _map_size);
+    }
+#endif
+
+    _map_addr = NULL;
+    _map_size = 0;
+}
+
+/*****************************************************************************/
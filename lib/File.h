@@ -91,10 +91,17 @@ public:
 
     uint64_t calc_size();
 
+    //@{
+    const char *map(uint64_t);
+    void unmap();
+    //@}
+
 private:
     int _fd;                /**< File-Descriptor */
     FileOpenMode _mode;  /**< ffnungsmodus */
     string _path;           /**< Pfad der geffneten Datei */
+    void *_map_addr;        /**< Start of the read-only mapping, or NULL */
+    uint64_t _map_size;     /**< Size of the mapping in bytes */
 };
 
 /*****************************************************************************/
@@ -61,11 +61,36 @@ template <class REC>
 class IndexT
 {
 public:
+    /** Iterator over the records of an index.
+     *
+     * Dereferencing reads the record via IndexT::operator[] and may throw
+     * EIndexT.
+     */
+    class iterator
+    {
+    public:
+        iterator(): _index(NULL), _row(0) {};
+        iterator(IndexT<REC> *index, unsigned int row):
+            _index(index), _row(row) {};
+
+        REC operator*() const { return (*_index)[_row]; };
+        iterator &operator++() { _row++; return *this; };
+        bool operator==(const iterator &o) const { return _row == o._row; };
+        bool operator!=(const iterator &o) const { return _row != o._row; };
+
+        unsigned int row() const { return _row; };
+
+    private:
+        IndexT<REC> *_index;
+        unsigned int _row;
+    };
+
     IndexT();
     ~IndexT();
 
     // Dazeistatus
     void open_read(const string &);
+    void open_read_mapped(const string &);
     void open_read_write(const string &);
     void open_read_append(const string &);
     void close();
@@ -73,6 +98,10 @@ public:
 
     // Lesezugriff
     REC operator[](unsigned int);
+    iterator begin() { return iterator(this, 0); };
+    iterator end() { return iterator(this, _record_count); };
+    template <class PRED>
+        iterator lower_bound(PRED);
 
     // Schreibzugriff
     void append_record(const REC *);
@@ -82,11 +111,18 @@ public:
     uint64_t file_size() const { return _size; };
     const std::string path() const { return _file.path(); };
 
+    /** Contiguous records of a mapped index, or NULL.
+     *
+     * Valid for record_count() records, as long as the index is open.
+     */
+    const REC *records() const { return _records; };
+
 private:
     File _file;
     uint64_t _size;
     unsigned int _record_count;
     unsigned int _position;
+    const REC *_records; /**< Mapped records (see open_read_mapped()) */
 };
 
 /*****************************************************************************/
@@ -99,7 +135,8 @@ template <class REC>
 IndexT<REC>::IndexT():
     _size(0),
     _record_count(0),
-    _position(0)
+    _position(0),
+    _records(NULL)
 {
 }
 
@@ -139,6 +176,8 @@ void IndexT<REC>::open_read(const string &file_name)
 {
     stringstream err;
 
+    _records = NULL;
+
     try {
         _file.open_read(file_name.c_str(), File::Binary);
         _size = _file.calc_size();
@@ -168,6 +207,55 @@ void IndexT<REC>::open_read(const string &file_name)
 
 /*****************************************************************************/
 
+/**
+   Opens an index file read-only and maps its records into memory
+
+   The records can then be accessed via records() without any system calls.
+   The mapping covers the records present at the time of opening; an
+   incomplete record at the end of a file, that is currently appended to,
+   is ignored. If the file can not be mapped, the index falls back to
+   reading the records with operator[] as with open_read().
+
+   \param file_name Dateiname der Index-Datei
+   \throw EIndexT Datei nicht zu ffnen
+*/
+
+template <class REC>
+void IndexT<REC>::open_read_mapped(const string &file_name)
+{
+    _records = NULL;
+
+    try {
+        _file.open_read(file_name.c_str(), File::Binary);
+        _size = _file.calc_size();
+    }
+    catch (EFile &e) {
+        throw EIndexT(e.msg);
+    }
+
+    _record_count = _size / sizeof(REC);
+    _position = 0;
+
+    if (!_record_count) {
+        return;
+    }
+
+    try {
+        _records = (const REC *) _file.map(_record_count * sizeof(REC));
+    }
+    catch (EFile &e) {
+        // mapping not possible: read records on demand
+        try {
+            _file.seek(0);
+        }
+        catch (EFile &e) {
+            throw EIndexT(e.msg);
+        }
+    }
+}
+
+/*****************************************************************************/
+
 /**
    ffnet eine binre Index-Datei zum Lesen und Schreiben
 
@@ -182,6 +270,8 @@ void IndexT<REC>::open_read_write(const string &file_name)
 {
     stringstream err;
 
+    _records = NULL;
+
     try
     {
         _file.open_read_write(file_name.c_str(), File::Binary);
@@ -229,6 +319,8 @@ void IndexT<REC>::open_read_append(const string &file_name)
 {
     stringstream err;
 
+    _records = NULL;
+
     try
     {
         _file.open_read_append(file_name.c_str(), File::Binary);
@@ -272,6 +364,7 @@ void IndexT<REC>::close()
     _size = 0;
     _record_count = 0;
     _position = 0;
+    _records = NULL;
 
     try
     {
@@ -345,6 +438,10 @@ REC IndexT<REC>::operator[](unsigned int index)
         throw EIndexT(err.str());
     }
 
+    if (_records) {
+        return _records[index];
+    }
+
     unsigned int target_pos = index * sizeof(REC);
     if (_position != target_pos)
     {
@@ -407,6 +504,45 @@ REC IndexT<REC>::operator[](unsigned int index)
 
 /*****************************************************************************/
 
+/**
+   Binary search for the first record not matching a predicate.
+
+   The records have to be partitioned with respect to the predicate, i. e.
+   all records for which \a before returns true have to precede all
+   records for which it returns false. As the records are sorted by time,
+   this is the case for predicates like "record ends before time t".
+
+   Only O(log n) records are read.
+
+   \param before Predicate taking a const REC reference
+   \return Iterator to the first record, for which \a before is false, or
+   end(), if there is none.
+   \throw EIndexT Read error
+*/
+
+template <class REC>
+template <class PRED>
+typename IndexT<REC>::iterator IndexT<REC>::lower_bound(PRED before)
+{
+    unsigned int first = 0, count = _record_count, step;
+
+    while (count > 0) {
+        step = count / 2;
+
+        if (before((*this)[first + step])) {
+            first += step + 1;
+            count -= step + 1;
+        }
+        else {
+            count = step;
+        }
+    }
+
+    return iterator(this, first);
+}
+
+/*****************************************************************************/
+
 /**
    Fgt einen neuen Record an den Index an
 
@@ -25,6 +25,7 @@
 #include <pcre.h>
 
 #include <sstream>
+#include <vector>
 #include <fstream>
 #include <iostream>
 using namespace std;
@@ -316,6 +317,38 @@ list<LibDLS::Job::Message> LibDLS::Job::load_msg_filtered(
 
 /*****************************************************************************/
 
+/** Fetches data of multiple channels in the same time range.
+ *
+ * For network directories, all requests are sent at once and the
+ * responses are passed to the callbacks of the respective channels as they
+ * arrive, so that only a single round trip is necessary. Otherwise, or if
+ * the server does not support pipelining (protocol version < 5), the data
+ * are fetched channel by channel.
+ */
+void Job::fetch_data(
+        const std::list<DataRequest> &requests, /**< Channels and
+                                                  callbacks. */
+        Time start, /**< Start of requested time range. */
+        Time end, /**< End of requested time range. */
+        unsigned int min_values, /**< Minimal number of values. */
+        unsigned int decimation /**< Decimation. */
+        )
+{
+    if (_dir->access() == Directory::Network
+            && _dir->serverSupportsPipelining()) {
+        _fetch_data_network(requests, start, end, min_values, decimation);
+        return;
+    }
+
+    for (list<DataRequest>::const_iterator req_i = requests.begin();
+            req_i != requests.end(); req_i++) {
+        req_i->channel->fetch_data(start, end, min_values, req_i->cb,
+                req_i->cb_data, decimation);
+    }
+}
+
+/*****************************************************************************/
+
 void Job::set_job_info(DlsProto::JobInfo *job_info, bool preset) const
 {
     if (preset) {
@@ -401,7 +434,7 @@ void Job::_fetch_channels_network()
     }
 
     try {
-        _dir->_receive_message(res);
+        _dir->_receive_response(res);
     }
     catch (DirectoryException &e) {
         cerr << "Failed to receive channels: " << e.msg << endl;
@@ -426,6 +459,94 @@ void Job::_fetch_channels_network()
 
 /*****************************************************************************/
 
+/** Sends pipelined data requests and dispatches the responses.
+ *
+ * Each request carries its index in \a requests as request ID, which the
+ * server returns in all responses to it. Every request is terminated by a
+ * response with end_of_response set.
+ */
+void Job::_fetch_data_network(
+        const std::list<DataRequest> &requests, /**< Channels and
+                                                  callbacks. */
+        Time start, /**< Start of requested time range. */
+        Time end, /**< End of requested time range. */
+        unsigned int min_values, /**< Minimal number of values. */
+        unsigned int decimation /**< Decimation. */
+        )
+{
+    vector<const DataRequest *> pending;
+
+    for (list<DataRequest>::const_iterator req_i = requests.begin();
+            req_i != requests.end(); req_i++) {
+        DlsProto::Request req;
+        req_i->channel->_set_data_request(&req, start, end, min_values,
+                decimation);
+        req.set_request_id(pending.size());
+
+        try {
+            _dir->_send_message(req);
+        }
+        catch (DirectoryException &e) {
+            stringstream err;
+            err << "Failed to request data: " << e.msg;
+            log(err.str());
+            return;
+        }
+
+        pending.push_back(&*req_i);
+    }
+
+    unsigned int remaining = pending.size();
+    DlsProto::Response res;
+
+    while (remaining) {
+        try {
+            _dir->_receive_response(res, 0);
+        }
+        catch (DirectoryException &e) {
+            stringstream err;
+            err << "Failed to receive data: " << e.msg;
+            log(err.str());
+            return;
+        }
+
+        if (!res.has_request_id() || res.request_id() >= pending.size()
+                || !pending[res.request_id()]) {
+            stringstream err;
+            err << "Error: Response to unknown request!";
+            log(err.str());
+            continue;
+        }
+
+        const DataRequest *req = pending[res.request_id()];
+
+        if (res.has_error()) {
+            stringstream err;
+            err << "Error response for channel " << req->channel->name()
+                << ": " << res.error().message();
+            log(err.str());
+        }
+
+        if (res.has_end_of_response() && res.end_of_response()) {
+            pending[res.request_id()] = NULL;
+            remaining--;
+            continue;
+        }
+
+        if (!res.has_data()) {
+            continue;
+        }
+
+        Data *d = new Data(res.data());
+        int adopted = req->cb(d, req->cb_data);
+        if (!adopted) {
+            delete d;
+        }
+    }
+}
+
+/*****************************************************************************/
+
 /** Lädt Nachrichten im angegebenen Zeitbereich (lokal).
  *
  * \param start Anfangszeit des Bereiches
@@ -577,7 +698,7 @@ void LibDLS::Job::_load_msg_local(
         }
 
         try {
-            index.open_read((msg_chunk_dir.str() + "/messages.idx").c_str());
+            index.open_read_mapped((msg_chunk_dir.str() + "/messages.idx").c_str());
         }
         catch (EIndexT &e) {
             stringstream err;
@@ -840,7 +961,7 @@ void LibDLS::Job::_load_msg_network(
     }
 
     try {
-        _dir->_receive_message(res);
+        _dir->_receive_response(res);
     }
     catch (DirectoryException &e) {
         cerr << "Failed to receive messages: " << e.msg << endl;
@@ -36,6 +36,7 @@
 
 namespace DlsProto {
     class ChannelInfo;
+    class Request;
 }
 
 namespace LibDLS {
@@ -76,8 +77,17 @@ public:
 
     void import(const std::string &, unsigned int);
     std::pair<std::set<Chunk *>, std::set<int64_t> > fetch_chunks();
+    std::pair<std::set<Chunk *>, std::set<int64_t> > update_chunks(
+            const Channel &);
     void fetch_data(Time, Time, unsigned int,
-                    DataCallback, void *, unsigned int = 1);
+                    DataCallback, void *, unsigned int = 1, bool = false);
+    void fetch_envelope(Time, Time, unsigned int, DataCallback, void *);
+    int calc_min_max(Time, Time, double *, double *);
+    unsigned int max_block_size(Time, Time);
+
+    void subscribe(DataCallback, void *, bool = false);
+    void unsubscribe();
+    unsigned int live_dropped() const;
 
     std::string path() const { return _path; }
     unsigned int dir_index() const { return _dir_index; }
@@ -103,6 +113,8 @@ public:
     void update_index();
 
 private:
+    friend class Job;
+
     Job * const _job; /**< Parent job. */
     std::string _path; /**< channel directory path */
     unsigned int _dir_index; /**< index of the channel directory */
@@ -118,10 +130,14 @@ private:
     std::pair<std::set<Chunk *>, std::set<int64_t> > _fetch_chunks_local();
     std::pair<std::set<Chunk *>, std::set<int64_t> > _fetch_chunks_network();
     void _fetch_data_local(Time, Time, unsigned int,
-                    DataCallback, void *, unsigned int);
+                    DataCallback, void *, unsigned int, bool);
     void _fetch_data_network(Time, Time, unsigned int,
-                    DataCallback, void *, unsigned int) const;
+                    DataCallback, void *, unsigned int,
+                    unsigned int = 0) const;
+    void _set_data_request(DlsProto::Request *, Time, Time, unsigned int,
+                    unsigned int, unsigned int = 0) const;
     void _update_index_local();
+    void _send_subscription(bool, bool);
 
     Channel();
 };
@@ -81,7 +81,13 @@ class ChannelPreset
         unsigned int mdct_block_size; /**< Blockgre fr MDCT */
         double accuracy; /**< Genauigkeit von verlustbehafteten Kompressionen
                           */
+        int compression_level; /**< Compression level for ZStd (0: library
+                                 default). */
+        std::string dictionary; /**< Path of a ZStd dictionary file, or
+                                  empty. */
         ChannelType type; /**< Datentyp des Kanals (nur fr MDCT-Prfung) */
+        BlockFormat block_format; /**< Container format of the data blocks.
+                                   */
 };
 
 /*****************************************************************************/
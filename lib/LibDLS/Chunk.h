@@ -23,6 +23,7 @@
 /*****************************************************************************/
 
 #include <string>
+#include <vector>
 
 #include "Exception.h"
 #include "Time.h"
@@ -54,6 +55,22 @@ typedef int (*DataCallback)(Data *, void *);
 
 /*************************************************************************/
 
+/** Statistics of a stored block, see Chunk::fetch_block_stats().
+ */
+struct BlockStats
+{
+    MetaType meta_type; /**< Meta type of the data file. */
+    Time start; /**< Time of the first value. */
+    Time end; /**< Time of the last value. */
+    double min; /**< Minimum value. */
+    double max; /**< Maximum value. */
+    double mean; /**< Arithmetic mean. */
+    unsigned int count; /**< Number of values, or zero, if no statistics
+                          are stored for the block. */
+};
+
+/*************************************************************************/
+
 /** Chunk Exception.
  */
 class ChunkException:
@@ -82,10 +99,15 @@ class Chunk
         Time start() const { return _start; }
         Time end() const { return _end; }
         bool incomplete() const { return _incomplete; }
+        unsigned int block_size();
 
         void fetch_data(Time, Time, unsigned int,
                 DataCallback, void *,
-                unsigned int);
+                unsigned int, bool = false);
+        unsigned int fetch_block_stats(Time, Time, unsigned int,
+                std::vector<BlockStats> &);
+        void fetch_level_data(Time, Time, unsigned int, MetaType,
+                DataCallback, void *);
 
         bool operator<(const Chunk &) const;
         bool operator==(const Chunk &) const;
@@ -104,6 +126,10 @@ class Chunk
         unsigned int _meta_reduction; /**< Meta-Untersetzung */
         int _format_index; /**< Kompressionsformat */
         unsigned int _mdct_block_size; /**< MDCT-Blockgroesse */
+        unsigned int _block_size; /**< Number of values per block. */
+        BlockFormat _block_format; /**< Container format of the blocks. */
+        std::string _dictionary; /**< ZStd dictionary of the chunk, if any.
+                                  */
         Time _start; /**< Startzeit des Chunks */
         Time _end; /**< Endzeit des Chunks */
         ChannelType _type; /**< channel type */
@@ -116,6 +142,8 @@ class Chunk
 
         unsigned int _calc_optimal_level(Time, Time, unsigned int) const;
         Time _time_per_value(unsigned int) const;
+        void _fetch_block_stats(Time, Time, unsigned int, MetaType,
+                std::vector<BlockStats> &) const;
 
         void _fetch_level_data_wrapper(Time, Time,
                 MetaType,
@@ -126,7 +154,8 @@ class Chunk
                 void *,
                 unsigned int,
                 unsigned int &,
-                Time &) const;
+                Time &,
+                bool) const;
 
         template <class T>
             void _fetch_level_data(Time, Time,
@@ -138,7 +167,8 @@ class Chunk
                     void *,
                     unsigned int,
                     unsigned int &,
-                    Time &) const;
+                    Time &,
+                    bool) const;
 
         template <class T>
             bool _read_tag(
@@ -157,11 +187,14 @@ class Chunk
                     void *,
                     unsigned int,
                     unsigned int &,
-                    Time &
+                    Time &,
+                    bool
                     ) const;
 
         template <class T>
-            void _process_data_tag(const XmlTag *,
+            bool _process_data_block(const char *,
+                    unsigned int,
+                    unsigned int,
                     Time,
                     MetaType,
                     unsigned int,
@@ -172,7 +205,8 @@ class Chunk
                     void *,
                     unsigned int,
                     unsigned int &,
-                    Time &) const;
+                    Time &,
+                    bool) const;
 };
 
 /*****************************************************************************/
@@ -22,9 +22,11 @@
 
 /*****************************************************************************/
 
+#include <string>
 #include <vector>
 
 #include "globals.h"
+#include "Exception.h"
 #include "Time.h"
 
 namespace DlsProto {
@@ -35,6 +37,18 @@ namespace LibDLS {
 
 /*************************************************************************/
 
+/** Data exception.
+ */
+class DataException:
+    public Exception
+{
+    public:
+        DataException(const std::string &pmsg):
+            Exception(pmsg) {};
+};
+
+/*************************************************************************/
+
 /** Block of data values.
  */
 class Data
@@ -45,20 +59,56 @@ class Data
         Data(const DlsProto::Data &);
         ~Data();
 
+        /** Value encoding for protocol messages.
+         *
+         * Corresponds to DlsProto::DataEncoding.
+         */
+        enum Encoding {
+            DoubleValues, /**< One double per value. */
+            PackedValues, /**< Packed doubles. */
+            RawValues, /**< Raw bytes of the channel type. */
+            CompressedRawValues, /**< ZLib-compressed raw bytes. */
+            CompressedBlocks /**< Blocks as stored in the data files, if
+                               available (see import_block()). Otherwise,
+                               RawValues are used. */
+        };
+
+        void set_data_msg(DlsProto::Data *, Encoding = DoubleValues,
+                ChannelType = TUNKNOWN) const;
+
         template <class T>
             void import(Time, Time, MetaType, unsigned int,
                     unsigned int, unsigned int &, T*, unsigned int);
-
+        void import_block(Time, Time, MetaType, unsigned int,
+                int, bool, const char *, unsigned int,
+                unsigned int);
+
+        void decode_block(ChannelType);
+
+        /** Returns true, if the data is an undecoded compressed block.
+         */
+        bool has_block() const { return _block_length > 0; }
+        /** Returns the compression format of an undecoded block
+         * (FORMAT_*). */
+        int block_format() const { return _block_format; }
+        /** Returns the number of values in an undecoded block. */
+        unsigned int block_length() const { return _block_length; }
         void push_back(const Data &);
 
         Time start_time() const { return _start_time; }
         Time end_time() const {
-            return _start_time + _time_per_value * _data.size();
+            return _start_time + _time_per_value
+                * (has_block() ? _block_length : _data.size());
         }
         Time time_per_value() const { return _time_per_value; }
         MetaType meta_type() const { return _meta_type; }
         unsigned int meta_level() const { return _meta_level; }
 
+        /** Returns the number of decoded values.
+         *
+         * An undecoded block has no values, until decode_block() was
+         * called (see block_length()).
+         */
         size_t size() const { return _data.size(); }
         double value(unsigned int index) const { return _data[index]; }
         Time time(unsigned int index) const {
@@ -73,6 +123,11 @@ class Data
         MetaType _meta_type;
         unsigned int _meta_level;
         std::vector<double> _data;
+
+        std::string _block; /**< Compressed block, see import_block(). */
+        unsigned int _block_length; /**< Number of values in _block. */
+        int _block_format; /**< Compression format of _block (FORMAT_*). */
+        bool _block_base64; /**< _block is Base64-encoded. */
 };
 
 /*****************************************************************************/
@@ -98,6 +153,8 @@ void LibDLS::Data::import(
     _meta_type = meta_type;
     _meta_level = meta_level;
     _data.clear();
+    _block.clear();
+    _block_length = 0;
 
     for (i = 0; i < size; i++) {
         if (!decimationCounter) {
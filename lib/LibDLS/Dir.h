@@ -24,6 +24,8 @@
 
 #include <string>
 #include <list>
+#include <map>
+#include <vector>
 
 #ifdef _WIN32
 #include <ws2tcpip.h>
@@ -39,6 +41,7 @@ namespace DlsProto {
     class Request;
     class Response;
     class DirInfo;
+    class LiveData;
 }
 
 namespace google {
@@ -123,6 +126,16 @@ class DLS_EXPORT Directory
 
         const std::string &error_msg() const { return _error_msg; }
         bool serverSupportsMessages();
+        bool serverSupportsPipelining();
+        bool serverSupportsLiveData();
+
+        unsigned int process_live(int = 0);
+
+        void set_data_encoding(Data::Encoding);
+        Data::Encoding data_encoding() const { return _data_encoding; }
+
+        void set_decoder_threads(unsigned int);
+        unsigned int decoder_threads() const { return _decoder_threads; }
 
     private:
         std::string _uri_text;
@@ -139,9 +152,16 @@ class DLS_EXPORT Directory
 #else
         int _sock;
 #endif
-        std::string _receive_buffer;
+        std::vector<char> _receive_buffer; /**< Receive buffer. */
+        size_t _receive_start; /**< Start of unprocessed data in
+                                 _receive_buffer. */
+        size_t _receive_end; /**< End of received data in _receive_buffer. */
         int _protocol_version; /**< Server protocol version. */
         bool _proto_messages_warning_given; /**< Messages support warning. */
+        Data::Encoding _data_encoding; /**< Requested value encoding for
+                                         network data. */
+        unsigned int _decoder_threads; /**< Number of threads for decoding
+                                         local data blocks. */
 
         std::list<Job *> _jobs; /**< list of jobs */
 
@@ -149,6 +169,19 @@ class DLS_EXPORT Directory
 
         std::string _error_msg; /**< Last error message. */
 
+        /** Receiver of live data (see Channel::subscribe()). */
+        struct LiveSubscriber {
+            DataCallback cb; /**< Data callback. */
+            void *cb_data; /**< Arbitrary callback parameter. */
+            unsigned int dropped; /**< Blocks dropped by the server. */
+        };
+
+        /** Job ID and channel directory index. */
+        typedef std::pair<unsigned int, unsigned int> LiveKey;
+
+        std::map<LiveKey, LiveSubscriber>
+            _live_subscribers; /**< Subscribed channels. */
+
         void _importLocal();
         void _importNetwork();
 
@@ -158,7 +191,11 @@ class DLS_EXPORT Directory
         void _send_message(const DlsProto::Request &);
         void _receive_data();
         void _receive_message(google::protobuf::Message &, bool debug = 1);
+        void _receive_response(DlsProto::Response &, bool debug = 1);
         void _receive_hello();
+        bool _message_pending() const;
+        bool _wait_readable(int);
+        void _dispatch_live(const DlsProto::LiveData &);
 
         void _notify_observers();
 };
@@ -23,6 +23,10 @@
 /*****************************************************************************/
 
 #include <fstream>
+#include <map>
+#include <vector>
+#include <stdint.h>
+#include <pthread.h>
 
 #include "Exception.h"
 #include "Channel.h"
@@ -69,6 +73,7 @@ namespace LibDLS
                 const std::string & = std::string()) = 0;
         virtual void data(const Data *) = 0;
         virtual void end() = 0;
+        virtual void finish();
 
     protected:
         class Impl;
@@ -91,6 +96,10 @@ namespace LibDLS
 
     private:
         std::ofstream _file;
+        std::vector<char> _buffer; /**< Formatted lines. */
+        size_t _fill; /**< Number of bytes in _buffer. */
+
+        void _flush();
     };
 
     /*************************************************************************/
@@ -111,6 +120,83 @@ namespace LibDLS
         Mat4Header _header;
         File *_file;
     };
+
+    /*************************************************************************/
+
+    /** Exports all channels into one columnar file.
+     *
+     * The values are grouped into row groups of a fixed duration, which are
+     * aligned to multiples of the duration, so that a row group covers the
+     * same time range for all channels. Within a row group, each channel
+     * has a column chunk with delta-coded times and XOR-coded values. A
+     * footer indexes all column chunks, so that readers can load single
+     * channels and time ranges. The file is completed by finish().
+     *
+     * To export several channels in parallel, further exporters can be
+     * attached to the file of a primary one (one per thread). Only the
+     * primary exporter writes the footer, after all channels were ended.
+     */
+    class ExportColumns:
+        public Export
+    {
+    public:
+        ExportColumns(const std::string & = "channels");
+        ExportColumns(ExportColumns *);
+        ~ExportColumns();
+
+        void setRowGroupDuration(const Time &);
+
+        void begin(const Channel &, const std::string &,
+                const std::string & = std::string());
+        void data(const Data *);
+        void end();
+        void finish();
+
+    private:
+        /** Location and statistics of a column chunk. */
+        struct ColumnChunk {
+            uint64_t offset; /**< File position of the time column. */
+            uint32_t time_size; /**< Size of the time column in bytes. */
+            uint32_t value_size; /**< Size of the value column in bytes. */
+            uint32_t count; /**< Number of values. */
+            double min; /**< Minimum value. */
+            double max; /**< Maximum value. */
+        };
+
+        /** Exported channel. */
+        struct Column {
+            unsigned int dir_index;
+            std::string name;
+            std::string unit;
+            std::string filename;
+        };
+
+        /** Output file shared by the attached exporters. */
+        struct Target {
+            std::string name; /**< File name without extension. */
+            pthread_mutex_t mutex; /**< Protects the members below. */
+            std::ofstream file; /**< Output file. */
+            std::string path; /**< Path of the output file. */
+            int64_t group_duration; /**< Row group duration in s. */
+            std::vector<Column> columns; /**< Exported channels. */
+            std::map<int64_t, std::map<unsigned int, ColumnChunk> >
+                groups; /**< Column chunks by row group index and
+                          column. */
+        };
+
+        Target * const _target; /**< Output file. */
+        const bool _primary; /**< The target is owned by this exporter. */
+        unsigned int _column; /**< Index of the current column. */
+        int64_t _group; /**< Index of the current row group. */
+        std::vector<int64_t> _times; /**< Times of the current row group. */
+        std::vector<double> _values; /**< Values of the current row
+                                       group. */
+
+        void _flush_group();
+        static void _write(Target *, const void *, size_t);
+        static void _write_le(Target *, uint64_t, unsigned int);
+        static void _write_double(Target *, double);
+    };
 }
 
 /*****************************************************************************/
@@ -74,6 +74,21 @@ class Job
         Channel *find_channel(unsigned int);
         std::set<Channel *> find_channels_by_name(const std::string &);
 
+        /** Data request for a channel, see fetch_data().
+         */
+        struct DataRequest
+        {
+            DataRequest(Channel *channel, DataCallback cb, void *cb_data):
+                channel(channel), cb(cb), cb_data(cb_data) {}
+
+            Channel *channel; /**< Channel of this job. */
+            DataCallback cb; /**< Data callback for the channel. */
+            void *cb_data; /**< Arbitrary callback parameter. */
+        };
+
+        void fetch_data(const std::list<DataRequest> &, Time, Time,
+                unsigned int, unsigned int = 1);
+
         const std::string &path() const { return _path; }
         unsigned int id() const { return _preset.id(); }
         const JobPreset &preset() const { return _preset; }
@@ -128,6 +143,9 @@ class Job
         void _fetch_channels_local();
         void _fetch_channels_network();
 
+        void _fetch_data_network(const std::list<DataRequest> &, Time, Time,
+                unsigned int, unsigned int);
+
         void _load_msg_local(std::list<Message> &, Time, Time,
                 const std::string &, std::string = std::string()) const;
         void _load_msg_network(std::list<Message> &, Time, Time,
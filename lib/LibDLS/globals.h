@@ -30,6 +30,7 @@
 #define DLS_PID_FILE "dlsd.pid"
 #define ENV_DLS_DIR  "DLS_DIR" // Name der Umgebungsvariablen
 #define ENV_DLS_USER "DLS_USER" // Name der Umgebungsvariablen
+#define ENV_DLS_FFTW_WISDOM "DLS_FFTW_WISDOM" // FFTW-Wisdom-Datei fr MDCT
 
 /*****************************************************************************/
 
@@ -115,6 +116,9 @@ enum {
 	FORMAT_ZLIB,
 	FORMAT_MDCT,
 	FORMAT_QUANT,
+	FORMAT_DELTA,
+	FORMAT_XOR,
+	FORMAT_ZSTD,
 	FORMAT_COUNT
 };
 
@@ -128,6 +132,29 @@ extern const char *format_strings[FORMAT_COUNT];
 
 /*****************************************************************************/
 
+/** Container format of the blocks in the data files of a chunk.
+ *
+ * BlockFormatXml is the original format, where every block is stored as a
+ * Base64-encoded XML tag. Chunks without a block format attribute in their
+ * chunk.xml use this format. BlockFormatBinary stores a BlockHeader followed
+ * by the raw compressed payload.
+ */
+enum BlockFormat {
+    BlockFormatXml,
+    BlockFormatBinary,
+    BlockFormatCount
+};
+
+extern const char *block_format_strings[BlockFormatCount];
+
+BlockFormat str_to_block_format(const std::string &);
+
+/*****************************************************************************/
+
+#define DLS_BLOCK_MAGIC 0x4b4c4244 // "DBLK" in little endian byte order
+
+/*****************************************************************************/
+
 #pragma pack(push, 1)
 
 /**
@@ -143,6 +170,23 @@ struct IndexRecord
 
 /*****************************************************************************/
 
+/** Statistics of a block in a data file.
+ *
+ * Stored in a separate file next to the data file index (with the suffix
+ * ".stat" instead of ".idx"), one record per index record, so that
+ * minimum and maximum of a time range can be determined without
+ * decompressing the blocks. Older chunks have no statistics files.
+ */
+struct IndexStatRecord
+{
+    double min; /**< Minimum value. */
+    double max; /**< Maximum value. */
+    double mean; /**< Arithmetic mean. */
+    uint32_t count; /**< Number of values. */
+};
+
+/*****************************************************************************/
+
 /**
    Index fr alle Datendateien eines Chunks
 */
@@ -175,6 +219,22 @@ struct ChannelIndexRecord
     uint64_t end_time;
 };
 
+/*****************************************************************************/
+
+/** Header of a block in a data file with binary block format.
+ *
+ * The header is directly followed by \a size bytes of compressed payload.
+ */
+struct BlockHeader
+{
+    uint32_t magic; /**< DLS_BLOCK_MAGIC */
+    uint64_t start_time; /**< Time of the first value, 0 for a flushed rest
+                           block. */
+    uint32_t length; /**< Number of values, 0 for a flushed rest block. */
+    uint32_t size; /**< Size of the payload in bytes. */
+    uint32_t checksum; /**< CRC-32 of the payload. */
+};
+
 #pragma pack(pop)
 
 /*****************************************************************************/
@@ -195,6 +255,22 @@ std::string convert_to_bin(const void *, unsigned int, int);
 
 /*****************************************************************************/
 
+/** Statistics of the decoded block cache.
+ */
+struct BlockCacheStats
+{
+    uint64_t hits; /**< Blocks taken from the cache. */
+    uint64_t misses; /**< Blocks that had to be read and decoded. */
+    size_t size; /**< Current memory usage in bytes. */
+    size_t limit; /**< Maximum memory usage in bytes. */
+    unsigned int blocks; /**< Number of cached blocks. */
+};
+
+void set_block_cache_size(size_t);
+BlockCacheStats block_cache_stats();
+
+/*****************************************************************************/
+
 } // namespace
 
 /*****************************************************************************/
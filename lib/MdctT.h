@@ -21,11 +21,13 @@
 #define LibDLSMDCTTH
 
 #include <math.h>
+#include <stdlib.h> // abs()
 
 #include "LibDLS/globals.h"
 #include "LibDLS/Exception.h"
 
 #include "mdct.h"
+#include "BitStream.h"
 
 /*****************************************************************************/
 
@@ -99,6 +101,9 @@ private:
     unsigned int _mdct_output_size; /**< Bytes im Ausgabespeicher MDCT */
     T *_imdct_output;                  /**< Ausgabespeicher fr IMDCT */
     unsigned int _imdct_output_length; /**< Werte im Ausgabespeicher IMDCT */
+    T *_imdct_buffer; /**< Arbeitsspeicher fr IMDCT (_dim / 2 Werte mehr
+                         als der Ausgabespeicher) */
+    unsigned int _imdct_capacity; /**< Gre des Ausgabespeichers IMDCT */
     //@}
 
     //@{
@@ -110,10 +115,12 @@ private:
     //@{
     unsigned int _transform_all(const double *, unsigned int, char *);
     void _detransform_all(const char *, unsigned int, T *);
+    void _reserve_imdct(unsigned int);
     //@}
 
-    void _int_quant(const double *, unsigned char, int *, double *, double *);
-    unsigned int _store_quant(unsigned char, int *, char *);
+    void _int_quant(const double *, double, unsigned char, int *, double *,
+                    double *);
+    unsigned int _store_quant(unsigned char, const int *, char *);
 
     MDCTT(); // Privater Default-Konstruktor (soll nicht aufgerufen werden!)
 };
@@ -141,6 +148,8 @@ MDCTT<T>::MDCTT(unsigned int dim, double acc)
     _exp2 = 0;
     _mdct_output = 0;
     _imdct_output = 0;
+    _imdct_buffer = 0;
+    _imdct_capacity = 0;
     _last_tail = 0;
     _first = true;
     _last_length = 0;
@@ -194,6 +203,7 @@ MDCTT<T>::~MDCTT()
     if (_last_tail) delete [] _last_tail;
     if (_mdct_output) delete [] _mdct_output;
     if (_imdct_output) delete [] _imdct_output;
+    if (_imdct_buffer) delete [] _imdct_buffer;
 }
 
 /*****************************************************************************/
@@ -425,7 +435,7 @@ unsigned int MDCTT<T>::_transform_all(const double *input,
     double quant[_dim / 2];
     double coeff_imdct[_dim];
     double quant_imdct[_dim];
-    double max_error, error;
+    double max_error, error, abs_value, max;
     double scale = 0.0;
     unsigned char bits, use_bits, start, end;
 
@@ -462,6 +472,14 @@ unsigned int MDCTT<T>::_transform_all(const double *input,
         // Rcktransformieren
         imdct(_exp2, coeff, coeff_imdct);
 
+        // Maximum ermitteln (hngt nicht von der Bitanzahl ab)
+        max = 0;
+        for (i = 0; i < _dim / 2; i++)
+        {
+            abs_value = fabs(coeff[i]);
+            if (abs_value > max) max = abs_value;
+        }
+
         // Start- und Endpunkt fr Bisektion setzen
         start = 2;
         end = MDCT_MAX_BYTES * 8 - 1;
@@ -474,7 +492,7 @@ unsigned int MDCTT<T>::_transform_all(const double *input,
             bits = (end - start + 1) / 2 + start;
 
             // Koeffizienten quantisieren
-            _int_quant(coeff, bits, intquant, quant, &scale);
+            _int_quant(coeff, max, bits, intquant, quant, &scale);
 
             // IMDCT mit quantisierten Koeffizienten
             imdct(_exp2, quant, quant_imdct);
@@ -570,6 +588,7 @@ unsigned int MDCTT<T>::_transform_all(const double *input,
    reprsentiert.
 
    \param koeff Array mit _dim / 2 Koeffizienten
+   \param max Betragsmaximum der Koeffizienten
    \param bits Anzahl Bits, auf die Quantisiert werden soll
    \param intquant Array mit _dim / 2 Integern zur Ablage
    der Integer-Koeffizienten
@@ -581,24 +600,17 @@ unsigned int MDCTT<T>::_transform_all(const double *input,
 
 template <class T>
 void MDCTT<T>::_int_quant(const double *koeff,
-                             unsigned char bits,
-                             int *intquant,
-                             double *quant,
-                             double *scale)
+                          double max,
+                          unsigned char bits,
+                          int *intquant,
+                          double *quant,
+                          double *scale)
 {
     unsigned int i;
-    double abs_value, max = 0;
 
     // Division durch 0 verhindern
     if (bits < 2) return;
 
-    // Maximum ermitteln
-    for (i = 0; i < _dim / 2; i++)
-    {
-        abs_value = fabs(koeff[i]);
-        if (abs_value > max) max = abs_value;
-    }
-
     // Skalierung berechnen
     *scale = 2 * max / ((1 << bits) - 1);
 
@@ -624,15 +636,12 @@ void MDCTT<T>::_int_quant(const double *koeff,
 
 template <class T>
 unsigned int MDCTT<T>::_store_quant(unsigned char bits,
-                                       int *intquant,
-                                       char *output)
+                                    const int *intquant,
+                                    char *output)
 {
-    unsigned int current_byte, bits_free, i;
+    unsigned int i, j, count, byte;
     unsigned char b;
-
-    current_byte = 0;
-    bits_free = 8;
-    output[current_byte] = 0;
+    BitWriter writer(output);
 
 #ifdef MDCT_DEBUG
     {
@@ -642,52 +651,31 @@ unsigned int MDCTT<T>::_store_quant(unsigned char bits,
     }
 #endif
 
-    // Zuerst die Vorzeichenbits hintereinander an den Anfang schreiben
-    for (i = 0; i < _dim / 2; i++)
+    // Zuerst die Vorzeichenbits hintereinander an den Anfang schreiben,
+    // jeweils 8 Koeffizienten pro Byte
+    for (i = 0; i < _dim / 2; i += 8)
     {
-        if (intquant[i] < 0)
-        {
-            output[current_byte] |= 1 << (7 - (i % 8));
-            intquant[i] *= -1;
-        }
-
-#ifdef MDCT_DEBUG
-        {
-            stringstream msg;
-            msg << convert_to_bin(&intquant[i], sizeof(int), -sizeof(int))
-                << " " << intquant[i];
-            log(msg.str());
-        }
-#endif
-
-        if (--bits_free == 0)
-        {
-            current_byte++;
-            output[current_byte] = 0;
-            bits_free = 8;
-        }
+        count = _dim / 2 - i < 8 ? _dim / 2 - i : 8;
+        byte = 0;
+        for (j = 0; j < count; j++)
+            byte = (byte << 1) | (intquant[i + j] < 0);
+        writer.write(byte, count);
     }
 
     // Nun die quantisierten Koeffizienten "transponiert" speichern
     for (b = bits; b > 0; b--)
     {
-        for (i = 0; i < _dim / 2; i++)
+        for (i = 0; i < _dim / 2; i += 8)
         {
-            if (!bits_free)
-            {
-                current_byte++;
-                output[current_byte] = 0;
-                bits_free = 8;
-            }
-
-            if (intquant[i] & (1 << (b - 1)))
-                output[current_byte] |= 1 << (bits_free - 1);
-
-            bits_free--;
+            count = _dim / 2 - i < 8 ? _dim / 2 - i : 8;
+            byte = 0;
+            for (j = 0; j < count; j++)
+                byte = (byte << 1) | ((abs(intquant[i + j]) >> (b - 1)) & 1);
+            writer.write(byte, count);
         }
     }
 
-    return current_byte + 1;
+    return writer.finish();
 }
 
 /*****************************************************************************/
@@ -793,22 +781,8 @@ void MDCTT<T>::detransform(const char *input,
     log(msg.str());
 #endif
 
-    if (_imdct_output)
-    {
-        // Den alten Ausgabepuffer freigeben
-        delete [] _imdct_output;
-        _imdct_output = 0;
-    }
-
-    try
-    {
-        _imdct_output = new T[blocks_of_dim * _dim];
-        mdct_buffer = new T[_dim / 2 + blocks_of_dim * _dim];
-    }
-    catch (...)
-    {
-        throw EMDCT("Could not allocate memory for buffers!");
-    }
+    _reserve_imdct(blocks_of_dim * _dim);
+    mdct_buffer = _imdct_buffer;
 
     // Die letzte, halbe Dimension der letzten
     // Rcktransformation in den Puffer kopieren
@@ -861,13 +835,6 @@ void MDCTT<T>::detransform(const char *input,
         _last_tail[i] = mdct_buffer[blocks_of_dim * _dim + i];
     }
 
-#ifdef MDCT_DEBUG
-    msg << "Deleting mdct buffer.";
-    log(msg.str());
-#endif
-
-    delete [] mdct_buffer;
-
     _first = false;
     _last_length = input_length;
 }
@@ -879,7 +846,7 @@ void MDCTT<T>::_detransform_all(const char *input,
                                    unsigned int dct_count,
                                    T *output)
 {
-    unsigned int d, i, current_byte, current_bit;
+    unsigned int d, i, j, count, byte, current_byte;
     char signs[_dim / 2];
     int int_coeff[_dim / 2];
     double coeff[_dim / 2];
@@ -888,18 +855,10 @@ void MDCTT<T>::_detransform_all(const char *input,
     unsigned char bits, b;
 
     current_byte = 0;
-    current_bit = 8;
 
     // Alle inversen DCTs durchfhren
     for (d = 0; d < dct_count; d++)
     {
-        // Wenn ntig zum nchsten, vollen Byte wechseln
-        if (current_bit != 8)
-        {
-            current_byte++;
-            current_bit = 8;
-        }
-
 #ifdef MDCT_DEBUG
         {
             stringstream msg;
@@ -928,18 +887,15 @@ void MDCTT<T>::_detransform_all(const char *input,
         }
 #endif
 
-        // Vorzeichenbits auslesen
-        for (i = 0; i < _dim / 2; i++)
-        {
-            if (*(input + current_byte) & (1 << (current_bit - 1)))
-                signs[i] = -1;
-            else signs[i] = 1;
+        BitReader reader(input + current_byte);
 
-            if (--current_bit == 0)
-            {
-                current_byte++;
-                current_bit = 8;
-            }
+        // Vorzeichenbits auslesen, jeweils 8 Koeffizienten pro Byte
+        for (i = 0; i < _dim / 2; i += 8)
+        {
+            count = _dim / 2 - i < 8 ? _dim / 2 - i : 8;
+            byte = reader.read(count);
+            for (j = 0; j < count; j++)
+                signs[i + j] = (byte >> (count - 1 - j)) & 1 ? -1 : 1;
         }
 
 #ifdef MDCT_DEBUG
@@ -954,19 +910,19 @@ void MDCTT<T>::_detransform_all(const char *input,
 
         for (b = bits; b > 0; b--)
         {
-            for (i = 0; i < _dim / 2; i++)
+            for (i = 0; i < _dim / 2; i += 8)
             {
-                if (input[current_byte] & (1 << (current_bit - 1)))
-                    int_coeff[i] |= 1 << (b - 1);
-
-                if (--current_bit == 0)
-                {
-                    current_byte++;
-                    current_bit = 8;
-                }
+                count = _dim / 2 - i < 8 ? _dim / 2 - i : 8;
+                byte = reader.read(count);
+                for (j = 0; j < count; j++)
+                    int_coeff[i + j] |=
+                        ((byte >> (count - 1 - j)) & 1) << (b - 1);
             }
         }
 
+        // Der nchste DCT beginnt an einer Byte-Grenze
+        current_byte += reader.size();
+
         // Koeffizienten skalieren und mit richtigem Vorzeichen behaften
         for (i = 0; i < _dim / 2; i++)
             coeff[i] = int_coeff[i] * signs[i] * scale;
@@ -1012,22 +968,8 @@ void MDCTT<T>::flush_detransform(const char *input, unsigned int input_size)
     // gibt es keinen berhangblock.
     if ((_last_length % _dim) <= _dim / 2) return;
 
-    if (_imdct_output)
-    {
-        // Den alten Ausgabepuffer freigeben
-        delete [] _imdct_output;
-        _imdct_output = 0;
-    }
-
-    try
-    {
-        _imdct_output = new T[_dim / 2];
-        mdct_buffer = new T[_dim];
-    }
-    catch (...)
-    {
-        throw EMDCT("Could not allocate memory for buffers!");
-    }
+    _reserve_imdct(_dim / 2);
+    mdct_buffer = _imdct_buffer;
 
     // Die letzte, halbe Dimension der letzten
     // Rcktransformation in den Speicher kopieren
@@ -1055,11 +997,52 @@ void MDCTT<T>::flush_detransform(const char *input, unsigned int input_size)
 #ifdef MDCT_DEBUG
     msg << "Flush output_len=" << _imdct_output_length;
     log(msg.str());
-    msg << "Deleting MDCT buffer.";
-    log(msg.str());
 #endif
+}
 
-    delete [] mdct_buffer;
+/*****************************************************************************/
+
+/**
+   Reserviert die Speicher fr die Rcktransformation
+
+   Die Speicher werden nur vergrert und fr alle weiteren
+   Rcktransformationen wiederverwendet.
+
+   \param length Anzahl der Werte im Ausgabespeicher
+   \throw EMDCT Zu wenig Speicher
+*/
+
+template <class T>
+void MDCTT<T>::_reserve_imdct(unsigned int length)
+{
+    if (length <= _imdct_capacity) return;
+
+    if (_imdct_output)
+    {
+        // Den alten Ausgabepuffer freigeben
+        delete [] _imdct_output;
+        _imdct_output = 0;
+    }
+
+    if (_imdct_buffer)
+    {
+        delete [] _imdct_buffer;
+        _imdct_buffer = 0;
+    }
+
+    _imdct_capacity = 0;
+
+    try
+    {
+        _imdct_output = new T[length];
+        _imdct_buffer = new T[_dim / 2 + length];
+    }
+    catch (...)
+    {
+        throw EMDCT("Could not allocate memory for buffers!");
+    }
+
+    _imdct_capacity = length;
 }
 
 /*****************************************************************************/
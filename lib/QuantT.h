@@ -37,6 +37,8 @@ using namespace std;
 #include "LibDLS/globals.h"
 #include "LibDLS/Exception.h"
 
+#include "BitStream.h"
+
 /*****************************************************************************/
 
 namespace LibDLS {
@@ -98,11 +100,19 @@ private:
     T *_dequant_output; /**< Ausgabespeicher Dequantisierung */
     unsigned int _dequant_output_length; /**< Anzahl der Werte im
                                             Ausgabespeicher IMDCT */
+    int *_dequant_quant; /**< Integer-Werte der Dequantisierung */
+    char *_dequant_signs; /**< Vorzeichen der Dequantisierung */
+    unsigned int _dequant_capacity; /**< Anzahl Werte, fr die die
+                                       Dequantisierungs-Puffer
+                                       reserviert sind */
     //@}
 
-    void _int_quant(const T *, unsigned int, unsigned char, int *, double *);
+    double _quant_error(const T *, unsigned int, double) const;
+    void _int_quant(const T *, unsigned int, double, int *) const;
     unsigned int _store_quant(const int *, unsigned int,
                               unsigned char, char *);
+    void _reserve_dequant(unsigned int);
+    void _free_dequant();
 
     QuantT(); // Default-Konstruktor (soll nicht aufgerufen werden!)
 };
@@ -121,6 +131,9 @@ QuantT<T>::QuantT(double acc)
     _accuracy = acc;
     _quant_output = 0;
     _dequant_output = 0;
+    _dequant_quant = 0;
+    _dequant_signs = 0;
+    _dequant_capacity = 0;
 }
 
 /*****************************************************************************/
@@ -153,12 +166,72 @@ void QuantT<T>::free()
         _quant_output = 0;
     }
 
+    _free_dequant();
+}
+
+/*****************************************************************************/
+
+/**
+   Gibt die Puffer der Dequantisierung frei.
+*/
+
+template <class T>
+void QuantT<T>::_free_dequant()
+{
     if (_dequant_output)
     {
         // Den alten Ausgabepuffer freigeben
         delete [] _dequant_output;
         _dequant_output = 0;
     }
+
+    if (_dequant_quant)
+    {
+        delete [] _dequant_quant;
+        _dequant_quant = 0;
+    }
+
+    if (_dequant_signs)
+    {
+        delete [] _dequant_signs;
+        _dequant_signs = 0;
+    }
+
+    _dequant_capacity = 0;
+}
+
+/*****************************************************************************/
+
+/**
+   Reserviert die Puffer der Dequantisierung
+
+   Die Puffer werden nur vergrert und bis zum nchsten Aufruf
+   von free() fr alle weiteren Dequantisierungen wiederverwendet.
+
+   \param length Anzahl der Werte
+   \throw EQuant Zu wenig Speicher
+*/
+
+template <class T>
+void QuantT<T>::_reserve_dequant(unsigned int length)
+{
+    if (length <= _dequant_capacity) return;
+
+    _free_dequant();
+
+    try
+    {
+        _dequant_output = new T[length];
+        _dequant_quant = new int[length];
+        _dequant_signs = new char[length];
+    }
+    catch (...)
+    {
+        _free_dequant();
+        throw EQuant("Could not allocate memory for buffers!");
+    }
+
+    _dequant_capacity = length;
 }
 
 /*****************************************************************************/
@@ -175,7 +248,7 @@ void QuantT<T>::quantize(const T *input, unsigned int input_length)
 {
     unsigned int i, data_size = 0;
     int *quant, offset;
-    double max_error, error;
+    double max_error, abs_value, max;
     double scale = 0.0;
     unsigned char bits, use_bits, start, end;
 
@@ -221,6 +294,14 @@ void QuantT<T>::quantize(const T *input, unsigned int input_length)
 #endif
 #endif
 
+    // Maximum ermitteln (hngt nicht von der Bitanzahl ab)
+    max = 0.0;
+    for (i = 0; i < input_length; i++)
+    {
+        abs_value = fabs(input[i]);
+        if (abs_value > max) max = abs_value;
+    }
+
     // Start- und Endpunkt fr Bisektion setzen
     start = 2;
     end = MDCT_MAX_BYTES * 8 - 1;
@@ -232,16 +313,11 @@ void QuantT<T>::quantize(const T *input, unsigned int input_length)
     {
         bits = (end - start + 1) / 2 + start;
 
-        // Koeffizienten quantisieren
-        _int_quant(input, input_length, bits, quant, &scale);
+        // Skalierung berechnen
+        scale = 2 * max / ((1 << bits) - 1);
 
         // Abweichung berechnen
-        max_error = 0;
-        for (i = 0; i < input_length; i++)
-        {
-            error = fabs(quant[i] * scale - input[i]);
-            if (error > max_error) max_error = error;
-        }
+        max_error = _quant_error(input, input_length, scale);
 
 #ifdef QUANT_DEBUG
         msg() << "Quant with " << (int) bits
@@ -264,6 +340,9 @@ void QuantT<T>::quantize(const T *input, unsigned int input_length)
         }
     }
 
+    // Mit der zuletzt probierten Bitanzahl quantisieren
+    _int_quant(input, input_length, scale, quant);
+
     if (!use_bits) // Der Fehler war immer zu gro
     {
         // Maximale Anzahl Bits zum Quantisieren verwenden
@@ -328,6 +407,42 @@ void QuantT<T>::quantize(const T *input, unsigned int input_length)
 
 /*****************************************************************************/
 
+/**
+   Berechnet den Quantisierungsfehler
+
+   Die Berechnung wird abgebrochen, sobald der Fehler die
+   angestrebte Genauigkeit erreicht.
+
+   \param input        Array von Datenwerten
+   \param input_length Anzahl von Datenwerten im Array
+   \param scale        Skalierungsfaktor
+
+   \return Maximaler Fehler
+*/
+
+template <class T>
+double QuantT<T>::_quant_error(const T *input,
+                               unsigned int input_length,
+                               double scale) const
+{
+    unsigned int i;
+    double error, max_error = 0.0;
+
+    for (i = 0; i < input_length; i++)
+    {
+        error = fabs(((int) round(input[i] / scale)) * scale - input[i]);
+        if (error > max_error)
+        {
+            max_error = error;
+            if (max_error >= _accuracy) break;
+        }
+    }
+
+    return max_error;
+}
+
+/*****************************************************************************/
+
 /**
    Absolute Quantisierung
 
@@ -338,42 +453,24 @@ void QuantT<T>::quantize(const T *input, unsigned int input_length)
 
    \param input        Array von Datenwerten
    \param input_length Anzahl von Datenwerten im Array
-   \param bits         Anzahl Bits, mit denen quantisiert werden soll
+   \param scale        Skalierungsfaktor
    \param quant        Zeiger auf einen Speicherbereich zur Ablage
    der quantisieren Integer-Werte
-   \param scale        Zeiger auf den Skalierungsfaktor (wird whrend
-   der Verarbeitung beschrieben)
 */
 
 template <class T>
 void QuantT<T>::_int_quant(const T *input,
-                              unsigned int input_length,
-                              unsigned char bits,
-                              int *quant,
-                              double *scale)
+                           unsigned int input_length,
+                           double scale,
+                           int *quant) const
 {
     unsigned int i;
-    double abs_value, max;
-
-    // Division durch 0 verhindern
-    if (bits < 2) return;
-
-    // Maximum ermitteln
-    max = 0.0;
-    for (i = 0; i < input_length; i++)
-    {
-        abs_value = fabs(input[i]);
-        if (abs_value > max) max = abs_value;
-    }
-
-    // Skalierung berechnen
-    *scale = 2 * max / ((1 << bits) - 1);
 
     // Alle Koeffizienten skalieren
     for (i = 0; i < input_length; i++)
     {
         // Skalierte Koeffizienten im Integer-Array ablegen
-        quant[i] = (int) round(input[i] / (*scale));
+        quant[i] = (int) round(input[i] / scale);
     }
 }
 
@@ -398,51 +495,35 @@ unsigned int QuantT<T>::_store_quant(const int *quant,
                                         unsigned char bits,
                                         char *output)
 {
-    unsigned int current_byte, bits_free, i;
+    unsigned int i, j, count, byte;
     unsigned char b;
+    BitWriter writer(output);
 
-    current_byte = 0;
-    bits_free = 8;
-    output[current_byte] = 0;
-
-    // Zuerst die Vorzeichenbits hintereinander an den Anfang schreiben
-    for (i = 0; i < length; i++)
+    // Zuerst die Vorzeichenbits hintereinander an den Anfang schreiben,
+    // jeweils 8 Werte pro Byte
+    for (i = 0; i < length; i += 8)
     {
-        if (quant[i] < 0)
-        {
-            output[current_byte] |= 1 << (7 - (i % 8));
-        }
-
-        if (--bits_free == 0)
-        {
-            current_byte++;
-            output[current_byte] = 0;
-            bits_free = 8;
-        }
+        count = length - i < 8 ? length - i : 8;
+        byte = 0;
+        for (j = 0; j < count; j++)
+            byte = (byte << 1) | (quant[i + j] < 0);
+        writer.write(byte, count);
     }
 
     // Nun die quantisierten Werte "transponiert" speichern
     for (b = bits; b > 0; b--)
     {
-        for (i = 0; i < length; i++)
+        for (i = 0; i < length; i += 8)
         {
-            if (!bits_free)
-            {
-                current_byte++;
-                output[current_byte] = 0;
-                bits_free = 8;
-            }
-
-            if (abs(quant[i]) & (1 << (b - 1)))
-            {
-                output[current_byte] |= 1 << (bits_free - 1);
-            }
-
-            bits_free--;
+            count = length - i < 8 ? length - i : 8;
+            byte = 0;
+            for (j = 0; j < count; j++)
+                byte = (byte << 1) | ((abs(quant[i + j]) >> (b - 1)) & 1);
+            writer.write(byte, count);
         }
     }
 
-    return current_byte + 1;
+    return writer.finish();
 }
 
 /*****************************************************************************/
@@ -459,15 +540,13 @@ void QuantT<T>::dequantize(const char *input,
                               unsigned int input_size,
                               unsigned int length)
 {
-    unsigned int i, current_byte, current_bit;
+    unsigned int i, j, count, byte, current_byte;
     stringstream err;
     char *signs;
     int *quant, offset;
     double scale;
     unsigned char bits, b;
 
-    current_byte = 0;
-
 #ifdef QUANT_DEBUG
     msg() << "MDCT::detransform() size="<< input_size
           << " len=" << length;
@@ -478,26 +557,13 @@ void QuantT<T>::dequantize(const char *input,
 
     if (input_size < 2 || length == 0) return; // Keine Daten
 
-    free();
-
-    signs = 0;
-    try
-    {
-        _dequant_output = new T[length];
-        signs = new char[length];
-        quant = new int[length];
-    }
-    catch (...)
-    {
-        if (signs) delete [] signs;
-
-        throw EQuant("Could not allocate memory for buffers!");
-    }
+    _reserve_dequant(length);
+    signs = _dequant_signs;
+    quant = _dequant_quant;
 
     // Dequantisieren
 
     current_byte = 0;
-    current_bit = 8;
 
     // Integer-Koeffizienten mit Nullen vorbelegen
     for (i = 0; i < length; i++) quant[i] = 0;
@@ -519,17 +585,15 @@ void QuantT<T>::dequantize(const char *input,
     log(DLSDebug);
 #endif
 
-    // Vorzeichenbits auslesen
-    for (i = 0; i < length; i++)
-    {
-        if (*(input + current_byte) & (1 << (current_bit - 1))) signs[i] = -1;
-        else signs[i] = 1;
+    BitReader reader(input + current_byte);
 
-        if (--current_bit == 0)
-        {
-            current_byte++;
-            current_bit = 8;
-        }
+    // Vorzeichenbits auslesen, jeweils 8 Werte pro Byte
+    for (i = 0; i < length; i += 8)
+    {
+        count = length - i < 8 ? length - i : 8;
+        byte = reader.read(count);
+        for (j = 0; j < count; j++)
+            signs[i + j] = (byte >> (count - 1 - j)) & 1 ? -1 : 1;
     }
 
 #ifdef QUANT_DEBUG
@@ -541,16 +605,12 @@ void QuantT<T>::dequantize(const char *input,
 
     for (b = bits; b > 0; b--)
     {
-        for (i = 0; i < length; i++)
+        for (i = 0; i < length; i += 8)
         {
-            if (input[current_byte] & (1 << (current_bit - 1)))
-                quant[i] |= 1 << (b - 1);
-
-            if (--current_bit == 0)
-            {
-                current_byte++;
-                current_bit = 8;
-            }
+            count = length - i < 8 ? length - i : 8;
+            byte = reader.read(count);
+            for (j = 0; j < count; j++)
+                quant[i + j] |= ((byte >> (count - 1 - j)) & 1) << (b - 1);
         }
     }
 
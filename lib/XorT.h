@@ -0,0 +1,327 @@
+/******************************************************************************
+ *
+ *  This file is part of the Data Logging Service (DLS).
+ *
+ *  DLS is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  DLS is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with DLS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef LibDLSXorTH
+#define LibDLSXorTH
+
+/*****************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "LibDLS/globals.h"
+#include "LibDLS/Exception.h"
+
+#include "BitStream.h"
+
+/*****************************************************************************/
+
+namespace LibDLS {
+
+/*****************************************************************************/
+
+/**
+   Exception of a XorT object
+*/
+
+class EXor : public Exception
+{
+public:
+    EXor(const std::string &pmsg) : Exception(pmsg) {};
+};
+
+/*****************************************************************************/
+
+/** Lossless XOR coding for floating-point values.
+ *
+ * Each value is XORed with the bit pattern of its predecessor, following
+ * the "Gorilla" time series compression. Slowly changing signals share
+ * sign, exponent and the upper mantissa bits, so only a few meaningful bits
+ * in the middle remain. The first value is stored completely, then per
+ * value, least significant bit first:
+ *
+ * - '0': Same value as the predecessor.
+ * - '1', '0': The meaningful bits fit into the previous window; they are
+ *   stored with the size of that window.
+ * - '1', '1': New window: Number of leading zeros (5 bits, at most 31),
+ *   number of meaningful bits minus one (6 bits) and the meaningful bits.
+ */
+template <class T>
+class XorT
+{
+public:
+    XorT(): _encode_size(0), _decode_length(0) {};
+
+    void encode(const T *, unsigned int);
+    void decode(const char *, unsigned int, unsigned int);
+
+    const char *encode_output() const {
+        return _encode_output.empty() ? 0 : &_encode_output[0];
+    }
+    unsigned int encode_output_size() const { return _encode_size; }
+    const T *decode_output() const {
+        return _decode_output.empty() ? 0 : &_decode_output[0];
+    }
+    unsigned int decode_output_length() const { return _decode_length; }
+
+    void free();
+
+private:
+    std::vector<char> _encode_output; /**< Encoded data. */
+    unsigned int _encode_size; /**< Number of bytes in _encode_output. */
+    std::vector<T> _decode_output; /**< Decoded values. */
+    unsigned int _decode_length; /**< Number of values in
+                                   _decode_output. */
+
+    enum {
+        Bits = 8 * sizeof(T) /**< Number of bits per value. */
+    };
+
+    static uint64_t _to_bits(T);
+    static T _from_bits(uint64_t);
+    static unsigned int _leading_zeros(uint64_t);
+    static unsigned int _trailing_zeros(uint64_t);
+};
+
+/*****************************************************************************/
+
+/** Releases the output buffers.
+ */
+template <class T>
+void XorT<T>::free()
+{
+    std::vector<char>().swap(_encode_output);
+    _encode_size = 0;
+    std::vector<T>().swap(_decode_output);
+    _decode_length = 0;
+}
+
+/*****************************************************************************/
+
+/** Bit pattern of a value.
+ */
+template <class T>
+uint64_t XorT<T>::_to_bits(T value)
+{
+    if (sizeof(T) == sizeof(uint32_t)) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+    else {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+}
+
+/*****************************************************************************/
+
+/** Value from a bit pattern.
+ */
+template <class T>
+T XorT<T>::_from_bits(uint64_t bits)
+{
+    T value;
+
+    if (sizeof(T) == sizeof(uint32_t)) {
+        uint32_t bits32 = (uint32_t) bits;
+        memcpy(&value, &bits32, sizeof(value));
+    }
+    else {
+        memcpy(&value, &bits, sizeof(value));
+    }
+
+    return value;
+}
+
+/*****************************************************************************/
+
+/** Number of leading zero bits within the value width (v != 0).
+ */
+template <class T>
+unsigned int XorT<T>::_leading_zeros(uint64_t v)
+{
+#ifdef __GNUC__
+    return __builtin_clzll(v) - (64 - Bits);
+#else
+    unsigned int count = 0;
+
+    for (uint64_t mask = ((uint64_t) 1) << (Bits - 1); !(v & mask);
+            mask >>= 1) {
+        count++;
+    }
+
+    return count;
+#endif
+}
+
+/*****************************************************************************/
+
+/** Number of trailing zero bits (v != 0).
+ */
+template <class T>
+unsigned int XorT<T>::_trailing_zeros(uint64_t v)
+{
+#ifdef __GNUC__
+    return __builtin_ctzll(v);
+#else
+    unsigned int count = 0;
+
+    while (!(v & 1)) {
+        v >>= 1;
+        count++;
+    }
+
+    return count;
+#endif
+}
+
+/*****************************************************************************/
+
+/** Encodes an array of values.
+ *
+ * The output buffer is kept for further calls until free() is called.
+ */
+template <class T>
+void XorT<T>::encode(
+        const T *input, /**< Values. */
+        unsigned int length /**< Number of values. */
+        )
+{
+    uint64_t prev, value, diff;
+    unsigned int i, lead, trail, win_lead = Bits, win_trail = 0, win_len;
+
+    _encode_size = 0;
+
+    if (!length) {
+        return;
+    }
+
+    // worst case: 2 + 5 + 6 control bits and all bits per value
+    _encode_output.resize((size_t) length * (Bits + 13) / 8 + 1);
+
+    BitPacker writer(&_encode_output[0]);
+
+    prev = _to_bits(input[0]);
+    writer.write(prev, Bits);
+
+    for (i = 1; i < length; i++) {
+        value = _to_bits(input[i]);
+        diff = value ^ prev;
+        prev = value;
+
+        if (!diff) {
+            writer.write(0, 1);
+            continue;
+        }
+
+        lead = _leading_zeros(diff);
+        if (lead > 31) {
+            lead = 31;
+        }
+        trail = _trailing_zeros(diff);
+
+        if (lead >= win_lead && trail >= win_trail) {
+            // meaningful bits fit into the previous window
+            writer.write(1, 1);
+            writer.write(0, 1);
+            win_len = Bits - win_lead - win_trail;
+            writer.write(diff >> win_trail, win_len);
+        }
+        else {
+            win_lead = lead;
+            win_trail = trail;
+            win_len = Bits - lead - trail;
+            writer.write(1, 1);
+            writer.write(1, 1);
+            writer.write(lead, 5);
+            writer.write(win_len - 1, 6);
+            writer.write(diff >> trail, win_len);
+        }
+    }
+
+    _encode_size = writer.finish();
+}
+
+/*****************************************************************************/
+
+/** Decodes data created by encode().
+ *
+ * The output buffer is kept for further calls until free() is called.
+ *
+ * \throw EXor Invalid data.
+ * \throw EBitStream Truncated data.
+ */
+template <class T>
+void XorT<T>::decode(
+        const char *input, /**< Encoded data. */
+        unsigned int size, /**< Size of the encoded data in bytes. */
+        unsigned int length /**< Expected number of values. */
+        )
+{
+    uint64_t prev;
+    unsigned int i, win_lead = Bits, win_len = 0, win_trail = 0;
+    BitUnpacker reader(input, size);
+
+    _decode_length = 0;
+
+    if (!length) {
+        return;
+    }
+
+    if (_decode_output.size() < length) {
+        _decode_output.resize(length);
+    }
+
+    prev = reader.read(Bits);
+    _decode_output[0] = _from_bits(prev);
+
+    for (i = 1; i < length; i++) {
+        if (reader.read(1)) {
+            if (reader.read(1)) {
+                win_lead = reader.read(5);
+                win_len = reader.read(6) + 1;
+                if (win_lead + win_len > Bits) {
+                    throw EXor("Invalid window!");
+                }
+                win_trail = Bits - win_lead - win_len;
+            }
+            else if (!win_len) {
+                throw EXor("Missing window!");
+            }
+
+            prev ^= reader.read(win_len) << win_trail;
+        }
+
+        _decode_output[i] = _from_bits(prev);
+    }
+
+    _decode_length = length;
+}
+
+/*****************************************************************************/
+
+} // namespace
+
+/*****************************************************************************/
+
+#endif
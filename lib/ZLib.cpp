@@ -40,6 +40,7 @@ ZLib::ZLib()
 {
     _out_buf = 0;
     _out_size = 0;
+    _out_capacity = 0;
 }
 
 /*****************************************************************************/
@@ -62,6 +63,7 @@ ZLib::~ZLib()
 void ZLib::free()
 {
     _out_size = 0;
+    _out_capacity = 0;
 
     if (_out_buf)
     {
@@ -72,6 +74,39 @@ void ZLib::free()
 
 /*****************************************************************************/
 
+/**
+   Stellt einen Ausgabepuffer der angegebenen Gre bereit
+
+   Der Puffer wird nur vergrert und bis zum nchsten Aufruf
+   von free() fr alle weiteren Aufrufe wiederverwendet.
+
+   \param size Bentigte Gre in Bytes
+   \throw EZLib Zu wenig Speicher
+*/
+
+void ZLib::_reserve(unsigned int size)
+{
+    stringstream err;
+
+    if (size <= _out_capacity) return;
+
+    free();
+
+    try
+    {
+        _out_buf = new char[size];
+    }
+    catch (...)
+    {
+        err << "Could not allocate " << size << " bytes!";
+        throw EZLib(err.str());
+    }
+
+    _out_capacity = size;
+}
+
+/*****************************************************************************/
+
 /**
    Komprimieren von Daten
 
@@ -89,7 +124,7 @@ void ZLib::compress(const char *src, unsigned int src_size)
     int comp_ret;
     stringstream err;
 
-    free();
+    _out_size = 0;
 
     // Keine Daten - Nichts zu komprimieren
     if (!src_size) {
@@ -101,15 +136,7 @@ void ZLib::compress(const char *src, unsigned int src_size)
     // http://www.gzip.org/zlib/manual.html#compress
     out_size = (uLongf) (src_size * 1.01 + 12 + 0.5);
 
-    try
-    {
-        _out_buf = new char[out_size];
-    }
-    catch (...)
-    {
-        err << "Could not allocate " << out_size << " bytes!";
-        throw EZLib(err.str());
-    }
+    _reserve(out_size);
 
     // Komprimieren
     comp_ret = ::compress((Bytef *) _out_buf, &out_size,
@@ -157,15 +184,7 @@ void ZLib::uncompress(const char *src, unsigned int src_size,
     // Keine Eingabedaten - keine Dekompression
     if (!src_size) return;
 
-    try
-    {
-        _out_buf = new char[out_size];
-    }
-    catch (...)
-    {
-        err << "Could not allocate " << out_size << " bytes!";
-        throw EZLib(err.str());
-    }
+    _reserve(out_size);
 
     // Dekomprimieren
     uncomp_ret = ::uncompress((Bytef *) _out_buf, &zlib_out_size,
@@ -66,6 +66,9 @@ public:
 private:
     char *_out_buf;         /**< Ausgabepuffer */
     unsigned int _out_size; /**< Lnge der datem im Ausgabepuffer */
+    unsigned int _out_capacity; /**< Gre des Ausgabepuffers */
+
+    void _reserve(unsigned int);
 };
 
 /*****************************************************************************/
@@ -0,0 +1,300 @@
+/******************************************************************************
+ *
+ *  This file is part of the Data Logging Service (DLS).
+ *
+ *  DLS is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  DLS is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with DLS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "config.h"
+
+#ifdef DLS_ZSTD
+#include <zstd.h>
+
+#ifndef ZSTD_CLEVEL_DEFAULT // before zstd 1.3.5
+#define ZSTD_CLEVEL_DEFAULT 3
+#endif
+#endif
+
+#include <sstream>
+using namespace std;
+
+#include "ZStd.h"
+
+using namespace LibDLS;
+
+/*****************************************************************************/
+
+#ifndef DLS_ZSTD
+#define DLS_ZSTD_MISSING "Built without zstd support!"
+#endif
+
+/*****************************************************************************/
+
+/** Constructor.
+ */
+ZStd::ZStd():
+    _out_buf(0),
+    _out_size(0),
+    _out_capacity(0),
+    _level(0),
+    _cctx(0),
+    _dctx(0),
+    _cdict(0),
+    _ddict(0)
+{
+}
+
+/*****************************************************************************/
+
+/** Destructor.
+ */
+ZStd::~ZStd()
+{
+    free();
+    _free_dictionary();
+
+#ifdef DLS_ZSTD
+    ZSTD_freeCCtx(_cctx);
+    ZSTD_freeDCtx(_dctx);
+#endif
+}
+
+/*****************************************************************************/
+
+/** Returns true, if the library was built with zstd support.
+ */
+bool ZStd::available()
+{
+#ifdef DLS_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*****************************************************************************/
+
+/** Releases the output buffer.
+ *
+ * Contexts and dictionary are kept.
+ */
+void ZStd::free()
+{
+    _out_size = 0;
+    _out_capacity = 0;
+
+    if (_out_buf) {
+        delete [] _out_buf;
+        _out_buf = 0;
+    }
+}
+
+/*****************************************************************************/
+
+/** Releases the digested dictionaries.
+ */
+void ZStd::_free_dictionary()
+{
+#ifdef DLS_ZSTD
+    ZSTD_freeCDict(_cdict);
+    ZSTD_freeDDict(_ddict);
+#endif
+    _cdict = 0;
+    _ddict = 0;
+}
+
+/*****************************************************************************/
+
+/** Sets the compression level.
+ *
+ * 0 selects the zstd default level.
+ */
+void ZStd::set_level(int level)
+{
+    if (level != _level) {
+        _level = level;
+
+        // the compression dictionary is digested for a certain level
+#ifdef DLS_ZSTD
+        ZSTD_freeCDict(_cdict);
+#endif
+        _cdict = 0;
+    }
+}
+
+/*****************************************************************************/
+
+/** Sets the dictionary to use for compression and decompression.
+ *
+ * An empty string disables the dictionary. The dictionary is digested on
+ * first use.
+ */
+void ZStd::set_dictionary(const string &dictionary)
+{
+    if (dictionary != _dictionary) {
+        _free_dictionary();
+        _dictionary = dictionary;
+    }
+}
+
+/*****************************************************************************/
+
+/** Provides an output buffer of at least the given size.
+ *
+ * The buffer is only enlarged and reused until free() is called.
+ *
+ * \throw EZStd Out of memory.
+ */
+void ZStd::_reserve(unsigned int size)
+{
+    stringstream err;
+
+    if (size <= _out_capacity) {
+        return;
+    }
+
+    free();
+
+    try {
+        _out_buf = new char[size];
+    }
+    catch (...) {
+        err << "Could not allocate " << size << " bytes!";
+        throw EZStd(err.str());
+    }
+
+    _out_capacity = size;
+}
+
+/*****************************************************************************/
+
+/** Compresses data into the output buffer.
+ *
+ * \throw EZStd Compression failed.
+ */
+void ZStd::compress(
+        const char *src, /**< Data to compress. */
+        unsigned int src_size /**< Size of \a src in bytes. */
+        )
+{
+#ifdef DLS_ZSTD
+    stringstream err;
+    size_t ret;
+
+    _out_size = 0;
+
+    if (!src_size) {
+        return;
+    }
+
+    if (!_cctx && !(_cctx = ZSTD_createCCtx())) {
+        throw EZStd("Failed to create compression context!");
+    }
+
+    if (!_dictionary.empty() && !_cdict) {
+        _cdict = ZSTD_createCDict(_dictionary.data(), _dictionary.size(),
+                _level ? _level : ZSTD_CLEVEL_DEFAULT);
+        if (!_cdict) {
+            throw EZStd("Failed to load dictionary!");
+        }
+    }
+
+    _reserve(ZSTD_compressBound(src_size));
+
+    if (_cdict) {
+        ret = ZSTD_compress_usingCDict(_cctx, _out_buf, _out_capacity,
+                src, src_size, _cdict);
+    }
+    else {
+        ret = ZSTD_compressCCtx(_cctx, _out_buf, _out_capacity,
+                src, src_size, _level ? _level : ZSTD_CLEVEL_DEFAULT);
+    }
+
+    if (ZSTD_isError(ret)) {
+        err << "Compression failed: " << ZSTD_getErrorName(ret)
+            << ", src_size=" << src_size;
+        throw EZStd(err.str());
+    }
+
+    _out_size = ret;
+#else
+    throw EZStd(DLS_ZSTD_MISSING);
+#endif
+}
+
+/*****************************************************************************/
+
+/** Uncompresses data into the output buffer.
+ *
+ * \throw EZStd Decompression failed.
+ */
+void ZStd::uncompress(
+        const char *src, /**< Compressed data. */
+        unsigned int src_size, /**< Size of \a src in bytes. */
+        unsigned int out_size /**< Expected size of the uncompressed data in
+                                bytes. */
+        )
+{
+#ifdef DLS_ZSTD
+    stringstream err;
+    size_t ret;
+
+    _out_size = 0;
+
+    if (!src_size) {
+        return;
+    }
+
+    if (!_dctx && !(_dctx = ZSTD_createDCtx())) {
+        throw EZStd("Failed to create decompression context!");
+    }
+
+    if (!_dictionary.empty() && !_ddict) {
+        _ddict = ZSTD_createDDict(_dictionary.data(), _dictionary.size());
+        if (!_ddict) {
+            throw EZStd("Failed to load dictionary!");
+        }
+    }
+
+    _reserve(out_size);
+
+    if (_ddict) {
+        ret = ZSTD_decompress_usingDDict(_dctx, _out_buf, out_size,
+                src, src_size, _ddict);
+    }
+    else {
+        ret = ZSTD_decompressDCtx(_dctx, _out_buf, out_size,
+                src, src_size);
+    }
+
+    if (ZSTD_isError(ret)) {
+        err << "Decompression failed: " << ZSTD_getErrorName(ret)
+            << ", out_size=" << out_size << ", src_size=" << src_size;
+        throw EZStd(err.str());
+    }
+
+    if (ret != out_size) {
+        err << "Decompressed " << ret << " instead of " << out_size
+            << " bytes!";
+        throw EZStd(err.str());
+    }
+
+    _out_size = out_size;
+#else
+    throw EZStd(DLS_ZSTD_MISSING);
+#endif
+}
+
+/*****************************************************************************/
@@ -0,0 +1,104 @@
+/******************************************************************************
+ *
+ *  This file is part of the Data Logging Service (DLS).
+ *
+ *  DLS is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  DLS is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with DLS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef LibDLSZStdH
+#define LibDLSZStdH
+
+/*****************************************************************************/
+
+#include <string>
+
+#include "LibDLS/Exception.h"
+
+/*****************************************************************************/
+
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+
+namespace LibDLS {
+
+/*****************************************************************************/
+
+/**
+   Exception of a ZStd object
+*/
+
+class EZStd : public Exception
+{
+public:
+    EZStd(const std::string &pmsg) : Exception(pmsg) {};
+};
+
+/*****************************************************************************/
+
+/** Zstandard compression class.
+ *
+ * Same interface as ZLib, with an adjustable compression level and an
+ * optional dictionary. The contexts and the digested dictionary are kept
+ * over all calls, so small blocks do not pay for their setup.
+ *
+ * If the library was built without zstd support, all methods except
+ * free() throw EZStd.
+ */
+class ZStd
+{
+public:
+    ZStd();
+    ~ZStd();
+
+    void set_level(int);
+    void set_dictionary(const std::string &);
+
+    void compress(const char *, unsigned int);
+    void uncompress(const char *, unsigned int, unsigned int);
+
+    const char *output() const { return _out_buf; }
+    unsigned int output_size() const { return _out_size; }
+
+    void free();
+
+    static bool available();
+
+private:
+    char *_out_buf; /**< Output buffer. */
+    unsigned int _out_size; /**< Number of bytes in the output buffer. */
+    unsigned int _out_capacity; /**< Size of the output buffer. */
+    int _level; /**< Compression level (0 is the zstd default). */
+    std::string _dictionary; /**< Dictionary contents. */
+    ZSTD_CCtx_s *_cctx; /**< Compression context. */
+    ZSTD_DCtx_s *_dctx; /**< Decompression context. */
+    ZSTD_CDict_s *_cdict; /**< Digested dictionary for compression. */
+    ZSTD_DDict_s *_ddict; /**< Digested dictionary for decompression. */
+
+    void _reserve(unsigned int);
+    void _free_dictionary();
+
+    ZStd(const ZStd &); // not to be used
+    ZStd &operator=(const ZStd &); // not to be used
+};
+
+/*****************************************************************************/
+
+} // namespace
+
+/*****************************************************************************/
+
+#endif
@@ -69,11 +69,39 @@ const char *format_strings[FORMAT_COUNT] =
 {
     "ZLib/Base64",
     "MDCT/ZLib/Base64",
-    "Quant/ZLib/Base64"
+    "Quant/ZLib/Base64",
+    "Delta/Base64",
+    "XOR/Base64",
+    "ZStd/Base64"
 };
 
 /*****************************************************************************/
 
+const char *block_format_strings[BlockFormatCount] =
+{
+    "xml",
+    "binary"
+};
+
+/*****************************************************************************/
+
+/** Converts a block format string from chunk.xml or a channel preset.
+ *
+ * \return The block format, or BlockFormatCount, if unknown.
+ */
+BlockFormat str_to_block_format(const string &str)
+{
+    for (int i = 0; i < BlockFormatCount; i++) {
+        if (str == block_format_strings[i]) {
+            return (BlockFormat) i;
+        }
+    }
+
+    return BlockFormatCount;
+}
+
+/*****************************************************************************/
+
 string meta_type_str(MetaType meta_type)
 {
     switch (meta_type) {
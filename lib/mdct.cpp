@@ -19,14 +19,18 @@
 
 #include <stdlib.h>
 #include <math.h>
+#include <pthread.h>
 #include <fftw3.h>
 
+#include <new> // bad_alloc
+
 //#define DEBUG
 
 #ifdef DEBUG
 #include <stdio.h>
 #endif
 
+#include "LibDLS/globals.h"
 #include "mdct.h"
 
 /*****************************************************************************/
@@ -39,26 +43,129 @@ static int global_buffers_initialized = 0;
 static double *sin_win_buffer[MDCT_MAX_EXP2 + 1];
 static double *w_r[MDCT_MAX_EXP2 + 1];
 static double *w_i[MDCT_MAX_EXP2 + 1];
+static fftw_plan plan[MDCT_MAX_EXP2 + 1]; /**< FFT-Plne (Dimension / 4) */
 static double pi;
 
+/** Schtzt die globalen Puffer und den FFTW-Planer, der nicht
+ * thread-sicher ist. */
+static pthread_mutex_t global_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Schlssel fr die thread-lokalen Arbeitspuffer. */
+static pthread_key_t scratch_key;
+static pthread_once_t scratch_key_once = PTHREAD_ONCE_INIT;
+
+/*****************************************************************************/
+
+/** Arbeitspuffer fr mdct() und imdct(), ausgelegt fr die grte
+ * Dimension.
+ */
+struct Scratch
+{
+    double *rot;
+    double *c_r;
+    double *c_i;
+    fftw_complex *in;
+    fftw_complex *out;
+};
+
+/*****************************************************************************/
+
+static void scratch_free(void *ptr)
+{
+    Scratch *s = (Scratch *) ptr;
+
+    free(s->rot);
+    free(s->c_r);
+    free(s->c_i);
+    fftw_free(s->in);
+    fftw_free(s->out);
+    free(s);
+}
+
+/*****************************************************************************/
+
+static void scratch_key_create()
+{
+    pthread_key_create(&scratch_key, scratch_free);
+}
+
+/*****************************************************************************/
+
+/** Liefert die Arbeitspuffer des aufrufenden Threads.
+ *
+ * Die Puffer werden beim ersten Aufruf eines Threads reserviert und bei
+ * dessen Ende freigegeben.
+ *
+ * \throw std::bad_alloc Kein Speicher verfgbar.
+ */
+static Scratch *scratch_get()
+{
+    const unsigned int max_dim = 1 << MDCT_MAX_EXP2;
+    Scratch *s;
+
+    pthread_once(&scratch_key_once, scratch_key_create);
+
+    if ((s = (Scratch *) pthread_getspecific(scratch_key))) {
+        return s;
+    }
+
+    if (!(s = (Scratch *) malloc(sizeof(Scratch)))) {
+        throw std::bad_alloc();
+    }
+
+    s->rot = (double *) malloc(sizeof(double) * max_dim);
+    s->c_r = (double *) malloc(sizeof(double) * max_dim / 4);
+    s->c_i = (double *) malloc(sizeof(double) * max_dim / 4);
+    s->in = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * max_dim / 4);
+    s->out = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * max_dim / 4);
+
+    if (!s->rot || !s->c_r || !s->c_i || !s->in || !s->out
+            || pthread_setspecific(scratch_key, s)) {
+        scratch_free(s);
+        throw std::bad_alloc();
+    }
+
+    return s;
+}
+
 /*****************************************************************************/
 
 /**
    Initialisiert die Puffer fr eine Dimension, die durch eine
    Zweierpotenz gegeben ist.
 
+   Erstellt auch den FFT-Plan fr die Dimension. Beim ersten Aufruf
+   wird FFTW-Wisdom aus der Datei gelesen, die in der Umgebungsvariablen
+   DLS_FFTW_WISDOM angegeben ist, falls gesetzt.
+
    \param exp2 Zweierexponent der Dimension
 
    \return 0 bei Erfolg, sonst negativer Fehlercode
 */
 
+static int mdct_init_locked(unsigned int);
+
 int mdct_init(unsigned int exp2)
 {
-    unsigned int i, dim;
+    int ret;
 
     /* Dimension muss im gltigen Bereich liegen! */
     if (exp2 < MDCT_MIN_EXP2 || exp2 > MDCT_MAX_EXP2) return -1;
 
+    pthread_mutex_lock(&global_mutex);
+    ret = mdct_init_locked(exp2);
+    pthread_mutex_unlock(&global_mutex);
+
+    return ret;
+}
+
+/*****************************************************************************/
+
+static int mdct_init_locked(unsigned int exp2)
+{
+    unsigned int i, dim;
+    const char *wisdom;
+
     /* Dimension berechnen */
     dim = 1 << exp2;
 
@@ -78,11 +185,18 @@ int mdct_init(unsigned int exp2)
             sin_win_buffer[i] = 0;
             w_r[i] = 0;
             w_i[i] = 0;
+            plan[i] = 0;
         }
 
         // Pi bestimmen
         pi = 4.0 * atan(1.0);
 
+        // Gespeichertes Planungswissen bernehmen
+        if ((wisdom = getenv(ENV_DLS_FFTW_WISDOM)) && *wisdom)
+        {
+            fftw_import_wisdom_from_filename(wisdom);
+        }
+
         global_buffers_initialized = 1;
     }
 
@@ -121,6 +235,27 @@ int mdct_init(unsigned int exp2)
             w_i[exp2][i] = - sin(2 * pi * (i + 1.0 / 8) / dim);
     }
 
+    if (!plan[exp2])
+    {
+        /* FFT-Plan erstellen. Die Puffer werden dabei berschrieben, die
+           Ausfhrung erfolgt mit den Arbeitspuffern (fftw_execute_dft). */
+        fftw_complex *in, *out;
+
+        in = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * dim / 4);
+        out = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * dim / 4);
+
+        if (in && out)
+        {
+            plan[exp2] = fftw_plan_dft_1d(dim / 4, in, out,
+                    FFTW_FORWARD, FFTW_PATIENT);
+        }
+
+        fftw_free(in);
+        fftw_free(out);
+
+        if (!plan[exp2]) return -6;
+    }
+
     return 0;
 }
 
@@ -137,20 +272,29 @@ void mdct_cleanup()
 {
     unsigned int exp2;
 
-    if (!global_buffers_initialized) return;
+    pthread_mutex_lock(&global_mutex);
+
+    if (!global_buffers_initialized)
+    {
+        pthread_mutex_unlock(&global_mutex);
+        return;
+    }
 
 #ifdef DEBUG
     printf("MDCT: Cleaning global buffers\n");
 #endif
 
-    for (exp2 = MDCT_MIN_EXP2; exp2 < MDCT_MAX_EXP2; exp2++)
+    for (exp2 = MDCT_MIN_EXP2; exp2 <= MDCT_MAX_EXP2; exp2++)
     {
         if (sin_win_buffer[exp2]) free(sin_win_buffer[exp2]);
         if (w_r[exp2]) free(w_r[exp2]);
         if (w_i[exp2]) free(w_i[exp2]);
+        if (plan[exp2]) fftw_destroy_plan(plan[exp2]);
     }
 
     global_buffers_initialized = 0;
+
+    pthread_mutex_unlock(&global_mutex);
 }
 
 /*****************************************************************************/
@@ -167,6 +311,8 @@ void mdct_cleanup()
    \param exp2 Zweierexponent der Dimension
    \param x Input-Speicher mit 2^(exp2) double-Werten
    \param y Output-Speicher fr 2^(exp2)/2 double-Werte
+
+   \throw std::bad_alloc Kein Speicher fr die Arbeitspuffer
 */
 
 void mdct(unsigned int exp2, const double *x, double *y)
@@ -174,19 +320,20 @@ void mdct(unsigned int exp2, const double *x, double *y)
     unsigned int n, n4, m, t;
     double *rot, *c_r, *c_i;
     fftw_complex *in, *out;
-    fftw_plan p;
+    Scratch *s;
 
     // Variablen vorbelegen
     n = 1 << exp2;
     n4 = n / 4;
     m = n / 2;
 
-    // Speicher reservieren
-    rot = (double *) malloc(sizeof(double) * n);
-    c_r = (double *) malloc(sizeof(double) * n4);
-    c_i = (double *) malloc(sizeof(double) * n4);
-    in = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * n4);
-    out = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * n4);
+    // Arbeitspuffer des Threads verwenden
+    s = scratch_get();
+    rot = s->rot;
+    c_r = s->c_r;
+    c_i = s->c_i;
+    in = s->in;
+    out = s->out;
 
     // t = (0:(N4-1)).';
     // rot(t+1,:) = -x(t+3*N4+1,:);
@@ -219,8 +366,7 @@ void mdct(unsigned int exp2, const double *x, double *y)
 
     // c = fft(c, N4);
 
-    p = fftw_plan_dft_1d(n4, in, out, FFTW_FORWARD, FFTW_PATIENT);
-    fftw_execute(p);
+    fftw_execute_dft(plan[exp2], in, out);
 
     // c = (2 / sqrtN) * w * c
 
@@ -245,13 +391,6 @@ void mdct(unsigned int exp2, const double *x, double *y)
         y[m - 2 * t - 1] = -c_i[t];
     }
 
-    // Speicher wieder freigeben
-    free(rot);
-    free(c_r);
-    free(c_i);
-    fftw_destroy_plan(p);
-    fftw_free(in);
-    fftw_free(out);
 }
 
 /*****************************************************************************/
@@ -268,26 +407,29 @@ void mdct(unsigned int exp2, const double *x, double *y)
    \param exp2 Zweierexponent der Dimension
    \param x Input-Speicher mit 2^(exp2)/2 double-Koeffizienten
    \param y Output-Speicher fr 2^(exp2) double-Werte
+
+   \throw std::bad_alloc Kein Speicher fr die Arbeitspuffer
 */
 
 void imdct(unsigned int exp2, const double *x, double *y)
 {
     unsigned int n, m, two_n, t;
     double *c_r, *c_i, *rot;
-    fftw_plan p;
     fftw_complex *in, *out;
+    Scratch *s;
 
     // Variablen vorbelegen
     n = (1 << exp2) / 2;
     m = n / 2;
     two_n = 2 * n;
 
-    // Speicher reservieren
-    c_r = (double *) malloc(sizeof(double) * m);
-    c_i = (double *) malloc(sizeof(double) * m);
-    rot = (double *) malloc(sizeof(double) * two_n);
-    in = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * m);
-    out = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * m);
+    // Arbeitspuffer des Threads verwenden
+    s = scratch_get();
+    c_r = s->c_r;
+    c_i = s->c_i;
+    rot = s->rot;
+    in = s->in;
+    out = s->out;
 
     // t = (0:(M-1)).';
     // c = x(2*t+1,:) + j*x(N-1-2*t+1,:);
@@ -308,8 +450,7 @@ void imdct(unsigned int exp2, const double *x, double *y)
 
     // c = fft(c,M);
 
-    p = fftw_plan_dft_1d(m, in, out, FFTW_FORWARD, FFTW_PATIENT);
-    fftw_execute(p);
+    fftw_execute_dft(plan[exp2], in, out);
 
     // c = (8 / sqrtN) * w * c
 
@@ -350,14 +491,6 @@ void imdct(unsigned int exp2, const double *x, double *y)
     {
         y[t] *= sin_win_buffer[exp2][t];
     }
-
-    // Speicher wieder freigeben
-    free(c_r);
-    free(c_i);
-    free(rot);
-    fftw_destroy_plan(p);
-    fftw_free(in);
-    fftw_free(out);
 }
 
 /*****************************************************************************/
@@ -0,0 +1,298 @@
+/******************************************************************************
+ *
+ *  This file is part of the Data Logging Service (DLS).
+ *
+ *  DLS is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  DLS is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with DLS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include <unistd.h> // getopt()
+#include <stdlib.h> // strtoul()
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+using namespace std;
+
+#include "../config.h"
+
+#ifdef DLS_ZSTD
+#include <zdict.h>
+#endif
+
+#include "lib/LibDLS/Dir.h"
+using namespace LibDLS;
+
+/*****************************************************************************/
+
+extern string dls_dir_path;
+
+static unsigned int job_id = 0;
+static unsigned int channel_index = 0;
+static string output_path;
+static unsigned int dict_size = 112640; // zstd default
+static unsigned int max_sample_bytes = 100 * 1024 * 1024;
+
+/*****************************************************************************/
+
+/** Collected training samples.
+ */
+struct DictSamples {
+    ChannelType type;
+    string data; /**< Concatenated samples. */
+    vector<size_t> sizes; /**< Size of every sample. */
+};
+
+/*****************************************************************************/
+
+void dict_print_usage()
+{
+    cout << "Usage: dls dict [OPTIONS]" << endl;
+    cout << endl;
+    cout << "Description:" << endl;
+    cout << "        Train a dictionary for the ZStd/Base64 format" << endl;
+    cout << "        from the stored blocks of a channel." << endl;
+    cout << endl;
+    cout << "Options:" << endl;
+    cout << "        -d DIR   Specify DLS data directory." << endl;
+    cout << "        -j JOB   Specify job ID." << endl;
+    cout << "        -c IDX   Specify channel index." << endl;
+    cout << "        -o FILE  Output file." << endl;
+    cout << "        -s SIZE  Dictionary size in bytes (default "
+        << dict_size << ")." << endl;
+    cout << "        -m SIZE  Maximum size of the training data in"
+        << " bytes (default " << max_sample_bytes << ")." << endl;
+    cout << "        -h       Print this help." << endl;
+    cout << endl;
+    cout << "Reference the file with the \"dictionary\" attribute of the"
+        << endl;
+    cout << "channel preset. Relative paths refer to the DLS data"
+        << " directory." << endl;
+}
+
+/*****************************************************************************/
+
+void dict_get_options(int argc, char *argv[])
+{
+    int c;
+
+    while (1) {
+        if ((c = getopt(argc, argv, "d:j:c:o:s:m:h")) == -1) break;
+
+        switch (c) {
+            case 'd':
+                dls_dir_path = optarg;
+                break;
+
+            case 'j':
+                job_id = strtoul(optarg, NULL, 10);
+                break;
+
+            case 'c':
+                channel_index = strtoul(optarg, NULL, 10);
+                break;
+
+            case 'o':
+                output_path = optarg;
+                break;
+
+            case 's':
+                dict_size = strtoul(optarg, NULL, 10);
+                break;
+
+            case 'm':
+                max_sample_bytes = strtoul(optarg, NULL, 10);
+                break;
+
+            case 'h':
+                dict_print_usage();
+                exit(0);
+
+            default:
+                dict_print_usage();
+                exit(1);
+        }
+    }
+
+    if (optind < argc) {
+        cerr << "Extra parameter given!" << endl;
+        dict_print_usage();
+        exit(1);
+    }
+
+    if (dls_dir_path == "") {
+        cerr << "No DLS data directory specified!" << endl;
+        dict_print_usage();
+        exit(1);
+    }
+
+    if (!job_id || output_path == "") {
+        cerr << "Job ID and output file are mandatory!" << endl;
+        dict_print_usage();
+        exit(1);
+    }
+
+    if (!dict_size) {
+        cerr << "Invalid dictionary size!" << endl;
+        dict_print_usage();
+        exit(1);
+    }
+}
+
+/*****************************************************************************/
+
+/** Appends the values of a data block in the channel's type.
+ *
+ * Blocks are compressed in the channel's native representation, so the
+ * samples have to be converted back from doubles.
+ */
+template <class T>
+void dict_append(DictSamples *samples, const Data *data)
+{
+    size_t size = data->size() * sizeof(T);
+
+    for (unsigned int i = 0; i < data->size(); i++) {
+        T value = (T) data->value(i);
+        samples->data.append((const char *) &value, sizeof(T));
+    }
+
+    samples->sizes.push_back(size);
+}
+
+/*****************************************************************************/
+
+int dict_data_callback(Data *data, void *cb_data)
+{
+    DictSamples *samples = (DictSamples *) cb_data;
+
+    if (!data->size() || samples->data.size() >= max_sample_bytes) {
+        return 0;
+    }
+
+    switch (samples->type) {
+        case TCHAR: dict_append<char>(samples, data); break;
+        case TUCHAR: dict_append<unsigned char>(samples, data); break;
+        case TSHORT: dict_append<short int>(samples, data); break;
+        case TUSHORT: dict_append<unsigned short int>(samples, data); break;
+        case TINT: dict_append<int>(samples, data); break;
+        case TUINT: dict_append<unsigned int>(samples, data); break;
+        case TLINT: dict_append<long>(samples, data); break;
+        case TULINT: dict_append<unsigned long>(samples, data); break;
+        case TFLT: dict_append<float>(samples, data); break;
+        case TDBL: dict_append<double>(samples, data); break;
+        default: break;
+    }
+
+    return 0; // not adopted
+}
+
+/*****************************************************************************/
+
+#ifdef DLS_ZSTD
+
+int dict_train()
+{
+    Directory dls_dir;
+    Job *job;
+    Channel *channel;
+    DictSamples samples;
+
+    try {
+        dls_dir.set_uri(dls_dir_path);
+        dls_dir.import();
+    }
+    catch (DirectoryException &e) {
+        cerr << "Import failed: " << e.msg << endl;
+        return 1;
+    }
+
+    if (!(job = dls_dir.find_job(job_id))) {
+        cerr << "No such job - " << job_id << "." << endl;
+        cerr << "Call \"dls list\" to list available jobs." << endl;
+        return 1;
+    }
+
+    try {
+        job->fetch_channels();
+    }
+    catch (Exception &e) {
+        cerr << "Failed to fetch channels: " << e.msg << endl;
+        return 1;
+    }
+
+    if (!(channel = job->find_channel(channel_index))) {
+        cerr << "No such channel - " << channel_index << "." << endl;
+        cerr << "Call \"dls list -j " << job_id
+            << "\" to list available channels." << endl;
+        return 1;
+    }
+
+    try {
+        channel->fetch_chunks();
+        samples.type = channel->type();
+        channel->fetch_data(channel->start(), channel->end(), 0,
+                dict_data_callback, &samples);
+    }
+    catch (ChannelException &e) {
+        cerr << "Fetching data failed: " << e.msg << endl;
+        return 1;
+    }
+
+    cout << "Training with " << samples.sizes.size() << " blocks ("
+        << samples.data.size() << " bytes)..." << endl;
+
+    if (samples.sizes.empty()) {
+        cerr << "No data to train with!" << endl;
+        return 1;
+    }
+
+    vector<char> dict(dict_size);
+    size_t ret = ZDICT_trainFromBuffer(&dict[0], dict.size(),
+            samples.data.data(), &samples.sizes[0], samples.sizes.size());
+
+    if (ZDICT_isError(ret)) {
+        cerr << "Training failed: " << ZDICT_getErrorName(ret) << endl;
+        return 1;
+    }
+
+    ofstream file(output_path.c_str(), ios::out | ios::binary);
+    file.write(&dict[0], ret);
+    file.close();
+
+    if (!file) {
+        cerr << "Failed to write \"" << output_path << "\"!" << endl;
+        return 1;
+    }
+
+    cout << "Wrote " << ret << " bytes to \"" << output_path << "\"." << endl;
+    return 0;
+}
+
+#endif
+
+/*****************************************************************************/
+
+int dict_main(int argc, char *argv[])
+{
+    dict_get_options(argc, argv);
+
+#ifdef DLS_ZSTD
+    return dict_train();
+#else
+    cerr << "DLS was built without zstd support!" << endl;
+    return 1;
+#endif
+}
+
+/*****************************************************************************/
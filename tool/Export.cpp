@@ -27,12 +27,15 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
 
 #include <iostream>
 #include <sstream>
 #include <fstream>
 #include <iomanip>
 #include <set>
+#include <vector>
 using namespace std;
 
 #include "lib/LibDLS/Dir.h"
@@ -55,34 +58,76 @@ static Time end_time;
 static unsigned int decimation = 1;
 static bool export_ascii = false;
 static bool export_matlab = false;
+static bool export_columns = false;
 static bool quiet = false;
 static bool export_messages = false;
 static string message_lang;
+static unsigned int parallel_channels = 1;
+static unsigned int memory_budget = 512; // MiB
 
 static unsigned int term_width;
 
 /*****************************************************************************/
 
-typedef struct
+struct ExportChannel {
+    Channel *channel;
+    string filename;
+    double progress; /**< Exported fraction of the time range. */
+    uint64_t block_bytes; /**< Memory of one decoded block, estimated from
+                            the block size of the chunks, or zero, if
+                            unknown. */
+};
+
+/*****************************************************************************/
+
+/** State shared by the export workers.
+ *
+ * A worker only starts exporting the next channel, if the memory reserved
+ * by the channels in progress leaves room for it. A channel reserves the
+ * decoded blocks it may hold at once (the blocks queued in the decoder
+ * plus the one being exported), based on the block size of its chunks, or
+ * on the largest block seen so far, if the block size is unknown. The
+ * reservation grows, if a larger block arrives. A single channel is always
+ * exported, even if it exceeds the budget.
+ */
+struct ExportState
 {
-    list<Export *> *exporters;
-    Time start;
-    double channel_percentage;
-    double channel_factor;
-}
-ExportInfo;
+    pthread_mutex_t mutex; /**< Protects the state. */
+    pthread_cond_t cond; /**< Signals released memory and errors. */
+    vector<ExportChannel> channels; /**< Channels to export. */
+    unsigned int next_channel; /**< Index of the next channel to export. */
+    uint64_t budget; /**< Memory budget in bytes. */
+    uint64_t reserved; /**< Memory reserved by the running exports. */
+    uint64_t block_bytes; /**< Memory of the largest decoded block seen so
+                            far. */
+    unsigned int blocks_per_channel; /**< Blocks held per channel. */
+    double progress_sum; /**< Sum of the channel progresses. */
+    uint64_t values; /**< Number of exported values. */
+    Time started; /**< Wall-clock time of the export start. */
+    Time last_draw; /**< Wall-clock time of the last progress output. */
+    string error; /**< First error. Stops all workers. */
+};
 
 /*****************************************************************************/
 
-struct ExportChannel {
-    Channel *channel;
-    string filename;
+/** Export worker. Exports one channel at a time with its own exporters.
+ */
+struct ExportWorker
+{
+    ExportState *state;
+    list<Export *> exporters;
+    ExportChannel *channel; /**< Channel being exported. */
+    uint64_t reservation; /**< Memory reserved for the channel. */
+    pthread_t thread;
 };
 
 /*****************************************************************************/
 
+void *export_worker(void *);
+void export_channel(ExportWorker *);
 int export_data_callback(Data *, void *);
-void draw_progress(double percentage);
+void update_progress(ExportState *, bool);
+void draw_progress(double percentage, const string &);
 void export_get_options(int, char **);
 void export_print_usage();
 int terminal_width();
@@ -98,10 +143,14 @@ int export_main(int argc, char *argv[])
     list<Channel>::iterator job_channel_i;
     Channel *channel;
     Time channels_start, channels_end, now;
-    list<Export *> exporters;
+    ExportState state;
+    vector<ExportChannel>::iterator state_channel_i;
+    vector<ExportWorker> workers;
+    vector<ExportWorker>::iterator worker_i;
+    vector<ExportWorker>::reverse_iterator worker_ri;
+    ExportColumns *columns = NULL;
     list<Export *>::iterator exp_i;
-    ExportInfo info;
-    unsigned int current_channel, total_channels;
+    unsigned int decoder_threads, started;
     stringstream info_file_name;
     ofstream info_file;
     int ret;
@@ -114,14 +163,7 @@ int export_main(int argc, char *argv[])
         term_width = terminal_width();
     }
 
-    if (export_ascii) {
-        exporters.push_back(new ExportAscii());
-    }
-    if (export_matlab) {
-        exporters.push_back(new ExportMat4());
-    }
-
-    if (exporters.empty()) {
+    if (!export_ascii && !export_matlab && !export_columns) {
         cerr << "ERROR: No exporters active! Enable at least one." << endl;
         export_print_usage();
         exit(1);
@@ -134,6 +176,21 @@ int export_main(int argc, char *argv[])
         exit(1);
     }
 
+    if (parallel_channels > 1
+            && dls_dir.access() == Directory::Network) {
+        // the channels share one server connection
+        cerr << "WARNING: Exporting channels sequentially"
+            << " from network directory." << endl;
+        parallel_channels = 1;
+    }
+
+    // share the CPUs among the channels exported in parallel
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    decoder_threads = cpus > (long) parallel_channels ? cpus / parallel_channels : 1;
+    if (decoder_threads > 1) {
+        dls_dir.set_decoder_threads(decoder_threads);
+    }
+
     try {
         dls_dir.import();
     } catch (DirectoryException &e) {
@@ -301,58 +358,135 @@ int export_main(int argc, char *argv[])
         end_time = channels_end;
     }
 
-    current_channel = 0;
-    total_channels = channels.size();
-
-    info.exporters = &exporters;
-    info.start = start_time;
-    info.channel_percentage = 0.0;
-    info.channel_factor = 100.0 / total_channels
-        / (end_time - start_time).to_dbl();
-
-    // actual exporting
-    for (list<ExportChannel>::const_iterator channel_i = channels.begin();
-         channel_i != channels.end(); channel_i++) {
-        channel = channel_i->channel;
+    pthread_mutex_init(&state.mutex, NULL);
+    pthread_cond_init(&state.cond, NULL);
+    state.channels.assign(channels.begin(), channels.end());
+    for (state_channel_i = state.channels.begin();
+            state_channel_i != state.channels.end(); state_channel_i++) {
+        state_channel_i->progress = 0.0;
 
+        // full resolution: blocks of the generic meta level
+        unsigned int block_size = 0;
         try {
-            for (exp_i = exporters.begin();
-                    exp_i != exporters.end(); exp_i++) {
-                (*exp_i)->begin(*channel, dls_export_dir,
-                        channel_i->filename);
-            }
-        } catch (ExportException &e) {
-            cerr << "ERROR: Beginning export file: " << e.msg << endl;
-            exit(1);
+            block_size = state_channel_i->channel->max_block_size(
+                    start_time, end_time);
+        } catch (ChannelException &e) {
+            // reported by the export
+        }
+        if (decimation > 1) {
+            block_size = (block_size + decimation - 1) / decimation;
         }
+        state_channel_i->block_bytes = (uint64_t) block_size * sizeof(double);
+    }
+    state.next_channel = 0;
+    state.budget = (uint64_t) memory_budget * 1024 * 1024;
+    state.reserved = 0;
+    state.block_bytes = 0;
+    // blocks queued in the decoder (see BlockDecoder) plus the current one
+    state.blocks_per_channel =
+        (decoder_threads > 1 ? 4 * decoder_threads : 0) + 1;
+    state.progress_sum = 0.0;
+    state.values = 0;
+    state.started.set_now();
+
+    if (parallel_channels > state.channels.size()) {
+        parallel_channels = state.channels.size();
+    }
 
-        try {
-            channel->fetch_data(start_time, end_time,
-                                0, export_data_callback, &info, decimation);
-        } catch (ChannelException &e) {
-            cerr << "ERROR: Fetching data: " << e.msg << endl;
-            exit(1);
+    workers.resize(parallel_channels);
+    for (worker_i = workers.begin(); worker_i != workers.end(); worker_i++) {
+        worker_i->state = &state;
+        worker_i->channel = NULL;
+        worker_i->reservation = 0;
+        if (export_ascii) {
+            worker_i->exporters.push_back(new ExportAscii());
         }
+        if (export_matlab) {
+            worker_i->exporters.push_back(new ExportMat4());
+        }
+        if (export_columns) {
+            // one file for all workers
+            if (!columns) {
+                columns = new ExportColumns();
+                worker_i->exporters.push_back(columns);
+            }
+            else {
+                worker_i->exporters.push_back(new ExportColumns(columns));
+            }
+        }
+    }
 
-        try {
-            for (exp_i = exporters.begin(); exp_i != exporters.end(); exp_i++)
-                (*exp_i)->end();
-        } catch (ExportException &e) {
-            cerr << "ERROR: Finishing export file: " << e.msg << endl;
-            exit(1);
+    // actual exporting
+    started = 0;
+    if (workers.size() > 1) {
+        for (worker_i = workers.begin(); worker_i != workers.end();
+                worker_i++) {
+            ret = pthread_create(&worker_i->thread, NULL, export_worker,
+                    &(*worker_i));
+            if (ret) {
+                cerr << "WARNING: Failed to start export thread: "
+                    << strerror(ret) << endl;
+                break;
+            }
+            started++;
         }
+    }
 
-        current_channel++;
+    if (!started) {
+        export_worker(&workers.front());
+    }
+
+    for (unsigned int i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
 
-        if (!quiet) {
-            // display progress
-            info.channel_percentage = 100.0 * current_channel / total_channels;
-            draw_progress(info.channel_percentage);
+    // the first worker owns the shared column file, so finish it last
+    for (worker_ri = workers.rbegin(); worker_ri != workers.rend();
+            worker_ri++) {
+        for (exp_i = worker_ri->exporters.begin();
+                exp_i != worker_ri->exporters.end(); exp_i++) {
+            if (state.error.empty()) {
+                try {
+                    (*exp_i)->finish();
+                } catch (ExportException &e) {
+                    state.error = "Finishing export file: " + e.msg;
+                }
+            }
+            delete *exp_i;
         }
     }
 
+    pthread_cond_destroy(&state.cond);
+    pthread_mutex_destroy(&state.mutex);
+
+    if (!quiet) {
+        update_progress(&state, true);
+    }
+
     cerr << endl;
 
+    if (!state.error.empty()) {
+        cerr << "ERROR: " << state.error << endl;
+        exit(1);
+    }
+
+    {
+        Time finished;
+        finished.set_now();
+        double duration = (finished - state.started).to_dbl_time();
+        stringstream summary;
+
+        summary << "Exported " << state.values << " values in "
+            << fixed << setprecision(1) << duration << " s";
+        if (duration > 0.0) {
+            summary << " (" << setprecision(0) << state.values / duration
+                << " values/s, " << setprecision(1)
+                << state.values * sizeof(double) / duration / 1e6
+                << " MB/s)";
+        }
+        cout << summary.str() << "." << endl;
+    }
+
     if (export_messages) {
         list<LibDLS::Job::Message> msgs;
 
@@ -427,55 +561,198 @@ int export_main(int argc, char *argv[])
 
 /*****************************************************************************/
 
-int export_data_callback(Data *data, void *cb_data)
+/** Export worker thread function.
+ *
+ * Exports channels, until all are done, or an error occurred.
+ */
+void *export_worker(void *arg)
+{
+    ExportWorker *worker = (ExportWorker *) arg;
+    ExportState *state = worker->state;
+    uint64_t reservation = 0;
+
+    while (1) {
+        pthread_mutex_lock(&state->mutex);
+
+        while (state->error.empty()
+                && state->next_channel < state->channels.size()) {
+            const ExportChannel &next =
+                state->channels[state->next_channel];
+            reservation = state->blocks_per_channel *
+                (next.block_bytes ? next.block_bytes : state->block_bytes);
+            if (!state->reserved
+                    || state->reserved + reservation <= state->budget) {
+                break;
+            }
+            pthread_cond_wait(&state->cond, &state->mutex);
+        }
+
+        if (!state->error.empty()
+                || state->next_channel >= state->channels.size()) {
+            pthread_mutex_unlock(&state->mutex);
+            break;
+        }
+
+        worker->channel = &state->channels[state->next_channel++];
+        worker->reservation = reservation;
+        state->reserved += reservation;
+        pthread_mutex_unlock(&state->mutex);
+
+        export_channel(worker);
+
+        pthread_mutex_lock(&state->mutex);
+        state->reserved -= worker->reservation; // may have grown
+        worker->reservation = 0;
+        pthread_cond_broadcast(&state->cond);
+        pthread_mutex_unlock(&state->mutex);
+    }
+
+    return NULL;
+}
+
+/*****************************************************************************/
+
+/** Exports the current channel of a worker.
+ */
+void export_channel(ExportWorker *worker)
 {
-    ExportInfo *info = (ExportInfo *) cb_data;
+    ExportState *state = worker->state;
+    ExportChannel *ec = worker->channel;
+    list<Export *>::iterator exp_i;
+    stringstream err;
+
+    try {
+        for (exp_i = worker->exporters.begin();
+                exp_i != worker->exporters.end(); exp_i++) {
+            (*exp_i)->begin(*ec->channel, dls_export_dir, ec->filename);
+        }
+
+        try {
+            ec->channel->fetch_data(start_time, end_time,
+                    0, export_data_callback, worker, decimation);
+        } catch (ChannelException &e) {
+            err << "Fetching data: " << e.msg;
+        }
+
+        for (exp_i = worker->exporters.begin();
+                exp_i != worker->exporters.end(); exp_i++) {
+            (*exp_i)->end();
+        }
+    } catch (ExportException &e) {
+        err << "Exporting " << ec->filename << ": " << e.msg;
+    }
+
+    pthread_mutex_lock(&state->mutex);
+    if (!err.str().empty() && state->error.empty()) {
+        state->error = err.str();
+        pthread_cond_broadcast(&state->cond);
+    }
+    state->progress_sum += 1.0 - ec->progress;
+    ec->progress = 1.0;
+    if (!quiet) {
+        update_progress(state, false);
+    }
+    pthread_mutex_unlock(&state->mutex);
+}
 
+/*****************************************************************************/
+
+int export_data_callback(Data *data, void *cb_data)
+{
+    ExportWorker *worker = (ExportWorker *) cb_data;
+    ExportState *state = worker->state;
+    ExportChannel *ec = worker->channel;
     list<Export *>::iterator exp_i;
-    double diff_time;
-    double percentage;
+    double progress;
+    uint64_t block_bytes, reservation;
 
-    for (exp_i = info->exporters->begin();
-         exp_i != info->exporters->end();
+    for (exp_i = worker->exporters.begin();
+         exp_i != worker->exporters.end();
          exp_i++)
         (*exp_i)->data(data);
 
+    progress = (data->end_time() - start_time).to_dbl()
+        / (end_time - start_time).to_dbl();
+    if (progress > 1.0) {
+        progress = 1.0;
+    }
+
+    pthread_mutex_lock(&state->mutex);
+    state->values += data->size();
+    block_bytes = data->size() * sizeof(double);
+    if (block_bytes > state->block_bytes) {
+        state->block_bytes = block_bytes;
+    }
+    reservation = state->blocks_per_channel * block_bytes;
+    if (reservation > worker->reservation) {
+        // larger than estimated: account for it, so that other workers
+        // wait for the memory
+        state->reserved += reservation - worker->reservation;
+        worker->reservation = reservation;
+    }
+    if (progress > ec->progress) {
+        state->progress_sum += progress - ec->progress;
+        ec->progress = progress;
+    }
     if (!quiet) {
-        // display progress
-        diff_time = (data->end_time() - info->start).to_dbl();
-        percentage = info->channel_percentage +
-            diff_time * info->channel_factor;
-        draw_progress(percentage + 0.5);
+        update_progress(state, false);
     }
+    pthread_mutex_unlock(&state->mutex);
 
     return 0; // not adopted
 }
 
 /*****************************************************************************/
 
-void draw_progress(double percentage)
+/** Displays the progress and the throughput.
+ *
+ * Has to be called with the state mutex locked. Unless \a force is set, the
+ * output is limited to a few updates per second.
+ */
+void update_progress(ExportState *state, bool force)
 {
-    static unsigned int number = 0;
-    static unsigned int blocks = 0;
-    unsigned int new_number, new_blocks, i;
+    Time now;
+    double duration;
+    stringstream rate;
 
-    if (percentage > 100.0) {
-        percentage = 100.0;
+    now.set_now();
+    if (!force && (now - state->last_draw).to_dbl_time() < 0.2) {
+        return;
+    }
+    state->last_draw = now;
+
+    duration = (now - state->started).to_dbl_time();
+    if (duration > 0.0) {
+        rate << fixed << setprecision(1)
+            << setw(8) << state->values / duration / 1e6 << " Mvalues/s"
+            << setw(8) << state->values * sizeof(double) / duration / 1e6
+            << " MB/s";
     }
 
-    new_number = (int) (percentage + 0.5);
-    new_blocks = (int) (percentage * (term_width - 9) / 100.0);
+    draw_progress(100.0 * state->progress_sum / state->channels.size(),
+            rate.str());
+}
 
-    if (new_number != number || new_blocks != blocks) {
-        number = new_number;
-        blocks = new_blocks;
+/*****************************************************************************/
 
-        cout << "\r " << setw(3) << number << "% [";
-        for (i = 0; i < blocks; i++) cout << "=";
-        for (i = blocks; i < (term_width - 9); i++) cout << " ";
-        cout << "]";
-        cout.flush();
+void draw_progress(double percentage, const string &suffix)
+{
+    unsigned int width, number, blocks, i;
+
+    if (percentage > 100.0) {
+        percentage = 100.0;
     }
+
+    width = term_width > 29 + suffix.size() ?
+        term_width - 9 - suffix.size() : 20;
+    number = (int) (percentage + 0.5);
+    blocks = (int) (percentage * width / 100.0);
+
+    cout << "\r " << setw(3) << number << "% [";
+    for (i = 0; i < blocks; i++) cout << "=";
+    for (i = blocks; i < width; i++) cout << " ";
+    cout << "]" << suffix;
+    cout.flush();
 }
 
 /*****************************************************************************/
@@ -632,7 +909,7 @@ void export_get_options(int argc, char *argv[])
     int c;
 
     while (1) {
-        if ((c = getopt(argc, argv, "d:o:f:amj:c:p:s:e:n:qhgl:")) == -1) {
+        if ((c = getopt(argc, argv, "d:o:f:amCj:c:p:s:e:n:J:M:qhgl:")) == -1) {
             break;
         }
 
@@ -657,6 +934,10 @@ void export_get_options(int argc, char *argv[])
                 export_matlab = true;
                 break;
 
+            case 'C':
+                export_columns = true;
+                break;
+
             case 'j':
                 job_id = strtoul(optarg, NULL, 10);
                 break;
@@ -702,6 +983,17 @@ void export_get_options(int argc, char *argv[])
                 decimation = strtoul(optarg, NULL, 10);
                 break;
 
+            case 'J':
+                parallel_channels = strtoul(optarg, NULL, 10);
+                if (!parallel_channels) {
+                    parallel_channels = 1;
+                }
+                break;
+
+            case 'M':
+                memory_budget = strtoul(optarg, NULL, 10);
+                break;
+
             case 'q':
                 quiet = true;
                 break;
@@ -768,6 +1060,9 @@ void export_print_usage()
          << " or \"dls-export-%Y-%m-%d-%H-%M-%S\"" << endl
          << "   -a             Enable ASCII exporter" << endl
          << "   -m             Enable MATLAB4 exporter" << endl
+         << "   -C             Enable columnar exporter (all channels"
+         << endl
+         << "                  in one file)" << endl
          << "   -j ID          Job to export (MANDATORY)" << endl
          << "   -c CHANNELS    Indices of channels to export"
          << " (see below)." << endl
@@ -784,6 +1079,11 @@ void export_print_usage()
          << "   -n DECIMATION  Export every n'th value." << endl
          << "   -g             Export messages." << endl
          << "   -l LANGUAGE    2-character language code for messages." << endl
+         << "   -J JOBS        Number of channels to export in parallel."
+         << " Default: 1" << endl
+         << "   -M MEGABYTES   Memory budget for the decoded data of the"
+         << endl
+         << "                  channels in progress. Default: 512" << endl
          << "   -q             Be quiet (no progress bar)" << endl
          << "   -h             Print this help" << endl
          << "CHANNELS is a comma-separated list of channel indices." << endl
@@ -40,6 +40,7 @@ void print_usage();
 extern int list_main(int, char *[]);
 extern int export_main(int, char *[]);
 extern int index_main(int, char *[]);
+extern int dict_main(int, char *[]);
 
 /*****************************************************************************/
 
@@ -78,6 +79,9 @@ int main(int argc, char *argv[])
     else if (command == "index") {
         return index_main(argc - 1, argv + 1);
     }
+    else if (command == "dict") {
+        return dict_main(argc - 1, argv + 1);
+    }
 
     // invalid command
     print_usage();
@@ -93,6 +97,7 @@ void print_usage()
     cout << "    list - List available chunks." << endl;
     cout << "  export - Export collected data." << endl;
     cout << "   index - (Re-)generate indices." << endl;
+    cout << "    dict - Train a ZStd dictionary for a channel." << endl;
     cout << "    help - Print this help." << endl;
     cout << "Enter \"dls COMMAND -h\" for command-specific help." << endl;
 }
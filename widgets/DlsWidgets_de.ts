@@ -481,6 +481,11 @@
         <source>Matlab binary, level 4 (*.mat)</source>
         <translation>Matlab-Binärformat, Level 4 (*.mat)</translation>
     </message>
+    <message>
+        <location filename="ExportDialog.ui" line="168"/>
+        <source>DLS columnar, all channels in one file (*.dlsc)</source>
+        <translation>DLS-Spaltenformat, alle Kanäle in einer Datei (*.dlsc)</translation>
+    </message>
     <message>
         <location filename="ExportDialog.ui" line="173"/>
         <source>Decimation:</source>
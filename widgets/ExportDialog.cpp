@@ -170,11 +170,23 @@ void ExportDialog::accept()
         worker.addExporter(exp);
     }
 
+    if (checkBoxColumns->isChecked()) {
+        LibDLS::ExportColumns *exp = new LibDLS::ExportColumns();
+        if (checkBoxRelTimes->isChecked()) {
+            exp->setReferenceTime(graph->getStart());
+        }
+        if (checkBoxTrim->isChecked()) {
+            exp->setTrim(graph->getStart(), graph->getEnd());
+        }
+        worker.addExporter(exp);
+    }
+
     QPushButton *ok = buttonBox->button(QDialogButtonBox::Ok);
     ok->setEnabled(false);
     pushButtonDir->setEnabled(false);
     checkBoxAscii->setEnabled(false);
     checkBoxMatlab->setEnabled(false);
+    checkBoxColumns->setEnabled(false);
     spinBoxDecimation->setEnabled(false);
     checkBoxTrim->setEnabled(false);
     checkBoxRelTimes->setEnabled(false);
@@ -356,6 +368,17 @@ void ExportWorker::doWork()
 
     if (channel == channels.end()) {
         success = true;
+
+        for (QList<LibDLS::Export *>::const_iterator exp = exporters.begin();
+                exp != exporters.end(); exp++) {
+            try {
+                (*exp)->finish();
+            }
+            catch (LibDLS::ExportException &e) {
+                qDebug() << "export finish failed: " << e.msg.c_str();
+                success = false;
+            }
+        }
     }
 
     emit finished();